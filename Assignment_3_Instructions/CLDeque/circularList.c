@@ -19,30 +19,401 @@
 *	next and prev pointers) and that given that it is a circular
 *	linked deque the last link points to the sentinel and the first
 *	link points to the Sentinel -- instead of null.
+*
+*	After a burst, circularListTrim packs an arena deque's links into
+*	its first chunks and hands the pages of the rest back to the OS
+*	(the chunks are kept for the next burst); it can also run on its
+*	own when a deque shrinks well below its peak.
+*
+*	A deque made with circularListCreateRing keeps its values in one
+*	contiguous ring buffer instead of links. Its values can be borrowed
+*	in place as at most two arrays (circularListSpans), and reductions
+*	stream through them instead of following next pointers. The
+*	summary statistics (circularListStats) are computed in blocks by
+*	AVX2 or SSE2 kernels picked at run time, with a scalar fallback;
+*	circularListUseKernels can pin them to a narrower set.
+*
+*	Op tracing (circularListTraceEnable) keeps each thread's most
+*	recent ops in a ring of its own for post-mortem debugging.
 ************************************************************/
+#define _DEFAULT_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
 #include "circularList.h"
+#include "circularListInline.h"
+#include "dequeCommon.h"
+#if !defined(CIRCULAR_LIST_NO_SIMD) && (defined(__x86_64__) || defined(__i386__))
+#define STATS_X86
+#include <immintrin.h>
+#endif
 
 #ifndef FORMAT_SPECIFIER
 #define FORMAT_SPECIFIER "%g"
 #endif
 
-// Double link
-struct Link
+#ifndef SORT_MAX_THREADS
+#define SORT_MAX_THREADS 64
+#endif
+
+// Auto trim runs once a deque is down to 1 / TRIM_RATIO of its peak
+#ifndef TRIM_RATIO
+#define TRIM_RATIO 4
+#endif
+
+#ifndef REDUCE_MAX_THREADS
+#define REDUCE_MAX_THREADS 256
+#endif
+
+#ifndef REDUCE_BLOCK
+#define REDUCE_BLOCK 256
+#endif
+
+// Values per segment whose partial circularListReduce caches
+#ifndef REDUCE_SEGMENT
+#define REDUCE_SEGMENT 1024
+#endif
+
+// Position of the front value when a deque is first reduced, far enough
+// from 0 that adds at the front never wrap around
+#define REDUCE_ORIGIN (1ULL << 62)
+
+#ifndef READER_SLOTS
+#define READER_SLOTS 64
+#endif
+
+// Epoch-based reclamation state for concurrent readers. Each scanning
+// reader holds a slot set to the epoch it started in (0 when free), or
+// when every slot is taken, counts itself in overflow[epoch % 3].
+// Removed links wait in limbo, chained through prev, until no reader
+// can still be looking at them.
+struct ReadEpochs
 {
-	TYPE value;
-	struct Link * next;
-	struct Link * prev;
+	unsigned long epoch;
+	unsigned long slots[READER_SLOTS];
+	unsigned long overflow[3];	// scans without a slot, by epoch % 3
+	struct Link* limbo[3];		// links removed in epoch % 3
+};
+
+// Ring buffer of values kept in monotonic order by LT
+struct MonoDeque
+{
+	TYPE* values;
+	size_t capacity;
+	size_t front;
+	size_t count;
+};
+
+// Candidates for the window min and max (see circularListTrackMinMax)
+struct MinMaxTracker
+{
+	struct MonoDeque minima;	// non-decreasing; front is the min
+	struct MonoDeque maxima;	// non-increasing; front is the max
+	int stale;					// rebuild before the next query
 };
 
-struct CircularList
+// Partials of whole segments kept between reductions. Every value has a
+// position that moves with adds and removes at the front, and segment k
+// holds positions k * REDUCE_SEGMENT up to the next segment's. Positions
+// from low up to high held the same values at the last reduction as
+// they do now, so a segment inside them can reuse its partial.
+struct ReduceCache
 {
-	int size;
-	struct Link* sentinel;
+	unsigned long long front;			// position of the front value
+	unsigned long long low;
+	unsigned long long high;
+	unsigned long version;				// deque version the partials are for
+	struct CircularListReducer reducer;	// reducer the partials are for
+	size_t slots;						// power of two; segment k uses slot k % slots
+	unsigned long long* segments;		// segment in each slot, 0 for none
+	char* partials;						// one partial per slot
 };
 
+// Bump-pointer region the links of one deque at a time are allocated from
+struct CircularListArena
+{
+	struct Arena links;
+	struct CircularList* owner;
+};
+
+/**
+	Fills in the derived fields of a memory usage report from its element
+	count and the bytes requested from and handed out by the allocator.
+	param:	usage		struct CircularListMemory ptr
+	param:	elements	size_t
+	param:	payload		size_t, bytes holding the values
+	param:	requested	size_t
+	param:	usable		size_t
+	pre:	usage is not null
+	post:	every field of usage is set
+ */
+static void fillMemory(struct CircularListMemory* usage, size_t elements,
+	size_t payload, size_t requested, size_t usable)
+{
+	assert(usage != 0);
+	usage->elements = elements;
+	usage->payloadBytes = payload;
+	usage->overheadBytes = requested - usage->payloadBytes;
+	usage->slackBytes = usable - requested;
+	usage->totalBytes = usable;
+	usage->bytesPerElement = elements == 0 ? 0.0 : (double)usable / elements;
+}
+
+/**
+	Adds a value to the back of a monotonic deque, first dropping every
+	value at the back that can no longer be the min (or max) of a window
+	that contains the new value. Equal values are kept so that each
+	occurrence can be removed on its own. Grows the ring when full.
+	param:	mono	struct MonoDeque ptr
+	param:	value	TYPE
+	param:	forMax	1 to keep values non-increasing, 0 for non-decreasing
+	pre:	mono is not null
+	post:	value is the back of mono and mono is still monotonic
+ */
+static void monoPushBack(struct MonoDeque* mono, TYPE value, int forMax)
+{
+	assert(mono != 0);
+	while (mono->count > 0)
+	{
+		TYPE back = mono->values[(mono->front + mono->count - 1) % mono->capacity];
+		if (forMax ? !LT(back, value) : !LT(value, back))
+		{
+			break;
+		}
+		mono->count--;
+	}
+	if (mono->count == mono->capacity)
+	{
+		size_t capacity = mono->capacity * 2;
+		TYPE* values = tallyMalloc(capacity * sizeof(TYPE));
+		for (size_t i = 0; i < mono->count; ++i)
+		{
+			values[i] = mono->values[(mono->front + i) % mono->capacity];
+		}
+		tallyFree(mono->values, mono->capacity * sizeof(TYPE));
+		mono->values = values;
+		mono->capacity = capacity;
+		mono->front = 0;
+	}
+	mono->values[(mono->front + mono->count) % mono->capacity] = value;
+	mono->count++;
+}
+
+/**
+	Removes the front of a monotonic deque if it is the given value,
+	which is the value leaving the front of the window.
+	param:	mono	struct MonoDeque ptr
+	param:	value	TYPE
+	pre:	mono is not null
+	post:	mono front is removed if it was equal to value
+ */
+static void monoPopFront(struct MonoDeque* mono, TYPE value)
+{
+	assert(mono != 0);
+	if (mono->count > 0 && EQ(mono->values[mono->front], value))
+	{
+		mono->front = (mono->front + 1) % mono->capacity;
+		mono->count--;
+	}
+}
+
+/**
+	Marks the deque's min/max tracker (if it has one) as needing a
+	rebuild, for changes the monotonic deques can't follow: adding to
+	the front, removing from the back and reordering.
+	param:	deque	struct CircularList ptr
+	pre:	deque is not null
+	post:	tracker is stale
+ */
+static void minMaxInvalidate(struct CircularList* deque)
+{
+	if (deque->minMax != 0)
+	{
+		deque->minMax->stale = 1;
+	}
+}
+
+/**
+	Keeps the reduce cache in step with an add or remove at one end of
+	the deque: positions move with the front, and the position of a
+	removed value is left out of the range whose partials can be reused.
+	param:	deque	struct CircularList ptr
+	param:	front	1 for the front, 0 for the back
+	param:	added	1 for an add, 0 for a remove
+	pre:	deque is not null and its size is already updated
+	post:	cache positions match the deque
+ */
+static void reduceNoteEnd(struct CircularList* deque, int front, int added)
+{
+	struct ReduceCache* cache = deque->reduceCache;
+	if(cache == 0)
+	{
+		return;
+	}
+	if(front && added)
+	{
+		cache->front--;
+	}
+	else if(front)
+	{
+		cache->front++;
+		if(cache->low < cache->front)
+		{
+			cache->low = cache->front;
+		}
+	}
+	else if(!added && cache->high > cache->front + deque->size)
+	{
+		cache->high = cache->front + deque->size;
+	}
+}
+
+/**
+	Frees the slots of a reduce cache.
+	param:	cache	struct ReduceCache ptr
+	pre:	cache is not null
+	post:	cache has no slots
+ */
+static void freeReduceSlots(struct ReduceCache* cache)
+{
+	if(cache->slots > 0)
+	{
+		tallyFree(cache->segments, cache->slots * sizeof(unsigned long long));
+		tallyFree(cache->partials, cache->slots * cache->reducer.partialSize);
+	}
+	cache->slots = 0;
+	cache->segments = 0;
+	cache->partials = 0;
+}
+
+/**
+	Gives a removed link back to wherever it came from: the deque's arena
+	free list, or the allocator.
+	param:	deque	struct CircularList ptr
+	param:	link	struct Link ptr
+	pre:	deque and link are not null
+	pre:	link is no longer in the deque and no reader can reach it
+	post:	link may no longer be used
+ */
+static void releaseLink(struct CircularList* deque, struct Link* link)
+{
+	if (deque->arena != 0)
+	{
+		arenaFree(&deque->arena->links, link);
+	}
+	else
+	{
+		tallyFree(link, sizeof(struct Link));
+	}
+}
+
+/**
+	Releases every link in a limbo chain.
+	param:	deque	struct CircularList ptr
+	param:	chain	struct Link ptr, chained through prev
+	pre:	deque is not null
+	post:	every link of chain is released
+ */
+static void releaseLimbo(struct CircularList* deque, struct Link* chain)
+{
+	while (chain != 0)
+	{
+		struct Link* prev = chain->prev;
+		releaseLink(deque, chain);
+		chain = prev;
+	}
+}
+
+/**
+	Moves to the next epoch if every scanning reader has already seen the
+	current one, releasing the links removed two epochs ago, which no
+	reader can still reach. A reader counted in overflow under another
+	epoch's index holds the epoch back just as a slot would. Never waits:
+	if a reader is slow, limbo just grows until it finishes.
+	param:	deque	struct CircularList ptr
+	pre:	deque has concurrent reads on
+	post:	older links in limbo may have been released
+ */
+static void drainLimbo(struct CircularList* deque)
+{
+	struct ReadEpochs* readers = deque->readers;
+	unsigned long epoch = readers->epoch;
+	for (int i = 0; i < READER_SLOTS; ++i)
+	{
+		unsigned long seen = __atomic_load_n(&readers->slots[i], __ATOMIC_SEQ_CST);
+		if (seen != 0 && seen != epoch)
+		{
+			return;
+		}
+	}
+	for (unsigned long i = 0; i < 3; ++i)
+	{
+		if (i != epoch % 3 && __atomic_load_n(&readers->overflow[i], __ATOMIC_SEQ_CST) != 0)
+		{
+			return;
+		}
+	}
+	releaseLimbo(deque, readers->limbo[(epoch + 2) % 3]);
+	readers->limbo[(epoch + 2) % 3] = 0;
+	__atomic_store_n(&readers->epoch, epoch + 1, __ATOMIC_SEQ_CST);
+}
+
+/**
+	Puts a removed link in limbo for the current epoch instead of
+	releasing it, then tries to move on to the next epoch (see
+	drainLimbo).
+	param:	deque	struct CircularList ptr
+	param:	link	struct Link ptr
+	pre:	deque has concurrent reads on
+	pre:	link has been unlinked from the deque
+	post:	link is in limbo; older links may have been released
+ */
+static void retireLink(struct CircularList* deque, struct Link* link)
+{
+	struct ReadEpochs* readers = deque->readers;
+	unsigned long epoch = readers->epoch;
+	link->prev = readers->limbo[epoch % 3];
+	readers->limbo[epoch % 3] = link;
+	drainLimbo(deque);
+}
+
+// Tracing state of every deque's ops (see circularListTraceEnable); each thread
+// records into a ring of its own (see dequeCommon.h)
+static struct TraceLog trace;
+static __thread struct TraceRing* traceRing;
+
+/**
+	Returns the bits of a value (its first 8 bytes) for hashing.
+	param:	value	TYPE
+	pre:	none
+	post:	none
+	ret:	bits of value
+ */
+static uint64_t traceValue(TYPE value)
+{
+	uint64_t bits = 0;
+	memcpy(&bits, &value, sizeof(TYPE) < sizeof(bits) ? sizeof(TYPE) : sizeof(bits));
+	return bits;
+}
+
+/**
+	Records an op in the calling thread's ring (see traceRecord).
+	param:	op		enum TraceOp
+	param:	object	the deque the op is on
+	param:	hash	bits of the value, or 0
+	param:	size	size of the deque
+	pre:	none
+	post:	the op is the thread's newest event if tracing is on
+ */
+static void traceOp(int op, const void* object, uint64_t hash, size_t size)
+{
+	traceRecord(&trace, &traceRing, op, object, hash, size);
+}
+
 /**
   	Allocates the deque's sentinel and sets the size to 0.
   	The sentinel's next and prev should point to the sentinel itself.
@@ -52,33 +423,152 @@ struct CircularList
 			sentinel next points to sentinel
 			sentinel prev points to sentinel
 			deque size is 0
+			deque has no reduce cache and no min/max tracker
+			deque has concurrent reads off
  */
 static void init(struct CircularList* deque)
 {
 	/* FIXME: You will write this function */
 
 	assert(deque !=0);
-	struct Link* sentinel = malloc(sizeof(struct Link));
+	struct Link* sentinel = tallyMalloc(sizeof(struct Link));
 	assert(sentinel !=0);
 	sentinel->next = sentinel;
 	sentinel->prev = sentinel;
 	deque->size = 0;
 	deque->sentinel = sentinel;
+	deque->version = 0;
+	deque->reduceCache = 0;
+	deque->minMax = 0;
+	deque->readers = 0;
+	deque->peak = 0;
+	deque->trimPeak = 0;
+	deque->ring = 0;
+	deque->ringCapacity = 0;
+	deque->ringFront = 0;
+	deque->ringFixed = 0;
+}
+
+/**
+	Trims the deque if the auto trim policy is on and a remove has taken
+	it below 1 / TRIM_RATIO of its peak (see circularListAutoTrim).
+	param:	deque	struct CircularList ptr
+	pre:	deque is not null
+	post:	deque is trimmed if the policy calls for it
+ */
+static void autoTrim(struct CircularList* deque)
+{
+	if(deque->trimPeak !=0 && deque->readers == 0 && deque->peak >= deque->trimPeak
+		&& deque->size < deque->peak / TRIM_RATIO)
+	{
+		circularListTrim(deque);
+	}
+}
+
+/**
+	Returns where the value at the given position, counting from the
+	front, is kept in a ring deque's buffer.
+	param:	deque		struct CircularList ptr
+	param:	position	size_t
+	pre:	deque is not null and keeps its values in a ring
+	post:	none
+	ret:	index into deque->ring
+ */
+static size_t ringIndex(struct CircularList* deque, size_t position)
+{
+	size_t index = deque->ringFront + position;
+	return index >= deque->ringCapacity ? index - deque->ringCapacity : index;
+}
+
+/**
+	Moves a ring deque's values into a new ring of the given capacity,
+	with the front value at index 0.
+	param:	deque		struct CircularList ptr
+	param:	capacity	size_t
+	pre:	deque is not null and keeps its values in a ring
+	pre:	capacity >= deque size and capacity > 0
+	post:	deque ring has the same values in a buffer of capacity values
+ */
+static void ringResize(struct CircularList* deque, size_t capacity)
+{
+	TYPE* ring = tallyMalloc(capacity * sizeof(TYPE));
+	circularListToArray(deque, ring);
+	tallyFree(deque->ring, deque->ringCapacity * sizeof(TYPE));
+	deque->ring = ring;
+	deque->ringCapacity = capacity;
+	deque->ringFront = 0;
+}
+
+/**
+	Adds a value to the front or back of a ring deque, doubling the ring
+	first if it is full. A full fixed-capacity ring is never grown: the
+	caller has already made room by removing the value at the other end.
+	param:	deque	struct CircularList ptr
+	param:	value	TYPE
+	param:	front	1 to add at the front, 0 at the back
+	pre:	deque is not null and keeps its values in a ring
+	post:	value is the deque's front (or back); size is incremented
+ */
+static void ringAdd(struct CircularList* deque, TYPE value, int front)
+{
+	if(deque->size == deque->ringCapacity)
+	{
+		ringResize(deque, deque->ringCapacity * 2);
+	}
+	if(front)
+	{
+		deque->ringFront = (deque->ringFront == 0 ? deque->ringCapacity : deque->ringFront) - 1;
+		deque->ring[deque->ringFront] = value;
+	}
+	else
+	{
+		deque->ring[ringIndex(deque, deque->size)] = value;
+	}
+	deque->size++;
+	reduceNoteEnd(deque, front, 1);
+	tallyElements(1, sizeof(TYPE));
+	if(deque->size > deque->peak)
+	{
+		deque->peak = deque->size;
+	}
+}
+
+/**
+	Removes the front or back value of a ring deque.
+	param:	deque	struct CircularList ptr
+	param:	front	1 to remove the front, 0 the back
+	pre:	deque is not null, keeps its values in a ring and is not empty
+	post:	size is decremented
+ */
+static void ringRemove(struct CircularList* deque, int front)
+{
+	if(front)
+	{
+		deque->ringFront = ringIndex(deque, 1);
+	}
+	deque->size--;
+	reduceNoteEnd(deque, front, 0);
+	tallyElements(-1, sizeof(TYPE));
+	autoTrim(deque);
 }
 
 /**
-	Creates a link with the given value and NULL next and prev pointers.
+	Creates a link with the given value and NULL next and prev pointers,
+	taking it from the deque's arena if it has one.
+	param:	deque	struct CircularList ptr
 	param: 	value 	TYPE
-	pre: 	none
+	pre: 	deque is not null
 	post: 	newLink is not null
 			newLink value init to value
 			newLink next and prev init to NULL
  */
-static struct Link* createLink(TYPE value)
+static struct Link* createLink(struct CircularList* deque, TYPE value)
 {
 	/* FIXME: You will write this function */
 
-	struct Link* newLink = malloc(sizeof(struct Link));
+	struct Link* newLink = deque->arena != 0
+		? arenaAlloc(&deque->arena->links)
+		: tallyMalloc(sizeof(struct Link));
 	assert(newLink !=0);
 	newLink->value=value;
 	newLink->next = 0;
@@ -103,12 +593,25 @@ static void addLinkAfter(struct CircularList* deque, struct Link* link, TYPE val
 	/* FIXME: You will write this function
 	Need to update 4 pointers	*/
 	assert(deque !=0 && link !=0);
-	struct Link* newLink= createLink(value);
+	struct Link* newLink= createLink(deque,value);
 	newLink->prev = link;
 	newLink->next = link->next;
 	link->next->prev = newLink;
-	link->next = newLink;
+	// publish the fully built link to any concurrent reader
+	__atomic_store_n(&link->next, newLink, __ATOMIC_RELEASE);
+	// links removed before a burst of adds are freed during it
+	if(deque->readers !=0 && (deque->readers->limbo[0] !=0
+		|| deque->readers->limbo[1] !=0 || deque->readers->limbo[2] !=0))
+	{
+		drainLimbo(deque);
+	}
 	deque->size++;
+	reduceNoteEnd(deque, link == deque->sentinel, 1);
+	tallyElements(1, sizeof(TYPE));
+	if(deque->size > deque->peak)
+	{
+		deque->peak = deque->size;
+	}
 }
 
 /**
@@ -117,20 +620,32 @@ static void addLinkAfter(struct CircularList* deque, struct Link* link, TYPE val
  	param:	link 	struct Link ptr
 	pre: 	deque and link are not null
 	post: 	param link is removed from param deque
-			memory allocated to link is freed
+			memory allocated to link is freed (or returned to the arena),
+			after a grace period if concurrent reads are on
 			deque size is decremented by 1
  */
 static void removeLink(struct CircularList* deque, struct Link* link)
 {
 	/* FIXME: You will write this function */
 	assert(deque !=0 && link !=0);
+	int front = link->prev == deque->sentinel;
 	link->next->prev = link->prev;
-	link->prev->next = link->next;
-	// free memory
-	free(link);
+	__atomic_store_n(&link->prev->next, link->next, __ATOMIC_RELEASE);
+	// free memory (or hand it back to the arena), once no reader can see it
+	if(deque->readers !=0)
+	{
+		retireLink(deque,link);
+	}
+	else
+	{
+		releaseLink(deque,link);
+	}
 	link = 0;
 	// decrement size
 	deque->size--;
+	reduceNoteEnd(deque, front, 0);
+	tallyElements(-1, sizeof(TYPE));
+	autoTrim(deque);
 }
 
 /**
@@ -142,111 +657,615 @@ static void removeLink(struct CircularList* deque, struct Link* link)
  */
 struct CircularList* circularListCreate()
 {
-	struct CircularList* deque = malloc(sizeof(struct CircularList));
+	struct CircularList* deque = tallyMalloc(sizeof(struct CircularList));
+	deque->arena = 0;
+	deque->ownsArena = 0;
 	init(deque);
+	traceOp(TRACE_CREATE, deque, 0, 0);
 	return deque;
 }
 
 /**
-	Deallocates every link in the deque and frees the deque pointer.
-	pre: 	deque is not null
-	post: 	memory allocated to each link is freed
-			" " sentinel " "
-			" " deque " "
+	Allocates and initializes a deque that keeps its values in one
+	contiguous ring buffer instead of links, so scans and reductions
+	stream through memory and the values can be borrowed in place (see
+	circularListSpans). The ring doubles whenever it is full, so adding
+	is O(1) amortized. A ring deque can't have concurrent reads on.
+	param:	capacity	number of values to make room for up front
+	pre: 	capacity > 0
+	post: 	memory allocated for the deque, its sentinel and its ring
+	return: deque
  */
-void circularListDestroy(struct CircularList* deque)
+struct CircularList* circularListCreateRing(size_t capacity)
 {
-	/* FIXME: You will write this function */
-	assert(deque !=0);
-	struct Link* freeStuff = deque->sentinel->next;
-	while(freeStuff !=deque->sentinel)
-	{
-			freeStuff = freeStuff->next;
-			removeLink(deque,freeStuff->prev);
-	}
-	free(freeStuff);
-	free(deque);
+	assert(capacity > 0);
+	struct CircularList* deque = circularListCreate();
+	deque->ringCapacity = capacity;
+	deque->ring = tallyMalloc(capacity * sizeof(TYPE));
+	return deque;
 }
 
 /**
-	Adds a new link with the given value to the front of the deque.
-	param:	deque 	struct CircularList ptr
-	param: 	value 	TYPE
-	pre: 	deque is not null
-	post: 	link is created w/ given value before current first link
-			(call to addLinkAfter)
+	Allocates and initializes a ring deque (see circularListCreateRing)
+	that never holds more than capacity values: adding to the back of a
+	full deque overwrites its front (the oldest value) in place, and
+	adding to the front overwrites its back. All of its memory is
+	allocated here, so adds and removes never allocate or free, and
+	trimming keeps the ring.
+	param:	capacity	largest number of values the deque holds
+	pre: 	capacity > 0
+	post: 	memory allocated for the deque, its sentinel and its ring
+	return: deque
  */
-void circularListAddFront(struct CircularList* deque, TYPE value)
+struct CircularList* circularListCreateFixed(size_t capacity)
 {
-	/* FIXME: You will write this function */
-
-	assert(deque !=0);
-	addLinkAfter(deque,deque->sentinel,value);
+	struct CircularList* deque = circularListCreateRing(capacity);
+	deque->ringFixed = 1;
+	return deque;
 }
 
 /**
-	Adds a new link with the given value to the back of the deque.
-	param: 	deque 	struct CircularList ptr
-	param: 	value 	TYPE
-	pre: 	deque is not null
-	post: 	link is created w/ given value after the current last link
-			(call to addLinkAfter)
+	Lends out the values of a ring deque without copying them: front to
+	back they are first[0 .. firstCount) followed by
+	second[0 .. secondCount), where second is only used when the values
+	wrap around the end of the ring. The spans stay valid until the deque
+	is next changed.
+	param:	deque	struct CircularList ptr
+	param:	spans	struct CircularListSpans ptr
+	pre: 	deque and spans are not null
+	post: 	spans is filled in (with no values for a linked deque)
+	ret:	1 if the deque keeps its values in a ring, 0 if it is linked
  */
-void circularListAddBack(struct CircularList* deque, TYPE value)
+int circularListSpans(struct CircularList* deque, struct CircularListSpans* spans)
 {
-	/* FIXME: You will write this function */
-	assert(deque !=0);
-	addLinkAfter(deque,deque->sentinel->prev,value);
-
+	assert(deque !=0 && spans !=0);
+	spans->first = deque->ring;
+	spans->firstCount = 0;
+	spans->second = deque->ring;
+	spans->secondCount = 0;
+	if(deque->ring == 0)
+	{
+		return 0;
+	}
+	spans->first = deque->ring + deque->ringFront;
+	spans->firstCount = deque->ringCapacity - deque->ringFront;
+	if(spans->firstCount >= deque->size)
+	{
+		spans->firstCount = deque->size;
+	}
+	else
+	{
+		spans->secondCount = deque->size - spans->firstCount;
+	}
+	return 1;
 }
 
 /**
-	Returns the value of the link at the front of the deque.
-	param: 	deque 	struct CircularList ptr
-	pre:	deque is not null
-	pre:	deque is not empty
-	post:	none
-	ret:	first link's value
+	Allocates and initializes a deque whose links all come from the given
+	arena, so that destroying or clearing it is O(number of chunks)
+	instead of a free per link. The arena serves one deque at a time and
+	is ready for the next deque once this one is destroyed.
+	param:	arena	struct CircularListArena ptr
+	pre: 	arena is not null
+	pre:	arena is not in use by another deque
+	post: 	memory allocated for new struct CircularList ptr
+			deque init (call to init func)
+			arena is owned by deque
+	return: deque
  */
-TYPE circularListFront(struct CircularList* deque)
+struct CircularList* circularListCreateInArena(struct CircularListArena* arena)
 {
-	/* FIXME: You will write this function */
-	assert(deque !=0);
-	assert(!circularListIsEmpty(deque));
-	return deque->sentinel->next->value;
-
+	assert(arena != 0);
+	assert(arena->owner == 0);
+	struct CircularList* deque = circularListCreate();
+	deque->arena = arena;
+	arena->owner = deque;
+	return deque;
 }
 
 /**
-  	Returns the value of the link at the back of the deque.
-	param: 	deque 	struct CircularList ptr
-	pre:	deque is not null
-	pre:	deque is not empty
-	post:	none
-	ret:	last link's value
+	Allocates an arena for deque links along with its first chunk.
+	param:	chunkLinks	number of links in the first chunk; each later
+						chunk is twice the size of the one before, up
+						to ARENA_MAX_CHUNK_SLOTS links
+	pre: 	chunkLinks > 0
+	post: 	memory allocated for arena and one chunk of chunkLinks links
+	return: arena
  */
-TYPE circularListBack(struct CircularList* deque)
+struct CircularListArena* circularListArenaCreate(size_t chunkLinks)
 {
-	/* FIXME: You will write this function */
-	assert(deque !=0);
-	assert(!circularListIsEmpty(deque));
-	return deque->sentinel->prev->value;
-
+	assert(chunkLinks > 0);
+	struct CircularListArena* arena = tallyMalloc(sizeof(struct CircularListArena));
+	arenaInit(&arena->links, sizeof(struct Link), chunkLinks);
+	arena->owner = 0;
+	return arena;
 }
 
 /**
-	Removes the link at the front of the deque.
-	param: 	deque 	struct CircularList ptr
-	pre:	deque is not null
-	pre:	deque is not empty
-	post:	first link is removed and freed (call to removeLink)
+	Frees every chunk of the arena and the arena itself.
+	param:	arena	struct CircularListArena ptr
+	pre: 	arena is not null
+	pre:	arena is not in use by a deque
+	post: 	memory allocated to each chunk and the arena is freed
  */
-void circularListRemoveFront(struct CircularList* deque)
+void circularListArenaDestroy(struct CircularListArena* arena)
+{
+	assert(arena != 0);
+	assert(arena->owner == 0);
+	arenaFinish(&arena->links);
+	tallyFree(arena, sizeof(struct CircularListArena));
+}
+
+/**
+	Removes every link from the deque, leaving it empty but usable.
+	A ring deque just forgets its values and an arena deque rewinds its
+	arena, which is O(number of chunks); otherwise (or with concurrent
+	reads on) every link is removed.
+	param:	deque 	struct CircularList ptr
+	pre: 	deque is not null
+	post: 	deque is empty
+ */
+void circularListClear(struct CircularList* deque)
+{
+	assert(deque !=0);
+	traceOp(TRACE_CLEAR, deque, 0, deque->size);
+	if(deque->ring !=0)
+	{
+		tallyElements(-(ptrdiff_t)deque->size, sizeof(TYPE));
+		deque->size = 0;
+		deque->ringFront = 0;
+		deque->version++;
+		if(deque->trimPeak !=0 && deque->peak >= deque->trimPeak)
+		{
+			circularListTrim(deque);
+		}
+	}
+	else if(deque->arena == 0 || deque->readers !=0)
+	{
+		struct Link* freeStuff = deque->sentinel->next;
+		while(freeStuff !=deque->sentinel)
+		{
+				freeStuff = freeStuff->next;
+				removeLink(deque,freeStuff->prev);
+		}
+	}
+	else
+	{
+		arenaReset(&deque->arena->links);
+		tallyElements(-(ptrdiff_t)deque->size, sizeof(TYPE));
+		deque->sentinel->next = deque->sentinel;
+		deque->sentinel->prev = deque->sentinel;
+		deque->size = 0;
+		deque->version++;
+		if(deque->trimPeak !=0 && deque->peak >= deque->trimPeak)
+		{
+			circularListTrim(deque);
+		}
+	}
+	if(deque->minMax !=0)
+	{
+		deque->minMax->minima.count = 0;
+		deque->minMax->maxima.count = 0;
+		deque->minMax->stale = 0;
+	}
+}
+
+/**
+	Puts count values into one block of links at the start of the deque's
+	arena, wired up in one pass as the values are copied in, either from
+	an array or from a chain of links, and makes them the deque's links.
+	The deque's size and the tally are left alone.
+	param:	deque	struct CircularList ptr
+	param:	count	size_t
+	param:	values	array of count values, or null to copy from
+	param:	from	first link of a chain of at least count links, used
+					if values is null
+	pre:	deque is not null and nothing has been allocated from its arena
+	pre:	values or from is not null if count > 0
+	post:	deque's links are the block, in the same order as the values
+ */
+static void wireBlock(struct CircularList* deque, size_t count, const TYPE* values, struct Link* from)
+{
+	struct Link* links = arenaBlock(&deque->arena->links, count);
+	struct Link* prev = deque->sentinel;
+	for(size_t i = 0; i < count; ++i)
+	{
+		if(values !=0)
+		{
+			links[i].value = values[i];
+		}
+		else
+		{
+			links[i].value = from->value;
+			from = from->next;
+		}
+		links[i].prev = prev;
+		prev->next = &links[i];
+		prev = &links[i];
+	}
+	prev->next = deque->sentinel;
+	deque->sentinel->prev = prev;
+}
+
+/**
+	Makes a deque of count values whose links are one block (the first
+	chunk of an arena the deque owns), copied from an array or from a
+	chain of links (see wireBlock).
+	param:	count	size_t
+	param:	values	array of count values, or null to copy from
+	param:	from	first link of a chain of at least count links, used
+					if values is null
+	pre: 	values or from is not null if count > 0
+	post: 	memory allocated for the deque, its sentinel and its links
+	ret:	deque with the values in the same order
+ */
+static struct CircularList* blockDeque(size_t count, const TYPE* values, struct Link* from)
+{
+	struct CircularList* deque = circularListCreateInArena(circularListArenaCreate(count > 0 ? count : 1));
+	deque->ownsArena = 1;
+	wireBlock(deque, count, values, from);
+	deque->size = count;
+	tallyElements((ptrdiff_t)count, sizeof(TYPE));
+	return deque;
+}
+
+/**
+	Returns memory the deque no longer needs after it has shrunk. An
+	arena deque has its links packed, in order, into the first links of
+	its arena, and the pages of the chunk space left over are handed back
+	to the OS with madvise(MADV_DONTNEED). The chunks themselves are kept,
+	so the next burst reuses them without calling malloc. A deque whose
+	links come from malloc has its values copied into one block of links
+	in a new arena, which the deque owns and takes its links from from
+	then on; the old links are freed and the allocator is asked to
+	release what it can with malloc_trim. A ring deque moves its values
+	into the smallest ring they fit in, unless it has a fixed capacity.
+	O(n) plus the number of chunks; links and ring values move, so
+	pointers to them are no longer valid.
+	param:	deque 	struct CircularList ptr
+	pre: 	deque is not null
+	pre:	deque does not have concurrent reads on
+	post: 	deque has the same values in the same order
+			deque peak is its current size
+ */
+void circularListTrim(struct CircularList* deque)
+{
+	assert(deque !=0);
+	assert(deque->readers == 0);
+	traceOp(TRACE_TRIM, deque, 0, deque->size);
+	deque->peak = deque->size;
+	if(deque->ring !=0)
+	{
+		size_t capacity = deque->size > 0 ? deque->size : 1;
+		if(!deque->ringFixed && capacity < deque->ringCapacity)
+		{
+			ringResize(deque, capacity);
+		}
+		return;
+	}
+	if(deque->arena == 0)
+	{
+		if(deque->size > 0)
+		{
+			struct Link* old = deque->sentinel->next;
+			deque->arena = circularListArenaCreate(deque->size);
+			deque->arena->owner = deque;
+			deque->ownsArena = 1;
+			wireBlock(deque, deque->size, 0, old);
+			for(size_t i = 0; i < deque->size; ++i)
+			{
+				struct Link* next = old->next;
+				tallyFree(old, sizeof(struct Link));
+				old = next;
+			}
+		}
+		malloc_trim(0);
+		return;
+	}
+	TYPE* values = malloc((deque->size > 0 ? deque->size : 1) * sizeof(TYPE));
+	assert(values !=0);
+	circularListToArray(deque, values);
+	arenaReset(&deque->arena->links);
+	struct Link* prev = deque->sentinel;
+	for(size_t i = 0; i < deque->size; ++i)
+	{
+		struct Link* link = createLink(deque, values[i]);
+		link->prev = prev;
+		prev->next = link;
+		prev = link;
+	}
+	prev->next = deque->sentinel;
+	deque->sentinel->prev = prev;
+	free(values);
+
+	arenaRelease(&deque->arena->links);
+}
+
+/**
+	Turns the high-watermark trim policy on or off. With it on, once the
+	deque has held at least minPeak values, it is trimmed (see
+	circularListTrim) whenever a remove takes it below 1 / TRIM_RATIO of
+	the largest size it has reached since it was last trimmed, unless
+	concurrent reads are on. Each trim costs O(n), but runs only after
+	the deque has lost most of its values, so this adds O(1) amortized
+	per remove.
+	param:	deque 	struct CircularList ptr
+	param:	minPeak	size_t, 0 to turn the policy off
+	pre: 	deque is not null
+	post: 	deque trims itself when it falls well below its peak
+ */
+void circularListAutoTrim(struct CircularList* deque, size_t minPeak)
+{
+	assert(deque !=0);
+	deque->trimPeak = minPeak;
+}
+
+/**
+	Deallocates every link in the deque and frees the deque pointer.
+	pre: 	deque is not null
+	post: 	memory allocated to each link is freed
+			(or handed back to the deque's arena)
+			" " sentinel " "
+			" " deque " "
+			" " deque's ring
+			" " deque's arena if it was made by circularListClone
+			" " deque's reduce cache
+			" " deque's min/max tracker
+			" " links still waiting for readers (none may be scanning)
+ */
+void circularListDestroy(struct CircularList* deque)
+{
+	/* FIXME: You will write this function */
+	assert(deque !=0);
+	traceOp(TRACE_DESTROY, deque, 0, deque->size);
+	circularListClear(deque);
+	// links waiting for readers go back to the arena before it is freed
+	if(deque->readers !=0)
+	{
+		for(int i = 0; i < 3; ++i)
+		{
+			releaseLimbo(deque,deque->readers->limbo[i]);
+		}
+		tallyFree(deque->readers, sizeof(struct ReadEpochs));
+	}
+	if(deque->ring !=0)
+	{
+		tallyFree(deque->ring, deque->ringCapacity * sizeof(TYPE));
+	}
+	if(deque->arena !=0)
+	{
+		deque->arena->owner = 0;
+		if(deque->ownsArena)
+		{
+			circularListArenaDestroy(deque->arena);
+		}
+	}
+	if(deque->reduceCache !=0)
+	{
+		freeReduceSlots(deque->reduceCache);
+		tallyFree(deque->reduceCache, sizeof(struct ReduceCache));
+	}
+	if(deque->minMax !=0)
+	{
+		tallyFree(deque->minMax->minima.values, deque->minMax->minima.capacity * sizeof(TYPE));
+		tallyFree(deque->minMax->maxima.values, deque->minMax->maxima.capacity * sizeof(TYPE));
+		tallyFree(deque->minMax, sizeof(struct MinMaxTracker));
+	}
+	tallyFree(deque->sentinel, sizeof(struct Link));
+	tallyFree(deque, sizeof(struct CircularList));
+}
+
+/**
+	Makes a copy of the deque. All of the copy's links are allocated as a
+	single block, laid out in front to back order, and the pointers are
+	set up in one pass over the original, so the copy costs two
+	allocations besides its sentinel rather than one per link. The block
+	is the first chunk of an arena the copy owns; links added to the copy
+	later come from the same arena. A ring deque is copied into a ring of
+	the same capacity, fixed if the original's is.
+	param:	deque 	struct CircularList ptr
+	pre: 	deque is not null
+	post: 	memory allocated for the copy, its sentinel and its links
+	ret:	copy of deque with the same values in the same order
+ */
+struct CircularList* circularListClone(struct CircularList* deque)
+{
+	assert(deque !=0);
+	if(deque->ring !=0)
+	{
+		struct CircularList* copy = deque->ringFixed
+			? circularListCreateFixed(deque->ringCapacity)
+			: circularListCreateRing(deque->ringCapacity);
+		circularListToArray(deque, copy->ring);
+		copy->size = deque->size;
+		copy->peak = deque->size;
+		tallyElements((ptrdiff_t)deque->size, sizeof(TYPE));
+		return copy;
+	}
+	return blockDeque(deque->size, 0, deque->sentinel->next);
+}
+
+/**
+	Copies the values of the deque, front to back, into an array in one
+	pass over the links (or, for a ring deque, with at most two memcpy
+	calls).
+	param:	deque 	struct CircularList ptr
+	param:	values	array with room for the deque's size values
+	pre: 	deque and values are not null
+	post: 	values holds the deque's values; the deque is unchanged
+	ret:	number of values copied (the deque's size)
+ */
+size_t circularListToArray(struct CircularList* deque, TYPE* values)
+{
+	assert(deque !=0 && values !=0);
+	struct CircularListSpans spans;
+	if(circularListSpans(deque, &spans))
+	{
+		memcpy(values, spans.first, spans.firstCount * sizeof(TYPE));
+		memcpy(values + spans.firstCount, spans.second, spans.secondCount * sizeof(TYPE));
+		return deque->size;
+	}
+	struct Link* current = deque->sentinel->next;
+	for(size_t i = 0; i < deque->size; ++i)
+	{
+		values[i] = current->value;
+		current = current->next;
+	}
+	return deque->size;
+}
+
+/**
+	Makes a deque holding the values of an array, front to back. As with
+	circularListClone, the links are one block (the first chunk of an
+	arena the deque owns), set up in one pass over the array.
+	param:	values	array of count values
+	param:	count	size_t
+	pre: 	values is not null if count > 0
+	post: 	memory allocated for the deque, its sentinel and its links
+	ret:	deque with the array's values in the same order
+ */
+struct CircularList* circularListFromArray(const TYPE* values, size_t count)
+{
+	assert(values !=0 || count == 0);
+	return blockDeque(count, values, 0);
+}
+
+/**
+	Adds a new link with the given value to the front of the deque.
+	param:	deque 	struct CircularList ptr
+	param: 	value 	TYPE
+	pre: 	deque is not null
+	post: 	link is created w/ given value before current first link
+			(call to addLinkAfter)
+			a full fixed-capacity deque drops its back value first
+ */
+void circularListAddFront(struct CircularList* deque, TYPE value)
+{
+	/* FIXME: You will write this function */
+
+	assert(deque !=0);
+	traceOp(TRACE_ADD_FRONT, deque, traceValue(value), deque->size);
+	if(deque->ringFixed && deque->size == deque->ringCapacity)
+	{
+		circularListRemoveBack(deque);
+	}
+	if(deque->ring !=0)
+	{
+		ringAdd(deque,value,1);
+	}
+	else
+	{
+		addLinkAfter(deque,deque->sentinel,value);
+	}
+	minMaxInvalidate(deque);
+}
+
+/**
+	Adds a new link with the given value to the back of the deque.
+	param: 	deque 	struct CircularList ptr
+	param: 	value 	TYPE
+	pre: 	deque is not null
+	post: 	link is created w/ given value after the current last link
+			(call to addLinkAfter)
+			a full fixed-capacity deque drops its front value first
+ */
+void circularListAddBack(struct CircularList* deque, TYPE value)
+{
+	/* FIXME: You will write this function */
+	assert(deque !=0);
+	traceOp(TRACE_ADD_BACK, deque, traceValue(value), deque->size);
+	if(deque->ringFixed && deque->size == deque->ringCapacity)
+	{
+		circularListRemoveFront(deque);
+	}
+	if(deque->ring !=0)
+	{
+		ringAdd(deque,value,0);
+	}
+	else
+	{
+		addLinkAfter(deque,deque->sentinel->prev,value);
+	}
+	if(deque->minMax !=0 && !deque->minMax->stale)
+	{
+		monoPushBack(&deque->minMax->minima,value,0);
+		monoPushBack(&deque->minMax->maxima,value,1);
+	}
+
+}
+
+#ifndef CIRCULAR_LIST_INLINE
+
+/**
+	Returns the value of the link at the front of the deque.
+	param: 	deque 	struct CircularList ptr
+	pre:	deque is not null
+	pre:	deque is not empty
+	post:	none
+	ret:	first link's value
+ */
+TYPE circularListFront(struct CircularList* deque)
+{
+	/* FIXME: You will write this function */
+	CIRCULAR_LIST_CHECK(deque !=0);
+	CIRCULAR_LIST_CHECK(!circularListIsEmpty(deque));
+	if(deque->ring !=0)
+	{
+		return deque->ring[deque->ringFront];
+	}
+	return deque->sentinel->next->value;
+
+}
+
+/**
+  	Returns the value of the link at the back of the deque.
+	param: 	deque 	struct CircularList ptr
+	pre:	deque is not null
+	pre:	deque is not empty
+	post:	none
+	ret:	last link's value
+ */
+TYPE circularListBack(struct CircularList* deque)
+{
+	/* FIXME: You will write this function */
+	CIRCULAR_LIST_CHECK(deque !=0);
+	CIRCULAR_LIST_CHECK(!circularListIsEmpty(deque));
+	if(deque->ring !=0)
+	{
+		return deque->ring[ringIndex(deque, deque->size - 1)];
+	}
+	return deque->sentinel->prev->value;
+
+}
+
+#endif
+
+/**
+	Removes the link at the front of the deque.
+	param: 	deque 	struct CircularList ptr
+	pre:	deque is not null
+	pre:	deque is not empty
+	post:	first link is removed and freed (call to removeLink)
+ */
+void circularListRemoveFront(struct CircularList* deque)
 {
 	/* FIXME: You will write this function */
 	assert(deque !=0);
 	assert(!circularListIsEmpty(deque));
-	removeLink(deque,deque->sentinel->next);
+	traceOp(TRACE_REMOVE_FRONT, deque, traceValue(circularListFront(deque)), deque->size);
+	if(deque->minMax !=0 && !deque->minMax->stale)
+	{
+		monoPopFront(&deque->minMax->minima,circularListFront(deque));
+		monoPopFront(&deque->minMax->maxima,circularListFront(deque));
+	}
+	if(deque->ring !=0)
+	{
+		ringRemove(deque,1);
+	}
+	else
+	{
+		removeLink(deque,deque->sentinel->next);
+	}
 
 }
 
@@ -262,10 +1281,21 @@ void circularListRemoveBack(struct CircularList* deque)
 	/* FIXME: You will write this function */
 	assert(deque !=0);
 	assert(!circularListIsEmpty(deque));
-	removeLink(deque,deque->sentinel->prev);
+	traceOp(TRACE_REMOVE_BACK, deque, traceValue(circularListBack(deque)), deque->size);
+	if(deque->ring !=0)
+	{
+		ringRemove(deque,0);
+	}
+	else
+	{
+		removeLink(deque,deque->sentinel->prev);
+	}
+	minMaxInvalidate(deque);
 
 }
 
+#ifndef CIRCULAR_LIST_INLINE
+
 /**
 	Returns 1 if the deque is empty and 0 otherwise.
 	param:	deque	struct CircularList ptr
@@ -276,7 +1306,7 @@ void circularListRemoveBack(struct CircularList* deque)
 int circularListIsEmpty(struct CircularList* deque)
 {
 	/* FIXME: You will write this function */
-	assert(deque !=0);
+	CIRCULAR_LIST_CHECK(deque !=0);
 	if(deque->size==0)
 	{
 		return 1;
@@ -284,6 +1314,8 @@ int circularListIsEmpty(struct CircularList* deque)
 	return 0;
 }
 
+#endif
+
 /**
 	Prints the values of the links in the deque from front to back.
 	param:	deque	struct CircularList ptr
@@ -302,11 +1334,20 @@ void circularListPrint(struct CircularList* deque)
 		return;
 	}
 
+	if(deque->ring !=0)
+	{
+		for(size_t i = 0; i < deque->size; ++i)
+		{
+			printf(FORMAT_SPECIFIER"\n", deque->ring[ringIndex(deque, i)]);
+		}
+		return;
+	}
+
 	struct Link* temp = deque->sentinel->next;
 
 
 //temp is temporary link variable
-	for(int i = 0; i < deque->size; ++i)
+	for(size_t i = 0; i < deque->size; ++i)
 	{
 	 printf(FORMAT_SPECIFIER"\n", temp->value);
 	 temp = temp->next;
@@ -322,10 +1363,12 @@ void circularListPrint(struct CircularList* deque)
 	(which points to current's prev), so you proceed stepping back through
 	the deque, assigning current's next to current's prev, until current
 	points to the sentinel then you know the each link has been looked at
-	and the link order reversed.
+	and the link order reversed. A ring deque swaps its values end for end
+	instead.
 	param: 	deque 	struct CircularList ptr
 	pre:	deque is not null
 	pre:	deque is not empty
+	pre:	deque does not have concurrent reads on
 	post:	order of deque links is reversed
  */
 void circularListReverse(struct CircularList* deque)
@@ -333,6 +1376,20 @@ void circularListReverse(struct CircularList* deque)
 	/* FIXME: You will write this function */
 	assert(deque !=0);
 	assert(!circularListIsEmpty(deque));
+	assert(deque->readers == 0);
+	traceOp(TRACE_REVERSE, deque, 0, deque->size);
+	if(deque->ring !=0)
+	{
+		for(size_t i = 0, j = deque->size - 1; i < j; ++i, --j)
+		{
+			TYPE tmp = deque->ring[ringIndex(deque, i)];
+			deque->ring[ringIndex(deque, i)] = deque->ring[ringIndex(deque, j)];
+			deque->ring[ringIndex(deque, j)] = tmp;
+		}
+		deque->version++;
+		minMaxInvalidate(deque);
+		return;
+	}
 
 	// current starts pointing to sentinel;
 	struct Link* current = deque->sentinel;
@@ -352,5 +1409,1577 @@ void circularListReverse(struct CircularList* deque)
 	}
 	while (current != deque->sentinel);
 	// until current points to the sentinel
+	deque->version++;
+	minMaxInvalidate(deque);
+
+}
+
+/**
+	Refills a stale min/max tracker from the deque's current values.
+	param:	deque	struct CircularList ptr
+	pre:	deque is not null and has a tracker
+	post:	tracker matches the deque and is no longer stale
+ */
+static void minMaxRebuild(struct CircularList* deque)
+{
+	struct MinMaxTracker* tracker = deque->minMax;
+	tracker->minima.front = 0;
+	tracker->minima.count = 0;
+	tracker->maxima.front = 0;
+	tracker->maxima.count = 0;
+	tracker->stale = 0;
+	if(deque->ring !=0)
+	{
+		for(size_t i = 0; i < deque->size; ++i)
+		{
+			monoPushBack(&tracker->minima,deque->ring[ringIndex(deque, i)],0);
+			monoPushBack(&tracker->maxima,deque->ring[ringIndex(deque, i)],1);
+		}
+		return;
+	}
+	for(struct Link* current = deque->sentinel->next; current != deque->sentinel;
+		current = current->next)
+	{
+		monoPushBack(&tracker->minima,current->value,0);
+		monoPushBack(&tracker->maxima,current->value,1);
+	}
+}
+
+/**
+	Starts tracking the min and max of the deque with two monotonic
+	deques, so that circularListMin and circularListMax are O(1)
+	amortized while the deque is used as a sliding window (adding to the
+	back and removing from the front). Adding to the front, removing from
+	the back, reversing or sorting make the next query rebuild the
+	tracker in O(n). Does nothing if min/max are already tracked.
+	param:	deque	struct CircularList ptr
+	pre:	deque is not null
+	post:	deque has a min/max tracker
+ */
+void circularListTrackMinMax(struct CircularList* deque)
+{
+	assert(deque !=0);
+	if(deque->minMax !=0)
+	{
+		return;
+	}
+	struct MinMaxTracker* tracker = tallyMalloc(sizeof(struct MinMaxTracker));
+	tracker->minima.capacity = 8;
+	tracker->minima.values = tallyMalloc(8 * sizeof(TYPE));
+	tracker->maxima.capacity = 8;
+	tracker->maxima.values = tallyMalloc(8 * sizeof(TYPE));
+	deque->minMax = tracker;
+	minMaxRebuild(deque);
+}
 
+/**
+	Returns the smallest value in the deque by LT. O(1) amortized if min/max
+	are tracked (see circularListTrackMinMax), otherwise O(n).
+	param:	deque	struct CircularList ptr
+	pre:	deque is not null
+	pre:	deque is not empty
+	post:	none
+	ret:	min value
+ */
+TYPE circularListMin(struct CircularList* deque)
+{
+	assert(deque !=0);
+	assert(!circularListIsEmpty(deque));
+	if(deque->minMax !=0)
+	{
+		if(deque->minMax->stale)
+		{
+			minMaxRebuild(deque);
+		}
+		return deque->minMax->minima.values[deque->minMax->minima.front];
+	}
+	TYPE min = circularListFront(deque);
+	for(size_t i = 1; deque->ring !=0 && i < deque->size; ++i)
+	{
+		TYPE value = deque->ring[ringIndex(deque, i)];
+		if(LT(value, min))
+		{
+			min = value;
+		}
+	}
+	for(struct Link* current = deque->sentinel->next->next; deque->ring == 0
+		&& current != deque->sentinel; current = current->next)
+	{
+		if(LT(current->value, min))
+		{
+			min = current->value;
+		}
+	}
+	return min;
+}
+
+/**
+	Returns the largest value in the deque by LT. O(1) amortized if min/max
+	are tracked (see circularListTrackMinMax), otherwise O(n).
+	param:	deque	struct CircularList ptr
+	pre:	deque is not null
+	pre:	deque is not empty
+	post:	none
+	ret:	max value
+ */
+TYPE circularListMax(struct CircularList* deque)
+{
+	assert(deque !=0);
+	assert(!circularListIsEmpty(deque));
+	if(deque->minMax !=0)
+	{
+		if(deque->minMax->stale)
+		{
+			minMaxRebuild(deque);
+		}
+		return deque->minMax->maxima.values[deque->minMax->maxima.front];
+	}
+	TYPE max = circularListFront(deque);
+	for(size_t i = 1; deque->ring !=0 && i < deque->size; ++i)
+	{
+		TYPE value = deque->ring[ringIndex(deque, i)];
+		if(LT(max, value))
+		{
+			max = value;
+		}
+	}
+	for(struct Link* current = deque->sentinel->next->next; deque->ring == 0
+		&& current != deque->sentinel; current = current->next)
+	{
+		if(LT(max, current->value))
+		{
+			max = current->value;
+		}
+	}
+	return max;
+}
+
+/**
+	Lets other threads scan the deque (see circularListScan) while one
+	writer thread keeps adding and removing at the ends. From now on
+	removed links are only freed after every scan that could still be
+	looking at them has finished, and reversing or sorting the deque is
+	not allowed. Does nothing if concurrent reads are already on.
+	param:	deque	struct CircularList ptr
+	pre:	deque is not null
+	pre:	deque is linked, not a ring deque (a ring moves its values
+			when it grows, so readers can't follow them)
+	post:	deque has concurrent reads on
+ */
+void circularListEnableConcurrentReads(struct CircularList* deque)
+{
+	assert(deque !=0);
+	assert(deque->ring == 0);
+	if(deque->readers !=0)
+	{
+		return;
+	}
+	struct ReadEpochs* readers = tallyMalloc(sizeof(struct ReadEpochs));
+	readers->epoch = 1;
+	for(int i = 0; i < READER_SLOTS; ++i)
+	{
+		readers->slots[i] = 0;
+	}
+	for(int i = 0; i < 3; ++i)
+	{
+		readers->overflow[i] = 0;
+		readers->limbo[i] = 0;
+	}
+	__atomic_store_n(&deque->readers, readers, __ATOMIC_SEQ_CST);
+}
+
+/**
+	Calls visit on every value of the deque from front to back. With
+	concurrent reads on this may run on any number of threads while the
+	writer adds and removes at the ends: it never takes a lock or waits
+	for the writer, and sees each value that stays in the deque for the
+	whole scan (values added or removed during the scan may or may not
+	be seen). Each scan holds one of READER_SLOTS reader slots; once
+	they are all taken, further scans count themselves in a shared
+	counter instead, which is slower under contention but never waits.
+	param:	deque	struct CircularList ptr
+	param:	visit	function called with each value and context
+	param:	context	passed through to visit
+	pre:	deque and visit are not null
+	pre:	deque has concurrent reads on, or no other thread changes it
+	post:	none
+	ret:	number of values visited
+ */
+size_t circularListScan(struct CircularList* deque, void (*visit)(TYPE value, void* context),
+	void* context)
+{
+	assert(deque !=0 && visit !=0);
+	struct ReadEpochs* readers = __atomic_load_n(&deque->readers, __ATOMIC_ACQUIRE);
+	int slot = -1;
+	unsigned long epoch = 0;
+	if(readers !=0)
+	{
+		// claim a free slot, announcing the epoch this scan starts in
+		epoch = __atomic_load_n(&readers->epoch, __ATOMIC_SEQ_CST);
+		for(int i = 0; slot < 0 && i < READER_SLOTS; ++i)
+		{
+			unsigned long free = 0;
+			if(__atomic_compare_exchange_n(&readers->slots[i], &free, epoch, 0,
+				__ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+			{
+				slot = i;
+			}
+		}
+		if(slot < 0)
+		{
+			__atomic_add_fetch(&readers->overflow[epoch % 3], 1, __ATOMIC_SEQ_CST);
+		}
+	}
+	size_t count = 0;
+	for(; deque->ring !=0 && count < deque->size; ++count)
+	{
+		visit(deque->ring[ringIndex(deque, count)], context);
+	}
+	struct Link* current = __atomic_load_n(&deque->sentinel->next, __ATOMIC_ACQUIRE);
+	while(current != deque->sentinel)
+	{
+		visit(current->value, context);
+		count++;
+		current = __atomic_load_n(&current->next, __ATOMIC_ACQUIRE);
+	}
+	if(slot >= 0)
+	{
+		__atomic_store_n(&readers->slots[slot], 0, __ATOMIC_RELEASE);
+	}
+	else if(readers !=0)
+	{
+		__atomic_sub_fetch(&readers->overflow[epoch % 3], 1, __ATOMIC_RELEASE);
+	}
+	return count;
+}
+
+// One piece of a deque being sorted by its own thread
+struct SortTask
+{
+	struct Link* chain;
+	pthread_t thread;
+	int started;
+};
+
+/**
+	Merges two sorted chains (linked through next, ending in null) into
+	one. Ties are taken from the first chain, which keeps the merge stable.
+	param:	a	struct Link ptr, the earlier chain
+	param:	b	struct Link ptr, the later chain
+	pre:	a and b are sorted by LT
+	post:	next pointers are relinked; prev pointers are not touched
+	ret:	head of the merged chain
+ */
+static struct Link* mergeChains(struct Link* a, struct Link* b)
+{
+	struct Link* head = 0;
+	struct Link** tail = &head;
+	while (a != 0 && b != 0)
+	{
+		if (LT(b->value, a->value))
+		{
+			*tail = b;
+			b = b->next;
+		}
+		else
+		{
+			*tail = a;
+			a = a->next;
+		}
+		tail = &(*tail)->next;
+	}
+	*tail = a != 0 ? a : b;
+	return head;
+}
+
+/**
+	Sorts a chain (linked through next, ending in null) with a bottom-up
+	merge sort. bins[i] holds a sorted run of 2^i links, so no memory is
+	allocated and runs are always merged older-first, keeping it stable.
+	param:	chain	struct Link ptr
+	pre:	none
+	post:	next pointers are relinked; prev pointers are not touched
+	ret:	head of the sorted chain
+ */
+static struct Link* sortChain(struct Link* chain)
+{
+	struct Link* bins[64] = { 0 };
+	int i;
+	while (chain != 0)
+	{
+		struct Link* carry = chain;
+		chain = chain->next;
+		carry->next = 0;
+		for (i = 0; i < 63 && bins[i] != 0; ++i)
+		{
+			carry = mergeChains(bins[i], carry);
+			bins[i] = 0;
+		}
+		bins[i] = mergeChains(bins[i], carry);
+	}
+	struct Link* sorted = 0;
+	for (i = 0; i < 64; ++i)
+	{
+		sorted = mergeChains(bins[i], sorted);
+	}
+	return sorted;
+}
+
+/**
+	Thread entry point that sorts one task's chain.
+	param:	arg		struct SortTask ptr
+	pre:	arg is not null
+	post:	task chain is sorted
+	ret:	null
+ */
+static void* sortTask(void* arg)
+{
+	struct SortTask* task = arg;
+	task->chain = sortChain(task->chain);
+	return 0;
+}
+
+/**
+	Attaches a chain (linked through next, ending in null) after the
+	deque's sentinel and restores the prev pointers along it.
+	param:	deque	struct CircularList ptr
+	param:	chain	struct Link ptr to attach
+	pre:	deque is not null
+	post:	deque links are chain, front to back, with prev pointers set
+ */
+static void attachChain(struct CircularList* deque, struct Link* chain)
+{
+	struct Link* prev = deque->sentinel;
+	while (chain != 0)
+	{
+		prev->next = chain;
+		chain->prev = prev;
+		prev = chain;
+		chain = chain->next;
+	}
+	prev->next = deque->sentinel;
+	deque->sentinel->prev = prev;
+	deque->version++;
+	minMaxInvalidate(deque);
+}
+
+/**
+	Sorts an array by LT with a stable bottom-up merge sort, merging runs
+	back and forth between the array and scratch.
+	param:	values	array of count values
+	param:	scratch	array with room for count values
+	param:	count	size_t
+	pre:	values and scratch are not null
+	post:	values are in non-decreasing order by LT; equal values keep
+			their original order
+ */
+static void sortValues(TYPE* values, TYPE* scratch, size_t count)
+{
+	TYPE* from = values;
+	TYPE* to = scratch;
+	for (size_t width = 1; width < count; width *= 2)
+	{
+		for (size_t low = 0; low < count; low += 2 * width)
+		{
+			size_t mid = low + width < count ? low + width : count;
+			size_t high = low + 2 * width < count ? low + 2 * width : count;
+			size_t a = low;
+			size_t b = mid;
+			for (size_t i = low; i < high; ++i)
+			{
+				to[i] = b < high && (a == mid || LT(from[b], from[a])) ? from[b++] : from[a++];
+			}
+		}
+		TYPE* swap = from;
+		from = to;
+		to = swap;
+	}
+	if (from != values)
+	{
+		memcpy(values, from, count * sizeof(TYPE));
+	}
+}
+
+/**
+	Sorts the deque in place by LT with a stable bottom-up merge sort that
+	relinks the existing links, so no memory is allocated. O(n log n).
+	A ring deque is sorted in its ring, using a scratch array of the same
+	size.
+	param:	deque	struct CircularList ptr
+	pre:	deque is not null
+	pre:	deque does not have concurrent reads on
+	post:	deque values are in non-decreasing order by LT; equal values
+			keep their original order
+ */
+void circularListSort(struct CircularList* deque)
+{
+	circularListSortParallel(deque, 1);
+}
+
+/**
+	Sorts the deque like circularListSort, but splits it into one piece per
+	thread, sorts the pieces at the same time and then merges them in
+	order. If a thread can't be started its piece is sorted by the
+	calling thread instead. A ring deque is always sorted by the calling
+	thread.
+	param:	deque	struct CircularList ptr
+	param:	threads	number of threads to sort with (at most SORT_MAX_THREADS)
+	pre:	deque is not null
+	pre:	threads >= 1
+	pre:	deque does not have concurrent reads on
+	post:	deque values are in non-decreasing order by LT; equal values
+			keep their original order
+ */
+void circularListSortParallel(struct CircularList* deque, int threads)
+{
+	assert(deque != 0);
+	assert(threads >= 1);
+	assert(deque->readers == 0);
+	traceOp(TRACE_SORT, deque, 0, deque->size);
+	if (deque->size < 2)
+	{
+		return;
+	}
+	if (threads > SORT_MAX_THREADS)
+	{
+		threads = SORT_MAX_THREADS;
+	}
+	if ((size_t)threads > deque->size)
+	{
+		threads = (int)deque->size;
+	}
+	if (deque->ring != 0)
+	{
+		if (deque->ringFront + deque->size > deque->ringCapacity)
+		{
+			ringResize(deque, deque->ringCapacity);
+		}
+		TYPE* scratch = malloc(deque->size * sizeof(TYPE));
+		assert(scratch != 0);
+		sortValues(deque->ring + deque->ringFront, scratch, deque->size);
+		free(scratch);
+		deque->version++;
+		minMaxInvalidate(deque);
+		return;
+	}
+	deque->sentinel->prev->next = 0;
+	struct Link* chain = deque->sentinel->next;
+	if (threads == 1)
+	{
+		attachChain(deque, sortChain(chain));
+		return;
+	}
+
+	// cut the chain into pieces of about size / threads links each
+	struct SortTask tasks[SORT_MAX_THREADS];
+	int i;
+	for (i = 0; i < threads; ++i)
+	{
+		size_t count = deque->size / threads + ((size_t)i < deque->size % threads);
+		tasks[i].chain = chain;
+		for (size_t j = 1; j < count; ++j)
+		{
+			chain = chain->next;
+		}
+		struct Link* next = chain->next;
+		chain->next = 0;
+		chain = next;
+		tasks[i].started = i > 0
+			&& pthread_create(&tasks[i].thread, 0, sortTask, &tasks[i]) == 0;
+	}
+	for (i = 0; i < threads; ++i)
+	{
+		if (tasks[i].started)
+		{
+			pthread_join(tasks[i].thread, 0);
+		}
+		else
+		{
+			sortTask(&tasks[i]);
+		}
+	}
+	// merge neighbouring pieces in rounds, earlier piece first
+	for (int width = 1; width < threads; width *= 2)
+	{
+		for (i = 0; i + width < threads; i += 2 * width)
+		{
+			tasks[i].chain = mergeChains(tasks[i].chain, tasks[i + width].chain);
+		}
+	}
+	attachChain(deque, tasks[0].chain);
+}
+
+// Piece of a deque being reduced: a whole segment, or what the deque
+// holds of the segment at either of its ends
+struct ReducePiece
+{
+	struct Link* first;
+	size_t ringStart;			// index of the piece's first value in ring
+	size_t count;
+	void* partial;
+	int cached;					// partial is already up to date
+};
+
+// One reduction, shared by the calling thread and the workers helping it
+struct ReduceJob
+{
+	const struct CircularListReducer* reducer;
+	const TYPE* ring;			// null unless the deque is a ring deque
+	size_t ringCapacity;
+	struct ReducePiece* pieces;
+	size_t count;
+	size_t next;				// next piece to take, claimed atomically
+};
+
+// Worker threads kept for every reduction in the process, started as
+// they are first needed. One reduction at a time gets their help; a
+// reduction that finds them busy runs on its calling thread alone.
+struct ReducePool
+{
+	pthread_mutex_t busy;		// held by the reduction using the workers
+	pthread_mutex_t lock;		// guards the fields below
+	pthread_cond_t wake;
+	pthread_cond_t done;
+	int workers;
+	struct ReduceJob* job;		// null when there is nothing to help with
+	int helpers;				// workers that may join job
+	int joined;
+	int finished;
+};
+
+static struct ReducePool reducePool = {
+	PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+	PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER, 0, 0, 0, 0, 0
+};
+
+/**
+	Reduces one piece: copies its values into a local block and hands
+	each full block to the reducer's accumulate. The piece of a ring
+	deque is handed over in place instead, as one part or two if it wraps
+	around the end of the ring.
+	param:	job		struct ReduceJob ptr
+	param:	piece	struct ReducePiece ptr
+	pre:	job and piece are not null and piece's partial has been
+			through init
+	post:	every value of the piece has been accumulated into its partial
+ */
+static void reducePiece(struct ReduceJob* job, struct ReducePiece* piece)
+{
+	const struct CircularListReducer* reducer = job->reducer;
+	TYPE block[REDUCE_BLOCK];
+	struct Link* current = piece->first;
+	size_t remaining = piece->count;
+	size_t start = piece->ringStart;
+	while(job->ring !=0 && remaining > 0)
+	{
+		size_t count = job->ringCapacity - start < remaining ? job->ringCapacity - start : remaining;
+		reducer->accumulate(piece->partial, job->ring + start, count, reducer->context);
+		start = 0;
+		remaining -= count;
+	}
+	while(remaining > 0)
+	{
+		size_t count = remaining < REDUCE_BLOCK ? remaining : REDUCE_BLOCK;
+		for(size_t i = 0; i < count; ++i)
+		{
+			block[i] = current->value;
+			current = current->next;
+		}
+		reducer->accumulate(piece->partial, block, count, reducer->context);
+		remaining -= count;
+	}
+}
+
+/**
+	Takes pieces of the job that are not cached, one at a time, and
+	reduces them until none are left.
+	param:	job		struct ReduceJob ptr
+	pre:	job is not null
+	post:	every piece has been taken by this or another thread
+ */
+static void reducePieces(struct ReduceJob* job)
+{
+	size_t i;
+	while((i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) < job->count)
+	{
+		if(!job->pieces[i].cached)
+		{
+			reducePiece(job, &job->pieces[i]);
+		}
+	}
+}
+
+/**
+	Thread entry point of a pool worker: waits for a job it may join,
+	helps with it, and goes back to waiting. Never returns.
+	param:	arg		unused
+	pre:	none
+	post:	none
+	ret:	null
+ */
+static void* reduceWorker(void* arg)
+{
+	(void)arg;
+	pthread_mutex_lock(&reducePool.lock);
+	for(;;)
+	{
+		while(reducePool.job == 0 || reducePool.joined == reducePool.helpers)
+		{
+			pthread_cond_wait(&reducePool.wake, &reducePool.lock);
+		}
+		struct ReduceJob* job = reducePool.job;
+		reducePool.joined++;
+		pthread_mutex_unlock(&reducePool.lock);
+		reducePieces(job);
+		pthread_mutex_lock(&reducePool.lock);
+		reducePool.finished++;
+		pthread_cond_signal(&reducePool.done);
+	}
+	return 0;
+}
+
+/**
+	Runs a job on the calling thread with the help of up to threads - 1
+	pool workers, starting more workers if the pool has too few. If the
+	pool is busy with another reduction, or no worker can be started,
+	the calling thread does all of it.
+	param:	job		struct ReduceJob ptr
+	param:	threads	number of threads to run it on
+	pre:	job is not null and its partials have been through init
+	post:	every piece of the job has been reduced
+ */
+static void runReduceJob(struct ReduceJob* job, int threads)
+{
+	if(threads < 2 || pthread_mutex_trylock(&reducePool.busy) != 0)
+	{
+		reducePieces(job);
+		return;
+	}
+	while(reducePool.workers < threads - 1)
+	{
+		pthread_t thread;
+		if(pthread_create(&thread, 0, reduceWorker, 0) != 0)
+		{
+			break;
+		}
+		pthread_detach(thread);
+		reducePool.workers++;
+	}
+	pthread_mutex_lock(&reducePool.lock);
+	reducePool.job = job;
+	reducePool.helpers = threads - 1 < reducePool.workers ? threads - 1 : reducePool.workers;
+	reducePool.joined = 0;
+	reducePool.finished = 0;
+	pthread_cond_broadcast(&reducePool.wake);
+	pthread_mutex_unlock(&reducePool.lock);
+	reducePieces(job);
+	pthread_mutex_lock(&reducePool.lock);
+	while(reducePool.finished != reducePool.joined)
+	{
+		pthread_cond_wait(&reducePool.done, &reducePool.lock);
+	}
+	reducePool.job = 0;
+	pthread_mutex_unlock(&reducePool.lock);
+	pthread_mutex_unlock(&reducePool.busy);
+}
+
+/**
+	Returns the deque's reduce cache, made ready for a reduction with the
+	given reducer: made if the deque has none, emptied if the deque was
+	reordered or the reducer is a different one, and given enough slots
+	for every segment the deque covers.
+	param:	deque	struct CircularList ptr
+	param:	reducer	struct CircularListReducer ptr
+	pre:	deque and reducer are not null
+	post:	cache has at least size / REDUCE_SEGMENT + 2 slots
+	ret:	the cache
+ */
+static struct ReduceCache* reduceCache(struct CircularList* deque,
+	const struct CircularListReducer* reducer)
+{
+	struct ReduceCache* cache = deque->reduceCache;
+	if(cache == 0)
+	{
+		cache = tallyMalloc(sizeof(struct ReduceCache));
+		assert(cache !=0);
+		cache->front = REDUCE_ORIGIN;
+		cache->low = REDUCE_ORIGIN;
+		cache->high = REDUCE_ORIGIN;
+		cache->slots = 0;
+		cache->segments = 0;
+		cache->partials = 0;
+		cache->reducer = *reducer;
+		deque->reduceCache = cache;
+	}
+	size_t needed = deque->size / REDUCE_SEGMENT + 2;
+	if(cache->slots < needed || cache->reducer.partialSize != reducer->partialSize
+		|| cache->reducer.init != reducer->init || cache->reducer.accumulate != reducer->accumulate
+		|| cache->reducer.combine != reducer->combine || cache->reducer.context != reducer->context)
+	{
+		freeReduceSlots(cache);
+		size_t slots = 4;
+		while(slots < needed)
+		{
+			slots *= 2;
+		}
+		cache->reducer = *reducer;
+		cache->segments = tallyMalloc(slots * sizeof(unsigned long long));
+		cache->partials = tallyMalloc(slots * reducer->partialSize);
+		assert(cache->segments !=0 && cache->partials !=0);
+		cache->slots = slots;
+		cache->version = deque->version + 1;
+	}
+	if(cache->version != deque->version)
+	{
+		memset(cache->segments, 0, cache->slots * sizeof(unsigned long long));
+		cache->version = deque->version;
+	}
+	return cache;
+}
+
+/**
+	Reduces every value of the deque to a single result in parallel. The
+	deque is cut into segments of REDUCE_SEGMENT values; pool workers
+	and the calling thread each take segments that still need reducing
+	and accumulate each into its own partial, and the partials are then
+	combined into result in front to back order. The partial of every
+	whole segment is kept with the deque, and reused as long as the
+	segment's values stay put, which adds and removes at either end
+	don't change: a sliding window only reduces the segments at its two
+	ends again. Reordering the deque, clearing it or passing a reducer
+	with other functions or context starts over. The reducer must give
+	the same partial for the same values every time. The deque must not
+	change while this runs. A ring deque's values are handed to
+	accumulate straight from its ring, so the blocks may be longer than
+	REDUCE_BLOCK.
+	param:	deque	struct CircularList ptr
+	param:	reducer	struct CircularListReducer ptr
+	param:	threads	number of threads to reduce with (at most REDUCE_MAX_THREADS)
+	param:	result	memory for the final result
+	pre:	deque, reducer and result are not null
+	pre:	threads >= 1
+	pre:	result has already been through reducer init (or holds the
+			identity of the reduction)
+	post:	every partial has been combined into result
+ */
+void circularListReduce(struct CircularList* deque, const struct CircularListReducer* reducer,
+	int threads, void* result)
+{
+	assert(deque !=0 && reducer !=0 && result !=0);
+	assert(threads >= 1);
+	if(deque->size == 0)
+	{
+		return;
+	}
+	if(threads > REDUCE_MAX_THREADS)
+	{
+		threads = REDUCE_MAX_THREADS;
+	}
+	struct ReduceCache* cache = reduceCache(deque, reducer);
+	unsigned long long front = cache->front;
+	unsigned long long back = front + deque->size;
+	unsigned long long firstSegment = front / REDUCE_SEGMENT;
+	size_t count = (size_t)((back - 1) / REDUCE_SEGMENT - firstSegment) + 1;
+	struct ReducePiece* pieces = malloc(count * sizeof(struct ReducePiece));
+	char* ends = malloc(2 * reducer->partialSize);
+	assert(pieces !=0 && ends !=0);
+
+	// cached pieces run from lead up to trail; the rest are reduced again
+	size_t lead = count;
+	size_t trail = 0;
+	size_t i;
+	for(i = 0; i < count; ++i)
+	{
+		unsigned long long segment = firstSegment + i;
+		unsigned long long low = segment * REDUCE_SEGMENT;
+		unsigned long long high = low + REDUCE_SEGMENT;
+		low = low > front ? low : front;
+		high = high < back ? high : back;
+		struct ReducePiece* piece = &pieces[i];
+		piece->first = 0;
+		piece->ringStart = deque->ring !=0 ? ringIndex(deque, (size_t)(low - front)) : 0;
+		piece->count = (size_t)(high - low);
+		piece->cached = 0;
+		if(piece->count == REDUCE_SEGMENT)
+		{
+			size_t slot = (size_t)(segment & (cache->slots - 1));
+			piece->partial = cache->partials + slot * reducer->partialSize;
+			piece->cached = cache->segments[slot] == segment
+				&& low >= cache->low && high <= cache->high;
+			cache->segments[slot] = segment;
+		}
+		else
+		{
+			piece->partial = ends + (i == 0 ? 0 : reducer->partialSize);
+		}
+		if(piece->cached)
+		{
+			lead = lead < i ? lead : i;
+			trail = i + 1;
+		}
+	}
+	for(i = lead; i < trail; ++i)
+	{
+		if(!pieces[i].cached)
+		{
+			lead = count;
+		}
+	}
+	trail = trail > lead ? trail : lead;
+
+	size_t uncached = 0;
+	for(i = 0; i < count; ++i)
+	{
+		if(!pieces[i].cached)
+		{
+			reducer->init(pieces[i].partial, reducer->context);
+			uncached++;
+		}
+	}
+	// pieces in front of the cached ones are found from the front, and
+	// pieces behind them from the back
+	if(deque->ring == 0)
+	{
+		struct Link* current = deque->sentinel->next;
+		for(i = 0; i < lead; ++i)
+		{
+			pieces[i].first = current;
+			for(size_t j = 0; j < pieces[i].count; ++j)
+			{
+				current = current->next;
+			}
+		}
+		current = deque->sentinel->prev;
+		for(i = count; i > trail; --i)
+		{
+			for(size_t j = 1; j < pieces[i - 1].count; ++j)
+			{
+				current = current->prev;
+			}
+			pieces[i - 1].first = current;
+			current = current->prev;
+		}
+	}
+
+	struct ReduceJob job = {
+		reducer, deque->ring, deque->ringCapacity, pieces, count, 0
+	};
+	runReduceJob(&job, (size_t)threads < uncached ? threads : (int)uncached);
+	for(i = 0; i < count; ++i)
+	{
+		reducer->combine(result, pieces[i].partial, reducer->context);
+	}
+	cache->low = front;
+	cache->high = back;
+	free(ends);
+	free(pieces);
+}
+
+/*
+	Summary statistics are reduced in blocks of at most REDUCE_BLOCK
+	values. A block is summed (with Kahan compensation in every vector
+	lane) and searched for its min and max by one kernel, then a second
+	kernel sums its squared differences from the block's own mean while
+	it is still in cache. Blocks are folded together with Neumaier
+	summation for the sum and Chan's pairwise update for the variance,
+	so neither drifts on long deques or values far from zero.
+*/
+
+#define TYPE_IS_DOUBLE ((TYPE)0.5 != 0 && sizeof(TYPE) == sizeof(double))
+
+// Kernels over one block of values, picked once for the CPU
+struct StatsKernels
+{
+	void (*sumMinMax)(const double* values, size_t count, double* sum, double* min, double* max);
+	double (*sumSquares)(const double* values, size_t count, double mean);
+};
+
+// Statistics of the values reduced so far
+struct StatsPartial
+{
+	size_t count;
+	double sum;
+	double compensation;	// rounding error of sum, to be added back
+	double mean;
+	double m2;				// sum of squared differences from mean
+	double min;
+	double max;
+};
+
+/**
+	Adds a value to a running sum, keeping the rounding error of every
+	addition in a separate compensation term (Neumaier summation).
+	param:	sum				double ptr
+	param:	compensation	double ptr
+	param:	value			double
+	pre:	sum and compensation are not null
+	post:	sum + compensation is the total including value
+ */
+static void compensatedAdd(double* sum, double* compensation, double value)
+{
+	double total = *sum + value;
+	double sumMagnitude = *sum < 0 ? -*sum : *sum;
+	double valueMagnitude = value < 0 ? -value : value;
+	if(sumMagnitude >= valueMagnitude)
+	{
+		*compensation += (*sum - total) + value;
+	}
+	else
+	{
+		*compensation += (value - total) + *sum;
+	}
+	*sum = total;
+}
+
+/**
+	Scalar kernel: Kahan sum, min and max of a block.
+	param:	values	array of count doubles
+	param:	count	size_t
+	param:	sum		double ptr for the sum
+	param:	min		double ptr for the smallest value
+	param:	max		double ptr for the largest value
+	pre:	count > 0 and no pointer is null
+	post:	sum, min and max are set
+ */
+static void sumMinMaxScalar(const double* values, size_t count, double* sum, double* min, double* max)
+{
+	double total = 0;
+	double compensation = 0;
+	double low = values[0];
+	double high = values[0];
+	for(size_t i = 0; i < count; ++i)
+	{
+		double y = values[i] - compensation;
+		double t = total + y;
+		compensation = (t - total) - y;
+		total = t;
+		low = values[i] < low ? values[i] : low;
+		high = values[i] > high ? values[i] : high;
+	}
+	*sum = total;
+	*min = low;
+	*max = high;
+}
+
+/**
+	Scalar kernel: sum of the squared differences of a block's values
+	from the given mean.
+	param:	values	array of count doubles
+	param:	count	size_t
+	param:	mean	double
+	pre:	values is not null
+	post:	none
+	ret:	sum of (value - mean)^2
+ */
+static double sumSquaresScalar(const double* values, size_t count, double mean)
+{
+	double total = 0;
+	for(size_t i = 0; i < count; ++i)
+	{
+		double difference = values[i] - mean;
+		total += difference * difference;
+	}
+	return total;
+}
+
+/**
+	Finishes a vector kernel: folds its lane sums and compensations, its
+	lane minima and maxima and the values left over after the last full
+	vector step into the block's sum, min and max.
+	param:	sums			array of lanes doubles
+	param:	compensations	array of lanes doubles
+	param:	lows			array of lanes doubles
+	param:	highs			array of lanes doubles
+	param:	lanes			int
+	param:	rest			array of restCount doubles
+	param:	restCount		size_t
+	param:	sum, min, max	double ptrs for the results
+	pre:	no pointer is null
+	post:	sum, min and max are set
+ */
+static void foldLanes(const double* sums, const double* compensations, const double* lows,
+	const double* highs, int lanes, const double* rest, size_t restCount,
+	double* sum, double* min, double* max)
+{
+	double total = 0;
+	double compensation = 0;
+	double low = lows[0];
+	double high = highs[0];
+	for(int i = 0; i < lanes; ++i)
+	{
+		compensatedAdd(&total, &compensation, sums[i]);
+		compensatedAdd(&total, &compensation, -compensations[i]);
+		low = lows[i] < low ? lows[i] : low;
+		high = highs[i] > high ? highs[i] : high;
+	}
+	for(size_t i = 0; i < restCount; ++i)
+	{
+		compensatedAdd(&total, &compensation, rest[i]);
+		low = rest[i] < low ? rest[i] : low;
+		high = rest[i] > high ? rest[i] : high;
+	}
+	*sum = total + compensation;
+	*min = low;
+	*max = high;
+}
+
+#ifdef STATS_X86
+
+/**
+	AVX2 kernel: as sumMinMaxScalar, eight values at a time in two
+	vectors of four lanes.
+ */
+__attribute__((target("avx2")))
+static void sumMinMaxAvx2(const double* values, size_t count, double* sum, double* min, double* max)
+{
+	__m256d total0 = _mm256_setzero_pd();
+	__m256d total1 = _mm256_setzero_pd();
+	__m256d compensation0 = _mm256_setzero_pd();
+	__m256d compensation1 = _mm256_setzero_pd();
+	__m256d low0 = _mm256_set1_pd(values[0]);
+	__m256d low1 = low0;
+	__m256d high0 = low0;
+	__m256d high1 = low0;
+	size_t i = 0;
+	for(; i + 8 <= count; i += 8)
+	{
+		__m256d x0 = _mm256_loadu_pd(values + i);
+		__m256d x1 = _mm256_loadu_pd(values + i + 4);
+		__m256d y0 = _mm256_sub_pd(x0, compensation0);
+		__m256d y1 = _mm256_sub_pd(x1, compensation1);
+		__m256d t0 = _mm256_add_pd(total0, y0);
+		__m256d t1 = _mm256_add_pd(total1, y1);
+		compensation0 = _mm256_sub_pd(_mm256_sub_pd(t0, total0), y0);
+		compensation1 = _mm256_sub_pd(_mm256_sub_pd(t1, total1), y1);
+		total0 = t0;
+		total1 = t1;
+		low0 = _mm256_min_pd(low0, x0);
+		low1 = _mm256_min_pd(low1, x1);
+		high0 = _mm256_max_pd(high0, x0);
+		high1 = _mm256_max_pd(high1, x1);
+	}
+	double sums[8], compensations[8], lows[8], highs[8];
+	_mm256_storeu_pd(sums, total0);
+	_mm256_storeu_pd(sums + 4, total1);
+	_mm256_storeu_pd(compensations, compensation0);
+	_mm256_storeu_pd(compensations + 4, compensation1);
+	_mm256_storeu_pd(lows, low0);
+	_mm256_storeu_pd(lows + 4, low1);
+	_mm256_storeu_pd(highs, high0);
+	_mm256_storeu_pd(highs + 4, high1);
+	foldLanes(sums, compensations, lows, highs, 8, values + i, count - i, sum, min, max);
+}
+
+/**
+	AVX2 kernel: as sumSquaresScalar, eight values at a time.
+ */
+__attribute__((target("avx2")))
+static double sumSquaresAvx2(const double* values, size_t count, double mean)
+{
+	__m256d center = _mm256_set1_pd(mean);
+	__m256d total0 = _mm256_setzero_pd();
+	__m256d total1 = _mm256_setzero_pd();
+	size_t i = 0;
+	for(; i + 8 <= count; i += 8)
+	{
+		__m256d d0 = _mm256_sub_pd(_mm256_loadu_pd(values + i), center);
+		__m256d d1 = _mm256_sub_pd(_mm256_loadu_pd(values + i + 4), center);
+		total0 = _mm256_add_pd(total0, _mm256_mul_pd(d0, d0));
+		total1 = _mm256_add_pd(total1, _mm256_mul_pd(d1, d1));
+	}
+	double lanes[4];
+	_mm256_storeu_pd(lanes, _mm256_add_pd(total0, total1));
+	return lanes[0] + lanes[1] + lanes[2] + lanes[3]
+		+ sumSquaresScalar(values + i, count - i, mean);
+}
+
+/**
+	SSE2 kernel: as sumMinMaxScalar, four values at a time in two
+	vectors of two lanes.
+ */
+__attribute__((target("sse2")))
+static void sumMinMaxSse2(const double* values, size_t count, double* sum, double* min, double* max)
+{
+	__m128d total0 = _mm_setzero_pd();
+	__m128d total1 = _mm_setzero_pd();
+	__m128d compensation0 = _mm_setzero_pd();
+	__m128d compensation1 = _mm_setzero_pd();
+	__m128d low0 = _mm_set1_pd(values[0]);
+	__m128d low1 = low0;
+	__m128d high0 = low0;
+	__m128d high1 = low0;
+	size_t i = 0;
+	for(; i + 4 <= count; i += 4)
+	{
+		__m128d x0 = _mm_loadu_pd(values + i);
+		__m128d x1 = _mm_loadu_pd(values + i + 2);
+		__m128d y0 = _mm_sub_pd(x0, compensation0);
+		__m128d y1 = _mm_sub_pd(x1, compensation1);
+		__m128d t0 = _mm_add_pd(total0, y0);
+		__m128d t1 = _mm_add_pd(total1, y1);
+		compensation0 = _mm_sub_pd(_mm_sub_pd(t0, total0), y0);
+		compensation1 = _mm_sub_pd(_mm_sub_pd(t1, total1), y1);
+		total0 = t0;
+		total1 = t1;
+		low0 = _mm_min_pd(low0, x0);
+		low1 = _mm_min_pd(low1, x1);
+		high0 = _mm_max_pd(high0, x0);
+		high1 = _mm_max_pd(high1, x1);
+	}
+	double sums[4], compensations[4], lows[4], highs[4];
+	_mm_storeu_pd(sums, total0);
+	_mm_storeu_pd(sums + 2, total1);
+	_mm_storeu_pd(compensations, compensation0);
+	_mm_storeu_pd(compensations + 2, compensation1);
+	_mm_storeu_pd(lows, low0);
+	_mm_storeu_pd(lows + 2, low1);
+	_mm_storeu_pd(highs, high0);
+	_mm_storeu_pd(highs + 2, high1);
+	foldLanes(sums, compensations, lows, highs, 4, values + i, count - i, sum, min, max);
+}
+
+/**
+	SSE2 kernel: as sumSquaresScalar, four values at a time.
+ */
+__attribute__((target("sse2")))
+static double sumSquaresSse2(const double* values, size_t count, double mean)
+{
+	__m128d center = _mm_set1_pd(mean);
+	__m128d total0 = _mm_setzero_pd();
+	__m128d total1 = _mm_setzero_pd();
+	size_t i = 0;
+	for(; i + 4 <= count; i += 4)
+	{
+		__m128d d0 = _mm_sub_pd(_mm_loadu_pd(values + i), center);
+		__m128d d1 = _mm_sub_pd(_mm_loadu_pd(values + i + 2), center);
+		total0 = _mm_add_pd(total0, _mm_mul_pd(d0, d0));
+		total1 = _mm_add_pd(total1, _mm_mul_pd(d1, d1));
+	}
+	double lanes[2];
+	_mm_storeu_pd(lanes, _mm_add_pd(total0, total1));
+	return lanes[0] + lanes[1] + sumSquaresScalar(values + i, count - i, mean);
+}
+
+static const struct StatsKernels avx2Kernels = { sumMinMaxAvx2, sumSquaresAvx2 };
+static const struct StatsKernels sse2Kernels = { sumMinMaxSse2, sumSquaresSse2 };
+
+#endif
+
+static const struct StatsKernels scalarKernels = { sumMinMaxScalar, sumSquaresScalar };
+
+// Kernels every deque's stats run on, null until they are first picked
+static const struct StatsKernels* statsChosen = 0;
+
+/**
+	Returns the widest kernels the CPU supports, checking only once,
+	unless circularListUseKernels picked others. Built with
+	-DCIRCULAR_LIST_NO_SIMD (or not for x86) this is always the scalar
+	kernels.
+	pre:	none
+	post:	none
+	ret:	struct StatsKernels ptr
+ */
+static const struct StatsKernels* statsKernels()
+{
+	const struct StatsKernels* kernels = __atomic_load_n(&statsChosen, __ATOMIC_ACQUIRE);
+	if(kernels == 0)
+	{
+		kernels = &scalarKernels;
+#ifdef STATS_X86
+		__builtin_cpu_init();
+		if(__builtin_cpu_supports("avx2"))
+		{
+			kernels = &avx2Kernels;
+		}
+		else if(__builtin_cpu_supports("sse2"))
+		{
+			kernels = &sse2Kernels;
+		}
+#endif
+		__atomic_store_n(&statsChosen, kernels, __ATOMIC_RELEASE);
+	}
+	return kernels;
+}
+
+/**
+	Picks the kernels circularListStats runs on for every deque, so they
+	can be checked against each other or a wider one ruled out: the
+	widest the CPU supports (the default), or one set in particular if
+	this build has it and the CPU supports it. A deque's cached partials
+	are dropped the next time its stats are computed on other kernels.
+	Not to be called while stats are being computed.
+	param:	kernels	enum CircularListKernels
+	pre:	none
+	post:	circularListStats runs on the given kernels if 0 is returned
+	ret:	0 on success, -1 if the kernels can't run here
+ */
+int circularListUseKernels(enum CircularListKernels kernels)
+{
+	const struct StatsKernels* picked = 0;
+	if(kernels == CIRCULAR_LIST_KERNELS_SCALAR)
+	{
+		picked = &scalarKernels;
+	}
+#ifdef STATS_X86
+	__builtin_cpu_init();
+	if(kernels == CIRCULAR_LIST_KERNELS_SSE2 && __builtin_cpu_supports("sse2"))
+	{
+		picked = &sse2Kernels;
+	}
+	if(kernels == CIRCULAR_LIST_KERNELS_AVX2 && __builtin_cpu_supports("avx2"))
+	{
+		picked = &avx2Kernels;
+	}
+#endif
+	if(picked == 0 && kernels != CIRCULAR_LIST_KERNELS_BEST)
+	{
+		return -1;
+	}
+	__atomic_store_n(&statsChosen, picked, __ATOMIC_RELEASE);
+	return 0;
+}
+
+/**
+	Reducer init for circularListStats: an empty partial.
+	param:	partial	struct StatsPartial ptr
+	param:	context	unused
+	pre:	partial is not null
+	post:	partial holds no values
+ */
+static void statsInit(void* partial, void* context)
+{
+	(void)context;
+	memset(partial, 0, sizeof(struct StatsPartial));
+}
+
+/**
+	Reducer combine for circularListStats: folds the statistics of the
+	values that come after result's into result.
+	param:	result	struct StatsPartial ptr
+	param:	partial	struct StatsPartial ptr
+	param:	context	unused
+	pre:	result and partial are not null
+	post:	result covers the values of both
+ */
+static void statsCombine(void* result, const void* partial, void* context)
+{
+	struct StatsPartial* into = result;
+	const struct StatsPartial* from = partial;
+	(void)context;
+	if(from->count == 0)
+	{
+		return;
+	}
+	if(into->count == 0)
+	{
+		*into = *from;
+		return;
+	}
+	size_t count = into->count + from->count;
+	double delta = from->mean - into->mean;
+	into->m2 += from->m2 + delta * delta * ((double)into->count * from->count / count);
+	into->mean += delta * from->count / count;
+	compensatedAdd(&into->sum, &into->compensation, from->sum);
+	compensatedAdd(&into->sum, &into->compensation, from->compensation);
+	into->min = from->min < into->min ? from->min : into->min;
+	into->max = from->max > into->max ? from->max : into->max;
+	into->count = count;
+}
+
+/**
+	Reducer accumulate for circularListStats: runs the kernels over each
+	block of at most REDUCE_BLOCK values and combines it into partial.
+	Values of a TYPE other than double are converted a block at a time.
+	param:	partial	struct StatsPartial ptr
+	param:	values	array of count values
+	param:	count	size_t
+	param:	context	struct StatsKernels ptr
+	pre:	partial, values and context are not null
+	post:	partial covers values as well
+ */
+static void statsAccumulate(void* partial, const TYPE* values, size_t count, void* context)
+{
+	const struct StatsKernels* kernels = context;
+	double converted[REDUCE_BLOCK];
+	while(count > 0)
+	{
+		size_t n = count < REDUCE_BLOCK ? count : REDUCE_BLOCK;
+		const double* block = (const double*)values;
+		if(!TYPE_IS_DOUBLE)
+		{
+			for(size_t i = 0; i < n; ++i)
+			{
+				converted[i] = (double)values[i];
+			}
+			block = converted;
+		}
+		struct StatsPartial piece;
+		piece.count = n;
+		kernels->sumMinMax(block, n, &piece.sum, &piece.min, &piece.max);
+		piece.compensation = 0;
+		piece.mean = piece.sum / n;
+		piece.m2 = kernels->sumSquares(block, n, piece.mean);
+		statsCombine(partial, &piece, 0);
+		values += n;
+		count -= n;
+	}
+}
+
+/**
+	Computes the count, sum, mean, population variance, min and max of
+	the deque's values with circularListReduce, so it splits the work
+	over threads the same way. The kernels stream through a ring deque's
+	values in place; a linked deque's values are copied a block at a
+	time first. Min and max compare with <, not LT, and are unspecified
+	if the deque holds NaNs.
+	param:	deque	struct CircularList ptr
+	param:	threads	number of threads to reduce with
+	param:	stats	struct CircularListStats ptr
+	pre:	deque and stats are not null
+	pre:	threads >= 1
+	post:	stats is filled in (all 0 for an empty deque)
+ */
+void circularListStats(struct CircularList* deque, int threads, struct CircularListStats* stats)
+{
+	assert(deque !=0 && stats !=0);
+	struct CircularListReducer reducer = {
+		sizeof(struct StatsPartial), statsInit, statsAccumulate, statsCombine,
+		(void*)statsKernels()
+	};
+	struct StatsPartial total;
+	statsInit(&total, 0);
+	circularListReduce(deque, &reducer, threads, &total);
+	stats->count = total.count;
+	stats->sum = total.sum + total.compensation;
+	stats->mean = total.mean;
+	stats->variance = total.count > 0 ? total.m2 / total.count : 0;
+	stats->min = total.min;
+	stats->max = total.max;
+}
+
+/*
+	Snapshot format: see dequeCommon.h. Only how a value of this build's
+	TYPE is encoded lives here.
+*/
+
+#define SNAPSHOT_INTEGER ((TYPE)0.5 == 0)
+#define SNAPSHOT_KIND (SNAPSHOT_INTEGER ? 'i' : 'f')
+
+/**
+	Writes a value: the zigzag varint of its difference from the previous
+	value for integer TYPEs, its raw little-endian bytes otherwise.
+	param:	stream	struct SnapshotStream ptr
+	param:	value	TYPE
+	param:	prev	TYPE ptr to the previous value, set to value
+	pre:	stream and prev are not null
+	post:	value is written
+ */
+static void snapshotPutValue(struct SnapshotStream* stream, TYPE value, TYPE* prev)
+{
+	if (SNAPSHOT_INTEGER)
+	{
+		snapshotPutDelta(stream, (int64_t)value - (int64_t)*prev);
+		*prev = value;
+		return;
+	}
+	snapshotPutBytes(stream, &value, sizeof(TYPE));
+}
+
+/**
+	Reads a value written by snapshotPutValue.
+	param:	stream	struct SnapshotStream ptr
+	param:	prev	TYPE ptr to the previous value, set to the value read
+	pre:	stream and prev are not null
+	post:	failed is set if the value is cut off
+	ret:	value
+ */
+static TYPE snapshotGetValue(struct SnapshotStream* stream, TYPE* prev)
+{
+	if (SNAPSHOT_INTEGER)
+	{
+		*prev = (TYPE)((int64_t)*prev + snapshotGetDelta(stream));
+		return *prev;
+	}
+	TYPE value;
+	snapshotGetBytes(stream, &value, sizeof(TYPE));
+	return value;
+}
+
+/**
+	Writes the deque's values, front to back, as a binary snapshot.
+	param:	deque 	struct CircularList ptr
+	param:	out		FILE ptr open for writing
+	pre:	deque and out are not null
+	post:	snapshot is written to out; the deque is unchanged
+	ret:	0 on success, -1 if writing failed
+ */
+int circularListWriteSnapshot(struct CircularList* deque, FILE* out)
+{
+	assert(deque !=0 && out !=0);
+	struct SnapshotStream stream = { out, 0, 0 };
+	snapshotPutHeader(&stream, SNAPSHOT_KIND, sizeof(TYPE), deque->size);
+	TYPE prev = 0;
+	for(size_t i = 0; deque->ring !=0 && i < deque->size; ++i)
+	{
+		snapshotPutValue(&stream, deque->ring[ringIndex(deque, i)], &prev);
+	}
+	for(struct Link* link = deque->sentinel->next; link != deque->sentinel; link = link->next)
+	{
+		snapshotPutValue(&stream, link->value, &prev);
+	}
+	return snapshotPutTrailer(&stream);
+}
+
+/**
+	Makes a deque from a snapshot written by circularListWriteSnapshot.
+	The links come from an arena the deque owns, sized from the
+	snapshot's count (a first chunk of at most 65536 links).
+	param:	in		FILE ptr open for reading
+	pre:	in is not null
+	post:	the snapshot is consumed from in
+	ret:	deque with the snapshot's values, or null if the snapshot is
+			cut off, corrupt or for another TYPE
+ */
+struct CircularList* circularListReadSnapshot(FILE* in)
+{
+	assert(in !=0);
+	struct SnapshotStream stream = { in, 0, 0 };
+	size_t count = snapshotGetHeader(&stream, SNAPSHOT_KIND, sizeof(TYPE));
+	if(stream.failed)
+	{
+		return 0;
+	}
+	size_t chunkLinks = count == 0 ? 1 : count < 65536 ? count : 65536;
+	struct CircularList* deque = circularListCreateInArena(circularListArenaCreate(chunkLinks));
+	deque->ownsArena = 1;
+	TYPE prev = 0;
+	for(size_t i = 0; i < count && !stream.failed; i++)
+	{
+		TYPE value = snapshotGetValue(&stream, &prev);
+		addLinkAfter(deque, deque->sentinel->prev, value);
+	}
+	if(snapshotGetTrailer(&stream) !=0)
+	{
+		circularListDestroy(deque);
+		return 0;
+	}
+	return deque;
+}
+
+/**
+	Turns op tracing on or off. With it on, every thread that works on a
+	deque records each op (its code, a hash of its value, the deque's
+	size and a time stamp) in a ring of its own holding its most recent
+	events, to be written out with circularListTraceDump. A thread gets its
+	ring the first time it traces, sized by the latest call to this;
+	turning tracing off keeps the rings, so they can still be dumped.
+	param:	events	events each thread keeps (rounded up to a power of
+					two), 0 to turn tracing off
+	pre:	none
+	post:	ops are traced if events > 0
+ */
+void circularListTraceEnable(size_t events)
+{
+	traceEnable(&trace, events);
+}
+
+/**
+	Writes the trace rings of every thread that has traced deque
+	ops. Threads may keep tracing while this runs: each ring is copied
+	and any events that were overwritten during the copy are left out,
+	along with another thread's oldest event if its ring is full (it
+	may be the one being overwritten).
+	The event clock is timed for 10ms to record its rate.
+	param:	out		FILE ptr open for writing
+	pre:	out is not null
+	post:	a dump of every ring is written to out
+	ret:	0 on success, -1 if writing failed
+ */
+int circularListTraceDump(FILE* out)
+{
+	assert(out != 0);
+	return traceDump(&trace, traceRing, 'C', out);
+}
+
+/**
+	Reports the memory held by one deque: the bytes holding its values,
+	the link pointers, sentinel and deque struct around them, and the
+	slack the allocator added to each block (from malloc_usable_size).
+	Walks every link, so this is O(n). For an arena deque the arena's
+	chunks are counted instead, with unused chunk space as overhead, and
+	for a ring deque its ring, with unused ring space as overhead.
+	param:	deque	struct CircularList ptr
+	param:	usage	struct CircularListMemory ptr
+	pre:	deque and usage are not null
+	post:	usage is filled in for deque
+ */
+void circularListMemoryUsage(struct CircularList* deque, struct CircularListMemory* usage)
+{
+	assert(deque != 0 && usage != 0);
+	size_t requested = sizeof(struct CircularList) + sizeof(struct Link);
+	size_t usable = malloc_usable_size(deque)
+		+ malloc_usable_size(deque->sentinel);
+	if(deque->reduceCache !=0)
+	{
+		struct ReduceCache* cache = deque->reduceCache;
+		requested += sizeof(struct ReduceCache)
+			+ cache->slots * (sizeof(unsigned long long) + cache->reducer.partialSize);
+		usable += malloc_usable_size(cache);
+		if(cache->slots > 0)
+		{
+			usable += malloc_usable_size(cache->segments) + malloc_usable_size(cache->partials);
+		}
+	}
+	if(deque->readers !=0)
+	{
+		requested += sizeof(struct ReadEpochs);
+		usable += malloc_usable_size(deque->readers);
+	}
+	if(deque->minMax !=0)
+	{
+		requested += sizeof(struct MinMaxTracker)
+			+ (deque->minMax->minima.capacity + deque->minMax->maxima.capacity) * sizeof(TYPE);
+		usable += malloc_usable_size(deque->minMax)
+			+ malloc_usable_size(deque->minMax->minima.values)
+			+ malloc_usable_size(deque->minMax->maxima.values);
+	}
+	if (deque->ring != 0)
+	{
+		requested += deque->ringCapacity * sizeof(TYPE);
+		usable += malloc_usable_size(deque->ring);
+		fillMemory(usage, deque->size, deque->size * sizeof(TYPE), requested, usable);
+		return;
+	}
+	if (deque->arena != 0)
+	{
+		// links live in the arena's chunks, so count those instead
+		arenaMemory(&deque->arena->links, &requested, &usable);
+		fillMemory(usage, deque->size, deque->size * sizeof(TYPE), requested, usable);
+		return;
+	}
+	struct Link* current = deque->sentinel->next;
+	while (current != deque->sentinel)
+	{
+		requested += sizeof(struct Link);
+		usable += malloc_usable_size(current);
+		current = current->next;
+	}
+	fillMemory(usage, deque->size, deque->size * sizeof(TYPE), requested, usable);
+}
+
+/**
+	Reports the memory held by every list, deque and queue in the process
+	(the linked list, circular list and stack from queues modules share
+	one tally, kept with atomic counters as links and structs are
+	allocated and freed on any thread). O(1).
+	param:	usage	struct CircularListMemory ptr
+	pre:	usage is not null
+	post:	usage is filled in for all of them combined
+ */
+void circularListMemoryTotal(struct CircularListMemory* usage)
+{
+	struct MemoryTally totals;
+	tallyRead(&totals);
+	fillMemory(usage, totals.elements, totals.payloadBytes, totals.requestedBytes,
+		totals.usableBytes);
 }
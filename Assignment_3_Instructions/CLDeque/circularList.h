@@ -13,21 +13,140 @@
 #define EQ(A, B) ((A) == (B))
 #endif
 
+#include <stddef.h>
+#include <stdio.h>
+
 struct CircularList;
+struct CircularListArena;
+
+// Memory usage report (see circularListMemoryUsage)
+struct CircularListMemory
+{
+	size_t elements;
+	size_t payloadBytes;	// bytes holding values
+	size_t overheadBytes;	// link pointers, sentinel and the deque struct
+	size_t slackBytes;		// allocator rounding beyond what was requested
+	size_t totalBytes;		// payload + overhead + slack
+	double bytesPerElement;
+};
+
+// Parallel reduction (see circularListReduce). Each worker gets its own
+// partial result of partialSize bytes, set up by init, fed blocks of
+// values by accumulate, and folded into the final result by combine.
+struct CircularListReducer
+{
+	size_t partialSize;
+	void (*init)(void* partial, void* context);
+	void (*accumulate)(void* partial, const TYPE* values, size_t count, void* context);
+	void (*combine)(void* result, const void* partial, void* context);
+	void* context;
+};
+
+// Values of a ring deque as up to two contiguous arrays, front to back
+// (see circularListSpans)
+struct CircularListSpans
+{
+	const TYPE* first;
+	size_t firstCount;
+	const TYPE* second;		// where the ring wraps around to its start
+	size_t secondCount;
+};
+
+// Summary statistics (see circularListStats)
+struct CircularListStats
+{
+	size_t count;
+	double sum;
+	double mean;
+	double variance;		// population variance
+	double min;
+	double max;
+};
+
+// Kernels circularListStats runs on (see circularListUseKernels)
+enum CircularListKernels
+{
+	CIRCULAR_LIST_KERNELS_BEST, CIRCULAR_LIST_KERNELS_SCALAR, CIRCULAR_LIST_KERNELS_SSE2,
+	CIRCULAR_LIST_KERNELS_AVX2
+};
 
 struct CircularList* circularListCreate();
 void circularListDestroy(struct CircularList* list);
 void circularListPrint(struct CircularList* list);
 void circularListReverse(struct CircularList* list);
+void circularListClear(struct CircularList* list);
+struct CircularList* circularListClone(struct CircularList* list);
+void circularListTrim(struct CircularList* list);
+void circularListAutoTrim(struct CircularList* list, size_t minPeak);
+
+// Array import/export
+
+size_t circularListToArray(struct CircularList* list, TYPE* values);
+struct CircularList* circularListFromArray(const TYPE* values, size_t count);
+
+// Arena interface
+
+struct CircularListArena* circularListArenaCreate(size_t chunkLinks);
+void circularListArenaDestroy(struct CircularListArena* arena);
+struct CircularList* circularListCreateInArena(struct CircularListArena* arena);
+
+// Ring buffer storage
+
+struct CircularList* circularListCreateRing(size_t capacity);
+struct CircularList* circularListCreateFixed(size_t capacity);
+int circularListSpans(struct CircularList* deque, struct CircularListSpans* spans);
 
 // Deque interface
 
-void circularListAddFront(struct CircularList* list, TYPE value);
-void circularListAddBack(struct CircularList* list, TYPE value);
+#ifdef CIRCULAR_LIST_INLINE
+#include "circularListInline.h"
+#else
+int circularListIsEmpty(struct CircularList* list);
 TYPE circularListFront(struct CircularList* list);
 TYPE circularListBack(struct CircularList* list);
+#endif
+void circularListAddFront(struct CircularList* list, TYPE value);
+void circularListAddBack(struct CircularList* list, TYPE value);
 void circularListRemoveFront(struct CircularList* list);
 void circularListRemoveBack(struct CircularList* list);
-int circularListIsEmpty(struct CircularList* list);
+
+// Sliding window min/max
+
+void circularListTrackMinMax(struct CircularList* list);
+TYPE circularListMin(struct CircularList* list);
+TYPE circularListMax(struct CircularList* list);
+
+// Sorting
+
+void circularListSort(struct CircularList* list);
+void circularListSortParallel(struct CircularList* list, int threads);
+
+// Concurrent readers
+
+void circularListEnableConcurrentReads(struct CircularList* list);
+size_t circularListScan(struct CircularList* list, void (*visit)(TYPE value, void* context),
+	void* context);
+
+// Parallel reduction
+
+void circularListReduce(struct CircularList* list, const struct CircularListReducer* reducer,
+	int threads, void* result);
+void circularListStats(struct CircularList* deque, int threads, struct CircularListStats* stats);
+int circularListUseKernels(enum CircularListKernels kernels);
+
+// Snapshots
+
+int circularListWriteSnapshot(struct CircularList* list, FILE* out);
+struct CircularList* circularListReadSnapshot(FILE* in);
+
+// Op tracing
+
+void circularListTraceEnable(size_t events);
+int circularListTraceDump(FILE* out);
+
+// Memory usage
+
+void circularListMemoryUsage(struct CircularList* list, struct CircularListMemory* usage);
+void circularListMemoryTotal(struct CircularListMemory* usage);
 
 #endif
\ No newline at end of file
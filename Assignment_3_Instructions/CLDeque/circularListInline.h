@@ -0,0 +1,80 @@
+#ifndef CIRCULAR_LIST_INLINE_H
+#define CIRCULAR_LIST_INLINE_H
+
+/*
+	Layout of the deque, shared by circularList.c and (when built with
+	-DCIRCULAR_LIST_INLINE) by callers, who then get the hot read-only
+	deque ops below as static inline functions instead of calls into
+	circularList.c. Building with -DCIRCULAR_LIST_UNCHECKED as well drops
+	their precondition asserts. Include circularList.h, not this file.
+*/
+
+#include <assert.h>
+#include <stddef.h>
+
+#ifdef CIRCULAR_LIST_UNCHECKED
+#define CIRCULAR_LIST_CHECK(COND) ((void)0)
+#else
+#define CIRCULAR_LIST_CHECK(COND) assert(COND)
+#endif
+
+// Double link
+struct Link
+{
+	TYPE value;
+	struct Link * next;
+	struct Link * prev;
+};
+
+struct CircularList
+{
+	size_t size;
+	struct Link* sentinel;
+	struct CircularListArena* arena;	// null when links come from malloc
+	int ownsArena;						// arena is freed with the deque
+	unsigned long version;				// bumped when values are reordered or cleared
+	struct ReduceCache* reduceCache;	// null until the deque is first reduced
+	struct MinMaxTracker* minMax;		// null unless min/max are tracked
+	struct ReadEpochs* readers;			// null unless concurrent reads are on
+	size_t peak;						// largest size since the last trim
+	size_t trimPeak;					// auto trim once peak reaches this, 0 for never
+	TYPE* ring;							// null unless values are kept in a ring buffer
+	size_t ringCapacity;
+	size_t ringFront;					// index of the front value in ring
+	int ringFixed;						// a full ring overwrites instead of growing
+};
+
+#ifdef CIRCULAR_LIST_INLINE
+
+static inline int circularListIsEmpty(struct CircularList* deque)
+{
+	CIRCULAR_LIST_CHECK(deque != 0);
+	return deque->size == 0;
+}
+
+static inline TYPE circularListFront(struct CircularList* deque)
+{
+	CIRCULAR_LIST_CHECK(deque != 0);
+	CIRCULAR_LIST_CHECK(deque->size != 0);
+	if (deque->ring != 0)
+	{
+		return deque->ring[deque->ringFront];
+	}
+	return deque->sentinel->next->value;
+}
+
+static inline TYPE circularListBack(struct CircularList* deque)
+{
+	CIRCULAR_LIST_CHECK(deque != 0);
+	CIRCULAR_LIST_CHECK(deque->size != 0);
+	if (deque->ring != 0)
+	{
+		size_t index = deque->ringFront + deque->size - 1;
+		return deque->ring[index >= deque->ringCapacity ? index - deque->ringCapacity : index];
+	}
+	return deque->sentinel->prev->value;
+}
+
+#endif
+
+#endif
@@ -1,5 +1,216 @@
+#define _POSIX_C_SOURCE 200809L
 #include "circularList.h"
+#include "circularListInline.h"
+#include "dequeCommon.h"
+#include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void assertTrue(int pred, char* msg)
+{
+	printf("%s: ", msg);
+	if(pred)
+		printf("\tPASSED\n");
+	else
+		printf("\tFAILED\n");
+}
+
+// Reduces values to a hash that depends on their order, counting how
+// many values it was handed in *context
+struct OrderHash
+{
+	unsigned long long hash;
+	unsigned long long scale;	// 31 to the number of values hashed
+};
+
+void orderInit(void* partial, void* context)
+{
+	(void)context;
+	((struct OrderHash*)partial)->hash = 0;
+	((struct OrderHash*)partial)->scale = 1;
+}
+
+void orderAccumulate(void* partial, const TYPE* values, size_t count, void* context)
+{
+	struct OrderHash* into = partial;
+	for(size_t i = 0; i < count; i++)
+	{
+		into->hash = into->hash * 31 + (unsigned long long)values[i];
+		into->scale *= 31;
+	}
+	__atomic_fetch_add((size_t*)context, count, __ATOMIC_RELAXED);
+}
+
+void orderCombine(void* result, const void* partial, void* context)
+{
+	struct OrderHash* into = result;
+	const struct OrderHash* from = partial;
+	(void)context;
+	into->hash = into->hash * from->scale + from->hash;
+	into->scale *= from->scale;
+}
+
+unsigned long long orderOf(struct CircularList* deque, TYPE* values)
+{
+	size_t count = circularListToArray(deque, values);
+	struct OrderHash expected;
+	size_t seen = 0;
+	orderInit(&expected, 0);
+	orderAccumulate(&expected, values, count, &seen);
+	return expected.hash;
+}
+
+int minMaxRight(struct CircularList* deque, TYPE* values)
+{
+	size_t count = circularListToArray(deque, values);
+	TYPE min = values[0];
+	TYPE max = values[0];
+	for(size_t i = 1; i < count; i++)
+	{
+		min = values[i] < min ? values[i] : min;
+		max = values[i] > max ? values[i] : max;
+	}
+	return circularListMin(deque) == min && circularListMax(deque) == max;
+}
+
+// Returns 1 if the deque holds exactly the count values, front to back
+int dequeEquals(struct CircularList* deque, const TYPE* values, size_t count)
+{
+	TYPE found[64];
+	if(deque->size != count || count > 64)
+	{
+		return 0;
+	}
+	circularListToArray(deque, found);
+	for(size_t i = 0; i < count; i++)
+	{
+		if(found[i] != values[i])
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+// Returns 1 if x is within a relative tolerance of the reference (an
+// absolute one for a reference near 0)
+int near(double x, double reference, double tolerance)
+{
+	double scale = reference < 0 ? -reference : reference;
+	double error = x < reference ? reference - x : x - reference;
+	return error <= tolerance * (scale > 1 ? scale : 1);
+}
+
+// Returns 1 if the stats match a naive two-pass count, sum, mean,
+// population variance, min and max of the values
+int statsMatch(const struct CircularListStats* stats, const TYPE* values, size_t count)
+{
+	long double sum = 0;
+	double min = values[0];
+	double max = values[0];
+	for(size_t i = 0; i < count; i++)
+	{
+		sum += values[i];
+		min = values[i] < min ? values[i] : min;
+		max = values[i] > max ? values[i] : max;
+	}
+	long double mean = sum / count;
+	long double squares = 0;
+	for(size_t i = 0; i < count; i++)
+	{
+		squares += (values[i] - mean) * (values[i] - mean);
+	}
+	return stats->count == count && near(stats->sum, (double)sum, 1e-12)
+		&& near(stats->mean, (double)mean, 1e-12) && near(stats->variance, (double)(squares / count), 1e-9)
+		&& stats->min == min && stats->max == max;
+}
+
+// Returns 1 if two sets of stats of the same values agree up to rounding
+int statsClose(const struct CircularListStats* a, const struct CircularListStats* b)
+{
+	return a->count == b->count && near(a->sum, b->sum, 1e-12) && near(a->mean, b->mean, 1e-12)
+		&& near(a->variance, b->variance, 1e-9) && a->min == b->min && a->max == b->max;
+}
+
+// Writes the deque as a snapshot into bytes and returns its length, or
+// 0 if it didn't fit
+size_t snapshotBytes(struct CircularList* deque, unsigned char* bytes, size_t capacity)
+{
+	FILE* file = tmpfile();
+	size_t length = 0;
+	if(circularListWriteSnapshot(deque, file) == 0)
+	{
+		rewind(file);
+		length = fread(bytes, 1, capacity, file);
+		length = fgetc(file) == EOF ? length : 0;
+	}
+	fclose(file);
+	return length;
+}
+
+// Reads a deque back from the first length bytes of a snapshot, or
+// returns null if the read rejects them
+struct CircularList* snapshotFromBytes(unsigned char* bytes, size_t length)
+{
+	FILE* file = fmemopen(bytes, length, "r");
+	struct CircularList* deque = circularListReadSnapshot(file);
+	fclose(file);
+	return deque;
+}
+
+// Reads a little-endian field of the given number of bytes from a
+// trace dump
+uint64_t dumpField(FILE* dump, int bytes)
+{
+	uint64_t value = 0;
+	for(int i = 0; i < bytes; i++)
+	{
+		value |= (uint64_t)(fgetc(dump) & 0xff) << (8 * i);
+	}
+	return value;
+}
+
+// Reads a trace dump of the circular list module holding one thread
+// ring into events (at most max of them) and returns how many it holds,
+// or -1 if it is not such a dump
+long readTrace(FILE* dump, struct TraceEvent* events, size_t max)
+{
+	char magic[5];
+	rewind(dump);
+	if(fread(magic, 1, 5, dump) != 5 || memcmp(magic, "DQT1C", 5) != 0)
+	{
+		return -1;
+	}
+	dumpField(dump, 8);
+	if(dumpField(dump, 4) != 1)
+	{
+		return -1;
+	}
+	dumpField(dump, 4);
+	uint64_t count = dumpField(dump, 8);
+	if(count > max)
+	{
+		return -1;
+	}
+	for(uint64_t i = 0; i < count; i++)
+	{
+		events[i].ticks = dumpField(dump, 8);
+		events[i].size = dumpField(dump, 8);
+		events[i].hash = (uint32_t)dumpField(dump, 4);
+		events[i].op = (uint16_t)dumpField(dump, 2);
+		events[i].object = (uint16_t)dumpField(dump, 2);
+	}
+	return fgetc(dump) == EOF ? (long)count : -1;
+}
+
+// Returns the hash a trace event records for a value
+uint32_t traceHashOf(TYPE value)
+{
+	uint64_t bits = 0;
+	memcpy(&bits, &value, sizeof(TYPE));
+	return (uint32_t)(mixHash(bits) >> 32);
+}
 
 int main()
 {	
@@ -22,6 +233,501 @@ int main()
 	circularListPrint(deque);
 	
 	circularListDestroy(deque);
+
+	TYPE in[3] = { 0.5, 1.5, 2.5 };
+	TYPE out[3];
+	deque = circularListFromArray(in, 3);
+	circularListToArray(deque, out);
+	printf("%g %g\n", out[0], out[2]);
+	circularListDestroy(deque);
+
+	deque = circularListCreateRing(2);
+	circularListAddBack(deque, (TYPE)2);
+	circularListAddBack(deque, (TYPE)4);
+	circularListAddFront(deque, (TYPE)0);
+	struct CircularListStats stats;
+	circularListStats(deque, 1, &stats);
+	assertTrue(stats.count == 3 && stats.sum == 6 && stats.mean == 2 && near(stats.variance, 8.0 / 3, 1e-15)
+		&& stats.min == 0 && stats.max == 4, "stats of 0, 2, 4");
+	circularListClear(deque);
+	circularListStats(deque, 1, &stats);
+	assertTrue(stats.count == 0 && stats.sum == 0 && stats.mean == 0 && stats.variance == 0,
+		"stats of an empty deque");
+	circularListDestroy(deque);
+
+	// every kernel set the CPU runs, on ring and linked deques of sizes
+	// that leave each vector width a remainder and span several blocks,
+	// with values far from zero on both sides
+	const enum CircularListKernels kernelSets[] = {
+		CIRCULAR_LIST_KERNELS_SCALAR, CIRCULAR_LIST_KERNELS_SSE2, CIRCULAR_LIST_KERNELS_AVX2
+	};
+	const char* kernelNames[] = { "scalar", "sse2", "avx2" };
+	const size_t statsSizes[] = { 1, 3, 7, 8, 13, 1000, 5000 };
+	TYPE* statsValues = malloc(5000 * sizeof(TYPE));
+	int kernelsRun[3] = { 0 };
+	int statsOk = 1;
+	int kernelsAgree = 1;
+	srand(5);
+	for(int s = 0; s < 7; s++)
+	{
+		size_t count = statsSizes[s];
+		double base = s % 2 == 0 ? 1e6 : -1e6;
+		for(size_t i = 0; i < count; i++)
+		{
+			statsValues[i] = (TYPE)(base + (rand() % 20001 - 10000) / 7.0);
+		}
+		struct CircularList* ring = circularListCreateRing(count);
+		circularListAddBack(ring, (TYPE)0);
+		circularListRemoveFront(ring);
+		for(size_t i = 0; i < count; i++)
+		{
+			circularListAddBack(ring, statsValues[i]);
+		}
+		struct CircularList* linked = circularListFromArray(statsValues, count);
+		struct CircularListStats reference;
+		circularListUseKernels(CIRCULAR_LIST_KERNELS_SCALAR);
+		circularListStats(linked, 1, &reference);
+		for(int k = 0; k < 3; k++)
+		{
+			if(circularListUseKernels(kernelSets[k]) != 0)
+			{
+				continue;
+			}
+			kernelsRun[k] = 1;
+			for(int threads = 1; threads <= 4; threads += 3)
+			{
+				circularListStats(ring, threads, &stats);
+				statsOk = statsOk && statsMatch(&stats, statsValues, count);
+				kernelsAgree = kernelsAgree && statsClose(&stats, &reference);
+				circularListStats(linked, threads, &stats);
+				statsOk = statsOk && statsMatch(&stats, statsValues, count);
+				kernelsAgree = kernelsAgree && statsClose(&stats, &reference);
+			}
+		}
+		circularListDestroy(linked);
+		circularListDestroy(ring);
+	}
+	assertTrue(circularListUseKernels(CIRCULAR_LIST_KERNELS_BEST) == 0, "back to the widest kernels");
+	free(statsValues);
+	printf("stats kernels run:");
+	for(int k = 0; k < 3; k++)
+	{
+		printf(kernelsRun[k] ? " %s" : "", kernelNames[k]);
+	}
+	printf("\n");
+	assertTrue(kernelsRun[0], "scalar kernels always run");
+	assertTrue(statsOk, "every kernel matches a naive mean and variance");
+	assertTrue(kernelsAgree, "kernels agree with each other");
+
+	deque = circularListCreateFixed(3);
+	for(int i = 1; i <= 5; i++)
+	{
+		circularListAddBack(deque, (TYPE)i);
+	}
+	assertTrue(dequeEquals(deque, (TYPE[]){ 3, 4, 5 }, 3), "full fixed ring overwrites its front");
+
+	struct CircularList* clone = circularListClone(deque);
+	circularListAddBack(clone, (TYPE)6);
+	assertTrue(circularListFront(clone) == 4 && circularListBack(clone) == 6,
+		"fixed clone drops its front when full");
+	assertTrue(circularListFront(deque) == 3 && circularListBack(deque) == 5,
+		"original unchanged by clone");
+	circularListDestroy(clone);
+	circularListAddFront(deque, (TYPE)2);
+	assertTrue(dequeEquals(deque, (TYPE[]){ 2, 3, 4 }, 3), "adding to the front overwrites the back");
+	circularListRemoveFront(deque);
+	circularListAddBack(deque, (TYPE)7);
+	circularListAddBack(deque, (TYPE)8);
+	assertTrue(dequeEquals(deque, (TYPE[]){ 4, 7, 8 }, 3), "fixed ring wraps after a remove");
+	circularListDestroy(deque);
+
+	deque = circularListCreate();
+	for(int i = 0; i < 5; i++)
+	{
+		circularListAddFront(deque, (TYPE)i);
+	}
+	clone = circularListClone(deque);
+	circularListRemoveBack(deque);
+	TYPE copied[5];
+	assertTrue(circularListToArray(clone, copied) == 5 && copied[0] == 4 && copied[4] == 0,
+		"clone keeps order");
+	circularListReverse(clone);
+	assertTrue(circularListFront(clone) == 0 && circularListBack(deque) == 1,
+		"clone and original are independent");
+	circularListDestroy(clone);
+	circularListClear(deque);
+	clone = circularListClone(deque);
+	assertTrue(circularListIsEmpty(clone), "clone of empty is empty");
+	circularListDestroy(clone);
+	circularListDestroy(deque);
+
+	deque = circularListCreateRing(4);
+	for(int i = 0; i < 6; i++)
+	{
+		circularListAddBack(deque, (TYPE)i);
+	}
+	circularListRemoveFront(deque);
+	circularListAddBack(deque, (TYPE)6);
+	clone = circularListClone(deque);
+	circularListRemoveFront(deque);
+	assertTrue(circularListFront(clone) == 1 && circularListBack(clone) == 6,
+		"ring clone keeps order");
+	circularListAddFront(clone, (TYPE)0);
+	assertTrue(circularListFront(clone) == 0 && circularListFront(deque) == 2,
+		"ring clone and original are independent");
+	circularListDestroy(clone);
+	circularListDestroy(deque);
+
+	// -0 and 0 are equal by LT, so their signs show whether sorting kept
+	// equal values in order
+	deque = circularListCreate();
+	TYPE zeroSigns[2000];
+	int zeros = 0;
+	srand(1);
+	for(int i = 0; i < 2000; i++)
+	{
+		TYPE value = (TYPE)(rand() % 5 - 2);
+		if(value == 0 && rand() % 2)
+		{
+			value = -value;
+		}
+		if(value == 0)
+		{
+			zeroSigns[zeros++] = 1 / value;
+		}
+		circularListAddBack(deque, value);
+	}
+	clone = circularListClone(deque);
+	circularListSort(deque);
+	circularListSortParallel(clone, 4);
+	TYPE sorted[2000];
+	TYPE merged[2000];
+	circularListToArray(deque, sorted);
+	circularListToArray(clone, merged);
+	int inOrder = 1;
+	int stable = 1;
+	int zero = 0;
+	for(int i = 0; i < 2000; i++)
+	{
+		inOrder = inOrder && (i == 0 || sorted[i - 1] <= sorted[i]);
+		if(sorted[i] == 0)
+		{
+			stable = stable && 1 / sorted[i] == zeroSigns[zero] && 1 / merged[i] == zeroSigns[zero];
+			zero++;
+		}
+	}
+	assertTrue(inOrder && zero == zeros, "sort in order, keeps every value");
+	assertTrue(stable, "sort and parallel sort are stable");
+	circularListDestroy(clone);
+	circularListDestroy(deque);
+
+	deque = circularListCreateRing(2);
+	circularListAddBack(deque, (TYPE)2);
+	circularListAddFront(deque, (TYPE)3);
+	circularListAddBack(deque, (TYPE)1);
+	circularListSortParallel(deque, 2);
+	assertTrue(circularListFront(deque) == 1 && circularListBack(deque) == 3, "ring deque sorts");
+	circularListDestroy(deque);
+
+	size_t accumulated = 0;
+	struct CircularListReducer order = {
+		sizeof(struct OrderHash), orderInit, orderAccumulate, orderCombine, &accumulated
+	};
+	struct OrderHash reduced;
+	TYPE* window = malloc(20000 * sizeof(TYPE));
+	assert(window);
+	deque = circularListCreate();
+	orderInit(&reduced, 0);
+	circularListReduce(deque, &order, 4, &reduced);
+	assertTrue(reduced.hash == 0 && accumulated == 0, "empty deque leaves result as is");
+	for(int i = 0; i < 20000; i++)
+	{
+		circularListAddBack(deque, (TYPE)(rand() % 1000));
+	}
+	int threads[] = {1, 4, 64};
+	int reducedOk = 1;
+	for(int i = 0; i < 3; i++)
+	{
+		orderInit(&reduced, 0);
+		circularListReduce(deque, &order, threads[i], &reduced);
+		reducedOk = reducedOk && reduced.hash == orderOf(deque, window);
+	}
+	assertTrue(reducedOk, "reduce combines front to back on 1, 4, 64 threads");
+	int slidOk = 1;
+	size_t mostAccumulated = 0;
+	for(int slide = 0; slide < 20; slide++)
+	{
+		for(int i = 0; i < 50; i++)
+		{
+			circularListRemoveFront(deque);
+			circularListAddBack(deque, (TYPE)(rand() % 1000));
+		}
+		circularListAddFront(deque, (TYPE)slide);
+		circularListRemoveBack(deque);
+		accumulated = 0;
+		orderInit(&reduced, 0);
+		circularListReduce(deque, &order, 4, &reduced);
+		slidOk = slidOk && reduced.hash == orderOf(deque, window);
+		mostAccumulated = accumulated > mostAccumulated ? accumulated : mostAccumulated;
+	}
+	assertTrue(slidOk, "reduce of a sliding window");
+	assertTrue(mostAccumulated < 20000 / 4, "sliding window reuses cached segments");
+	circularListReverse(deque);
+	accumulated = 0;
+	orderInit(&reduced, 0);
+	circularListReduce(deque, &order, 4, &reduced);
+	assertTrue(reduced.hash == orderOf(deque, window) && accumulated == 20000,
+		"reverse drops the cache");
+	struct CircularListStats parallelStats;
+	circularListStats(deque, 1, &stats);
+	circularListStats(deque, 8, &parallelStats);
+	assertTrue(stats.count == 20000 && parallelStats.count == 20000
+		&& stats.min == parallelStats.min && stats.max == parallelStats.max
+		&& stats.mean - parallelStats.mean < 1e-9 && parallelStats.mean - stats.mean < 1e-9,
+		"stats agree on 1 and 8 threads");
+	circularListDestroy(deque);
+
+	deque = circularListCreateRing(16);
+	for(int i = 0; i < 5000; i++)
+	{
+		circularListAddFront(deque, (TYPE)(rand() % 1000));
+		if(i % 3 == 0)
+		{
+			circularListRemoveBack(deque);
+		}
+	}
+	orderInit(&reduced, 0);
+	circularListReduce(deque, &order, 4, &reduced);
+	assertTrue(reduced.hash == orderOf(deque, window), "reduce of a wrapped ring deque");
+	circularListDestroy(deque);
+
+	for(int kind = 0; kind < 2; kind++)
+	{
+		deque = kind == 0 ? circularListCreate() : circularListCreateRing(4);
+		for(int i = 0; i < 10; i++)
+		{
+			circularListAddBack(deque, (TYPE)(rand() % 100));
+		}
+		circularListTrackMinMax(deque);
+		int windowOk = minMaxRight(deque, window);
+		for(int i = 0; i < 500; i++)
+		{
+			circularListAddBack(deque, (TYPE)(rand() % 100));
+			circularListRemoveFront(deque);
+			windowOk = windowOk && minMaxRight(deque, window);
+		}
+		assertTrue(windowOk, kind == 0 ? "sliding window min/max" : "ring sliding window min/max");
+		int staleOk = 1;
+		for(int i = 0; i < 500; i++)
+		{
+			switch(rand() % 8)
+			{
+			case 0:
+				circularListAddFront(deque, (TYPE)(rand() % 100));
+				break;
+			case 1:
+				circularListAddBack(deque, (TYPE)(rand() % 100));
+				circularListRemoveBack(deque);
+				break;
+			case 2:
+				circularListReverse(deque);
+				break;
+			case 3:
+				circularListSort(deque);
+				break;
+			default:
+				circularListAddBack(deque, (TYPE)(rand() % 100));
+				circularListRemoveFront(deque);
+			}
+			staleOk = staleOk && minMaxRight(deque, window);
+		}
+		assertTrue(staleOk, "min/max after add front, remove back, reverse, sort");
+		circularListClear(deque);
+		circularListAddBack(deque, (TYPE)-1);
+		circularListAddFront(deque, (TYPE)7);
+		assertTrue(circularListMin(deque) == -1 && circularListMax(deque) == 7,
+			"min/max after clear");
+		circularListDestroy(deque);
+	}
+
+	deque = circularListCreateRing(8);
+	for(int i = 0; i < 1000; i++)
+	{
+		circularListAddBack(deque, (TYPE)i);
+	}
+	struct CircularListMemory burst;
+	struct CircularListMemory trimmed;
+	circularListMemoryUsage(deque, &burst);
+	for(int i = 0; i < 990; i++)
+	{
+		circularListRemoveFront(deque);
+	}
+	circularListTrim(deque);
+	circularListMemoryUsage(deque, &trimmed);
+	assertTrue(circularListToArray(deque, window) == 10 && window[0] == 990 && window[9] == 999,
+		"trim keeps the values in order");
+	assertTrue(trimmed.totalBytes < burst.totalBytes / 10, "trim shrinks the ring");
+	circularListAutoTrim(deque, 100);
+	for(int i = 0; i < 990; i++)
+	{
+		circularListAddFront(deque, (TYPE)(989 - i));
+	}
+	circularListMemoryUsage(deque, &burst);
+	for(int i = 0; i < 800; i++)
+	{
+		circularListRemoveBack(deque);
+	}
+	circularListMemoryUsage(deque, &trimmed);
+	assertTrue(trimmed.totalBytes < burst.totalBytes / 2, "auto trim shrinks the ring");
+	assertTrue(circularListToArray(deque, window) == 200 && window[0] == 0 && window[199] == 199,
+		"auto trim keeps the values in order");
+	circularListDestroy(deque);
+
+	deque = circularListCreateFixed(8);
+	for(int i = 0; i < 8; i++)
+	{
+		circularListAddBack(deque, (TYPE)i);
+	}
+	circularListRemoveFront(deque);
+	circularListTrim(deque);
+	for(int i = 8; i < 12; i++)
+	{
+		circularListAddBack(deque, (TYPE)i);
+	}
+	assertTrue(circularListFront(deque) == 4 && circularListBack(deque) == 11,
+		"fixed ring keeps its capacity through a trim");
+	circularListDestroy(deque);
+
+	struct CircularListArena* trimArena = circularListArenaCreate(8);
+	deque = circularListCreateInArena(trimArena);
+	for(int i = 0; i < 1000; i++)
+	{
+		circularListAddBack(deque, (TYPE)i);
+	}
+	circularListMemoryUsage(deque, &burst);
+	for(int i = 0; i < 990; i++)
+	{
+		circularListRemoveFront(deque);
+	}
+	circularListTrim(deque);
+	for(int i = 0; i < 990; i++)
+	{
+		circularListAddBack(deque, (TYPE)(1000 + i));
+	}
+	circularListMemoryUsage(deque, &trimmed);
+	assertTrue(trimmed.totalBytes == burst.totalBytes, "next burst reuses the arena's chunks");
+	assertTrue(circularListToArray(deque, window) == 1000 && window[0] == 990 && window[999] == 1989,
+		"arena values in order after trim");
+	circularListDestroy(deque);
+	circularListArenaDestroy(trimArena);
+
+	deque = circularListCreate();
+	struct CircularList* scatter = circularListCreate();
+	for(int i = 0; i < 200; i++)
+	{
+		circularListAddBack(deque, (TYPE)i);
+		circularListAddBack(scatter, (TYPE)i);
+	}
+	for(int i = 0; i < 150; i++)
+	{
+		circularListRemoveFront(deque);
+	}
+	circularListTrim(deque);
+	int contiguous = 1;
+	for(struct Link* link = deque->sentinel->next; link->next != deque->sentinel; link = link->next)
+	{
+		contiguous = contiguous && link->next == link + 1;
+	}
+	assertTrue(contiguous, "trim packs a malloc deque's links into one block");
+	assertTrue(circularListToArray(deque, window) == 50 && window[0] == 150 && window[49] == 199,
+		"trim of a malloc deque keeps the values in order");
+	circularListAddFront(deque, (TYPE)149);
+	circularListRemoveBack(deque);
+	assertTrue(circularListToArray(deque, window) == 50 && window[0] == 149 && window[49] == 198,
+		"trimmed malloc deque takes links from its new arena");
+	circularListDestroy(scatter);
+	circularListDestroy(deque);
+
+	const TYPE signedValues[] = { -1.5, 2.25, -1e300, 1e-300, 0, -7 };
+	deque = circularListFromArray(signedValues, 6);
+	unsigned char bytes[1024];
+	size_t length = snapshotBytes(deque, bytes, sizeof(bytes));
+	struct CircularList* loaded = snapshotFromBytes(bytes, length);
+	assertTrue(loaded != 0 && dequeEquals(loaded, signedValues, 6), "snapshot round trip of negative values");
+	circularListDestroy(loaded);
+	bytes[length - 1] ^= 1;
+	assertTrue(snapshotFromBytes(bytes, length) == 0, "bad checksum rejected");
+	bytes[length - 1] ^= 1;
+	bytes[12] ^= 4;
+	assertTrue(snapshotFromBytes(bytes, length) == 0, "changed value rejected");
+	bytes[12] ^= 4;
+	bytes[4] = 'i';
+	assertTrue(snapshotFromBytes(bytes, length) == 0, "snapshot of another TYPE rejected");
+	bytes[4] = 'f';
+	assertTrue(snapshotFromBytes(bytes, length - 2) == 0, "cut off snapshot rejected");
+	loaded = snapshotFromBytes(bytes, length);
+	assertTrue(loaded != 0 && dequeEquals(loaded, signedValues, 6), "restored snapshot read");
+	circularListDestroy(loaded);
+	circularListDestroy(deque);
+
+	// a ring whose values wrap around its end
+	deque = circularListCreateRing(4);
+	for(int i = 1; i <= 3; i++)
+	{
+		circularListAddBack(deque, (TYPE)-i);
+	}
+	circularListRemoveFront(deque);
+	circularListRemoveFront(deque);
+	circularListAddBack(deque, (TYPE)-4);
+	circularListAddBack(deque, (TYPE)-5);
+	circularListAddFront(deque, (TYPE)-0.5);
+	length = snapshotBytes(deque, bytes, sizeof(bytes));
+	loaded = snapshotFromBytes(bytes, length);
+	assertTrue(loaded != 0 && dequeEquals(loaded, (TYPE[]){ -0.5, -3, -4, -5 }, 4),
+		"snapshot round trip of a wrapped ring");
+	circularListDestroy(loaded);
+	circularListDestroy(deque);
+
+	deque = circularListCreateFixed(3);
+	for(int i = 1; i <= 5; i++)
+	{
+		circularListAddBack(deque, (TYPE)-i);
+	}
+	length = snapshotBytes(deque, bytes, sizeof(bytes));
+	loaded = snapshotFromBytes(bytes, length);
+	assertTrue(loaded != 0 && dequeEquals(loaded, (TYPE[]){ -3, -4, -5 }, 3),
+		"snapshot round trip of an overwritten fixed ring");
+	circularListDestroy(loaded);
+	circularListClear(deque);
+	length = snapshotBytes(deque, bytes, sizeof(bytes));
+	loaded = snapshotFromBytes(bytes, length);
+	assertTrue(loaded != 0 && circularListIsEmpty(loaded), "snapshot of an empty ring");
+	circularListDestroy(loaded);
+	circularListDestroy(deque);
+
+	circularListTraceEnable(4);
+	deque = circularListCreateRing(2);
+	circularListAddBack(deque, (TYPE)-1.5);
+	circularListAddFront(deque, (TYPE)-2.5);
+	circularListAddBack(deque, (TYPE)-3.5);
+	circularListRemoveFront(deque);
+	circularListTraceEnable(0);
+	circularListAddBack(deque, (TYPE)4);
+	FILE* dump = tmpfile();
+	struct TraceEvent events[8];
+	assertTrue(circularListTraceDump(dump) == 0, "trace dump written");
+	assertTrue(readTrace(dump, events, 8) == 4, "one ring keeps the last 4 ops");
+	assertTrue(events[0].op == TRACE_ADD_BACK && events[1].op == TRACE_ADD_FRONT
+		&& events[2].op == TRACE_ADD_BACK && events[3].op == TRACE_REMOVE_FRONT, "ring deque ops oldest first");
+	assertTrue(events[0].size == 0 && events[1].size == 1 && events[2].size == 2 && events[3].size == 3,
+		"size before each op, across the ring growing");
+	assertTrue(events[1].hash == traceHashOf((TYPE)-2.5) && events[3].hash == traceHashOf((TYPE)-2.5)
+		&& events[2].hash == traceHashOf((TYPE)-3.5), "hashes of negative values");
+	assertTrue(events[0].object == events[3].object && events[0].ticks <= events[3].ticks,
+		"one deque, in time order");
+	fclose(dump);
+	circularListDestroy(deque);
+	free(window);
 	
 	return 0;
 }
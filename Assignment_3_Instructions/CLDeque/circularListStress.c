@@ -0,0 +1,112 @@
+#include "circularList.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+	Stress test for concurrent reads: one writer adds and removes at both
+	ends while several readers scan the deque. The writer keeps the values
+	increasing from front to back (it adds front - 1 at the front and
+	back + 1 at the back), so every scan must see increasing values.
+	Build with -fsanitize=address to catch links freed too early.
+*/
+
+#define READERS 8
+#define WRITES 200000
+#define MAX_SIZE 1000
+
+struct CircularList* deque;
+int writing = 1;
+
+struct Scan
+{
+	TYPE last;
+	int first;
+	int ordered;
+};
+
+void checkOrder(TYPE value, void* context)
+{
+	struct Scan* scan = context;
+	if(!scan->first && !(scan->last < value))
+	{
+		scan->ordered = 0;
+	}
+	scan->first = 0;
+	scan->last = value;
+}
+
+void* reader(void* arg)
+{
+	long* scans = arg;
+	int ok = 1;
+	while(__atomic_load_n(&writing, __ATOMIC_ACQUIRE))
+	{
+		struct Scan scan = { 0, 1, 1 };
+		circularListScan(deque, checkOrder, &scan);
+		ok = ok && scan.ordered;
+		(*scans)++;
+	}
+	return ok ? arg : 0;
+}
+
+int main()
+{
+	deque = circularListCreate();
+	circularListEnableConcurrentReads(deque);
+	circularListAddBack(deque, (TYPE)0);
+	size_t size = 1;
+
+	pthread_t threads[READERS];
+	long scans[READERS] = { 0 };
+	for(int i = 0; i < READERS; i++)
+	{
+		pthread_create(&threads[i], 0, reader, &scans[i]);
+	}
+
+	srand(1);
+	for(int i = 0; i < WRITES; i++)
+	{
+		int op = rand() % 4;
+		if(size == 0)
+		{
+			circularListAddBack(deque, (TYPE)0);
+			size++;
+		}
+		else if(op == 0 && size < MAX_SIZE)
+		{
+			circularListAddFront(deque, circularListFront(deque) - 1);
+			size++;
+		}
+		else if(op == 1 && size < MAX_SIZE)
+		{
+			circularListAddBack(deque, circularListBack(deque) + 1);
+			size++;
+		}
+		else if(op == 2)
+		{
+			circularListRemoveFront(deque);
+			size--;
+		}
+		else
+		{
+			circularListRemoveBack(deque);
+			size--;
+		}
+	}
+	__atomic_store_n(&writing, 0, __ATOMIC_RELEASE);
+
+	int passed = 1;
+	long total = 0;
+	for(int i = 0; i < READERS; i++)
+	{
+		void* ok;
+		pthread_join(threads[i], &ok);
+		passed = passed && ok != 0;
+		total += scans[i];
+	}
+	circularListDestroy(deque);
+	printf("%d writes, %ld scans by %d readers: %s\n", WRITES, total, READERS,
+		passed ? "PASSED" : "FAILED");
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,682 @@
+/***********************************************************
+* Filename: dequeCommon.c
+*
+* Overview:
+*   This file holds the code the linked list, circular list and
+*	stack from queues modules share because it doesn't depend on
+*	their TYPE: the process-wide memory tally every module's
+*	allocations are counted in, and the arenas of fixed-size slots
+*	the modules carve their links out of (and hand the pages of back
+*	to the OS after a trim), the byte stream under their binary
+*	snapshots, and the per-thread rings their ops are traced in.
+************************************************************/
+#define _DEFAULT_SOURCE
+#include "dequeCommon.h"
+#include <assert.h>
+#include <malloc.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// ------------------------------------------------------------------------- //
+//                               MEMORY TALLY                                //
+// ------------------------------------------------------------------------- //
+
+// Process-wide tally of every module's allocations. The counters are
+// updated with relaxed atomics, since lists on different threads
+// allocate at the same time.
+static struct MemoryTally tally;
+
+/**
+	Allocates the given number of bytes and adds them to the process-wide
+	tally, including any slack the allocator rounded the block up to.
+	param:	bytes	size_t
+	pre:	none
+	post:	memory is allocated and counted in tally
+	ret:	ptr to the allocated memory
+ */
+void* tallyMalloc(size_t bytes)
+{
+	void* ptr = malloc(bytes);
+	assert(ptr != 0);
+	__atomic_fetch_add(&tally.requestedBytes, bytes, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&tally.usableBytes, malloc_usable_size(ptr), __ATOMIC_RELAXED);
+	return ptr;
+}
+
+/**
+	Frees memory allocated with tallyMalloc and removes it from the tally.
+	param:	ptr		memory from tallyMalloc
+	param:	bytes	size_t that was passed to tallyMalloc
+	pre:	ptr is not null
+	post:	memory is freed and no longer counted in tally
+ */
+void tallyFree(void* ptr, size_t bytes)
+{
+	assert(ptr != 0);
+	__atomic_fetch_sub(&tally.requestedBytes, bytes, __ATOMIC_RELAXED);
+	__atomic_fetch_sub(&tally.usableBytes, malloc_usable_size(ptr), __ATOMIC_RELAXED);
+	free(ptr);
+}
+
+/**
+	Adds values to (or, with a negative count, removes them from) the
+	tally's element count and payload.
+	param:	count			ptrdiff_t, values added
+	param:	elementBytes	size_t, sizeof the module's TYPE
+	pre:	none
+	post:	tally holds count more values of elementBytes each
+ */
+void tallyElements(ptrdiff_t count, size_t elementBytes)
+{
+	__atomic_fetch_add(&tally.elements, (size_t)count, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&tally.payloadBytes, (size_t)count * elementBytes, __ATOMIC_RELAXED);
+}
+
+/**
+	Reads the process-wide tally. Each counter is read atomically, but
+	not all four at the same instant, so a total taken while other
+	threads allocate may be off by their ops in flight.
+	param:	totals	struct MemoryTally ptr
+	pre:	totals is not null
+	post:	totals holds every module's allocations combined
+ */
+void tallyRead(struct MemoryTally* totals)
+{
+	assert(totals != 0);
+	totals->elements = __atomic_load_n(&tally.elements, __ATOMIC_RELAXED);
+	totals->payloadBytes = __atomic_load_n(&tally.payloadBytes, __ATOMIC_RELAXED);
+	totals->requestedBytes = __atomic_load_n(&tally.requestedBytes, __ATOMIC_RELAXED);
+	totals->usableBytes = __atomic_load_n(&tally.usableBytes, __ATOMIC_RELAXED);
+}
+
+// ------------------------------------------------------------------------- //
+//                                  ARENA                                    //
+// ------------------------------------------------------------------------- //
+
+/**
+	Hands the whole pages inside the given range back to the OS. The
+	range stays mapped; it reads as zeros if it is touched again.
+	param:	start	start of the range
+	param:	bytes	size_t
+	pre:	the range is memory an arena owns and no longer uses
+	post:	physical pages wholly inside the range are released
+ */
+static void releasePages(void* start, size_t bytes)
+{
+	uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+	uintptr_t first = ((uintptr_t)start + page - 1) & ~(page - 1);
+	uintptr_t last = ((uintptr_t)start + bytes) & ~(page - 1);
+	if (first < last)
+	{
+		madvise((void*)first, last - first, MADV_DONTNEED);
+	}
+}
+
+/**
+	Allocates a chunk of the given number of slots.
+	param:	arena		struct Arena ptr
+	param:	capacity	size_t, slots
+	pre:	arena is not null and capacity > 0
+	post:	chunk is allocated and counted in the tally
+	ret:	chunk with no slot used
+ */
+static struct ArenaChunk* chunkCreate(struct Arena* arena, size_t capacity)
+{
+	struct ArenaChunk* chunk = tallyMalloc(sizeof(struct ArenaChunk) + capacity * arena->slotBytes);
+	chunk->next = 0;
+	chunk->capacity = capacity;
+	chunk->used = 0;
+	return chunk;
+}
+
+/**
+	Sets up an arena along with its first chunk.
+	param:	arena		struct Arena ptr
+	param:	slotBytes	size_t, sizeof the slots handed out
+	param:	firstSlots	number of slots in the first chunk; each later
+						chunk is twice the size of the one before, up
+						to ARENA_MAX_CHUNK_SLOTS slots
+	pre:	arena is not null and firstSlots > 0
+	pre:	slotBytes is at least sizeof(void*)
+	post:	memory allocated for one chunk of firstSlots slots
+ */
+void arenaInit(struct Arena* arena, size_t slotBytes, size_t firstSlots)
+{
+	assert(arena != 0);
+	assert(firstSlots > 0);
+	assert(slotBytes >= sizeof(void*));
+	arena->slotBytes = slotBytes;
+	arena->chunks = chunkCreate(arena, firstSlots);
+	arena->current = arena->chunks;
+	arena->freeSlots = 0;
+}
+
+/**
+	Frees every chunk of the arena.
+	param:	arena	struct Arena ptr
+	pre:	arena is not null
+	post:	memory allocated to each chunk is freed
+ */
+void arenaFinish(struct Arena* arena)
+{
+	assert(arena != 0);
+	struct ArenaChunk* chunk = arena->chunks;
+	while (chunk != 0)
+	{
+		struct ArenaChunk* next = chunk->next;
+		tallyFree(chunk, sizeof(struct ArenaChunk) + chunk->capacity * arena->slotBytes);
+		chunk = next;
+	}
+	arena->chunks = 0;
+	arena->current = 0;
+	arena->freeSlots = 0;
+}
+
+/**
+	Moves the arena on to its next chunk when the current one is full,
+	allocating it first if the arena hasn't needed it before, and takes
+	that chunk's first slot. The slow path of arenaAlloc.
+	param:	arena	struct Arena ptr
+	pre:	arena is not null and its current chunk is full
+	post:	returned slot is not null
+	ret:	slot ptr
+ */
+void* arenaGrow(struct Arena* arena)
+{
+	assert(arena != 0);
+	if (arena->current->next == 0)
+	{
+		// each new chunk doubles, so a huge structure needs few chunks
+		size_t capacity = arena->current->capacity;
+		if (capacity < ARENA_MAX_CHUNK_SLOTS)
+		{
+			capacity = capacity * 2 < ARENA_MAX_CHUNK_SLOTS ? capacity * 2 : ARENA_MAX_CHUNK_SLOTS;
+		}
+		arena->current->next = chunkCreate(arena, capacity);
+	}
+	arena->current = arena->current->next;
+	arena->current->used = 1;
+	return arena->current->slots;
+}
+
+/**
+	Rewinds the arena so every chunk can be handed out again. The chunks
+	themselves are kept, so this is O(number of chunks).
+	param:	arena	struct Arena ptr
+	pre:	arena is not null
+	post:	every chunk's used count is 0
+			current is the first chunk and there are no free slots
+ */
+void arenaReset(struct Arena* arena)
+{
+	assert(arena != 0);
+	for (struct ArenaChunk* chunk = arena->chunks; chunk != 0; chunk = chunk->next)
+	{
+		chunk->used = 0;
+	}
+	arena->current = arena->chunks;
+	arena->freeSlots = 0;
+}
+
+/**
+	Takes the first count slots of a fresh arena in one go, as one array,
+	for a structure that is built all at once.
+	param:	arena	struct Arena ptr
+	param:	count	size_t
+	pre:	arena is not null and nothing has been taken from it yet
+	pre:	count is at most the slots in its first chunk
+	post:	the first count slots are used
+	ret:	ptr to the first slot
+ */
+void* arenaBlock(struct Arena* arena, size_t count)
+{
+	assert(arena != 0);
+	assert(arena->current == arena->chunks && arena->chunks->used == 0);
+	assert(count <= arena->chunks->capacity);
+	arena->chunks->used = count;
+	return arena->chunks->slots;
+}
+
+/**
+	Adds the bytes the arena's chunks asked of malloc, and the bytes
+	malloc handed out for them, to the given totals.
+	param:	arena		struct Arena ptr
+	param:	requested	size_t ptr
+	param:	usable		size_t ptr
+	pre:	arena, requested and usable are not null
+	post:	requested and usable include every chunk of arena
+ */
+void arenaMemory(struct Arena* arena, size_t* requested, size_t* usable)
+{
+	assert(arena != 0 && requested != 0 && usable != 0);
+	for (struct ArenaChunk* chunk = arena->chunks; chunk != 0; chunk = chunk->next)
+	{
+		*requested += sizeof(struct ArenaChunk) + chunk->capacity * arena->slotBytes;
+		*usable += malloc_usable_size(chunk);
+	}
+}
+
+/**
+	Hands the pages of the arena's unused slots back to the OS with
+	madvise(MADV_DONTNEED): those past the used slots of the current
+	chunk and all of every later chunk. The chunks themselves are kept,
+	so the next burst reuses them without calling malloc.
+	param:	arena	struct Arena ptr
+	pre:	arena is not null
+	post:	physical pages wholly inside unused chunk space are released
+ */
+void arenaRelease(struct Arena* arena)
+{
+	assert(arena != 0);
+	struct ArenaChunk* chunk = arena->current;
+	releasePages((char*)chunk->slots + chunk->used * arena->slotBytes,
+		(chunk->capacity - chunk->used) * arena->slotBytes);
+	for (chunk = chunk->next; chunk != 0; chunk = chunk->next)
+	{
+		releasePages(chunk->slots, chunk->capacity * arena->slotBytes);
+	}
+}
+
+// ------------------------------------------------------------------------- //
+//                                SNAPSHOTS                                  //
+// ------------------------------------------------------------------------- //
+
+#define FNV_OFFSET 2166136261u
+#define FNV_PRIME 16777619u
+
+/**
+	Writes one byte and adds it to the checksum.
+	param:	stream	struct SnapshotStream ptr
+	param:	byte	unsigned char
+	pre:	stream is not null
+	post:	failed is set if the byte could not be written
+ */
+void snapshotPut(struct SnapshotStream* stream, unsigned char byte)
+{
+	stream->hash = (stream->hash ^ byte) * FNV_PRIME;
+	if (putc(byte, stream->file) == EOF)
+	{
+		stream->failed = 1;
+	}
+}
+
+/**
+	Reads one byte and adds it to the checksum.
+	param:	stream	struct SnapshotStream ptr
+	pre:	stream is not null
+	post:	failed is set if the stream ended
+	ret:	byte read, 0 on failure
+ */
+unsigned char snapshotGet(struct SnapshotStream* stream)
+{
+	int byte = getc(stream->file);
+	if (byte == EOF)
+	{
+		stream->failed = 1;
+		return 0;
+	}
+	stream->hash = (stream->hash ^ (unsigned char)byte) * FNV_PRIME;
+	return (unsigned char)byte;
+}
+
+/**
+	Writes a value 7 bits at a time, low bits first, with the high bit of
+	each byte set when more bytes follow.
+	param:	stream	struct SnapshotStream ptr
+	param:	value	uint64_t
+	pre:	stream is not null
+	post:	1 to 10 bytes are written
+ */
+void snapshotPutVarint(struct SnapshotStream* stream, uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		snapshotPut(stream, (unsigned char)(value | 0x80));
+		value >>= 7;
+	}
+	snapshotPut(stream, (unsigned char)value);
+}
+
+/**
+	Reads a value written by snapshotPutVarint.
+	param:	stream	struct SnapshotStream ptr
+	pre:	stream is not null
+	post:	failed is set if the varint is cut off or too long
+	ret:	value
+ */
+uint64_t snapshotGetVarint(struct SnapshotStream* stream)
+{
+	uint64_t value = 0;
+	for (int shift = 0; shift < 64 && !stream->failed; shift += 7)
+	{
+		unsigned char byte = snapshotGet(stream);
+		value |= (uint64_t)(byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0)
+		{
+			return value;
+		}
+	}
+	stream->failed = 1;
+	return 0;
+}
+
+/**
+	Writes a signed difference as a zigzag varint, so small differences
+	of either sign take one byte.
+	param:	stream	struct SnapshotStream ptr
+	param:	delta	int64_t
+	pre:	stream is not null
+	post:	1 to 10 bytes are written
+ */
+void snapshotPutDelta(struct SnapshotStream* stream, int64_t delta)
+{
+	snapshotPutVarint(stream, ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63));
+}
+
+/**
+	Reads a difference written by snapshotPutDelta.
+	param:	stream	struct SnapshotStream ptr
+	pre:	stream is not null
+	post:	failed is set if the varint is cut off or too long
+	ret:	delta
+ */
+int64_t snapshotGetDelta(struct SnapshotStream* stream)
+{
+	uint64_t zigzag = snapshotGetVarint(stream);
+	return (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+}
+
+/**
+	Returns 1 on a little-endian machine.
+	pre:	none
+	post:	none
+	ret:	1 if the low byte of a value is stored first, otherwise 0
+ */
+static int littleEndian()
+{
+	const uint16_t one = 1;
+	return *(const unsigned char*)&one;
+}
+
+/**
+	Writes the raw bytes of a value, least significant first.
+	param:	stream	struct SnapshotStream ptr
+	param:	value	ptr to width bytes
+	param:	width	size_t
+	pre:	stream and value are not null
+	post:	width bytes are written
+ */
+void snapshotPutBytes(struct SnapshotStream* stream, const void* value, size_t width)
+{
+	const unsigned char* bytes = value;
+	int little = littleEndian();
+	for (size_t i = 0; i < width; i++)
+	{
+		snapshotPut(stream, bytes[little ? i : width - 1 - i]);
+	}
+}
+
+/**
+	Reads the raw bytes of a value written by snapshotPutBytes.
+	param:	stream	struct SnapshotStream ptr
+	param:	value	ptr to room for width bytes
+	param:	width	size_t
+	pre:	stream and value are not null
+	post:	value holds the bytes read; failed is set if they are cut off
+ */
+void snapshotGetBytes(struct SnapshotStream* stream, void* value, size_t width)
+{
+	unsigned char* bytes = value;
+	int little = littleEndian();
+	for (size_t i = 0; i < width; i++)
+	{
+		bytes[little ? i : width - 1 - i] = snapshotGet(stream);
+	}
+}
+
+/**
+	Writes the magic, type and count that start a snapshot.
+	param:	stream	struct SnapshotStream ptr
+	param:	kind	'i' for an integer TYPE, 'f' for floating point
+	param:	width	sizeof(TYPE)
+	param:	count	number of values that will follow
+	pre:	stream is not null
+	post:	header is written; the checksum starts after the magic
+ */
+void snapshotPutHeader(struct SnapshotStream* stream, char kind, size_t width, size_t count)
+{
+	fputs("DQS1", stream->file);
+	stream->hash = FNV_OFFSET;
+	snapshotPut(stream, (unsigned char)kind);
+	snapshotPut(stream, (unsigned char)width);
+	snapshotPutVarint(stream, count);
+}
+
+/**
+	Reads a snapshot header and checks that it holds the given TYPE.
+	param:	stream	struct SnapshotStream ptr
+	param:	kind	'i' for an integer TYPE, 'f' for floating point
+	param:	width	sizeof(TYPE)
+	pre:	stream is not null
+	post:	failed is set if the header is missing or for another TYPE
+	ret:	number of values that follow
+ */
+size_t snapshotGetHeader(struct SnapshotStream* stream, char kind, size_t width)
+{
+	char magic[4];
+	if (fread(magic, 1, 4, stream->file) != 4 || memcmp(magic, "DQS1", 4) != 0)
+	{
+		stream->failed = 1;
+		return 0;
+	}
+	stream->hash = FNV_OFFSET;
+	unsigned char readKind = snapshotGet(stream);
+	unsigned char readWidth = snapshotGet(stream);
+	if (readKind != (unsigned char)kind || readWidth != width)
+	{
+		stream->failed = 1;
+	}
+	return (size_t)snapshotGetVarint(stream);
+}
+
+/**
+	Writes the checksum that ends a snapshot and flushes the file.
+	param:	stream	struct SnapshotStream ptr
+	pre:	stream is not null
+	post:	checksum is written
+	ret:	0 if the whole snapshot was written, otherwise -1
+ */
+int snapshotPutTrailer(struct SnapshotStream* stream)
+{
+	uint32_t hash = stream->hash;
+	for (int i = 0; i < 4; i++)
+	{
+		snapshotPut(stream, (unsigned char)(hash >> (8 * i)));
+	}
+	if (fflush(stream->file) == EOF)
+	{
+		stream->failed = 1;
+	}
+	return stream->failed ? -1 : 0;
+}
+
+/**
+	Reads the checksum that ends a snapshot and compares it with the one
+	computed over what was read.
+	param:	stream	struct SnapshotStream ptr
+	pre:	stream is not null
+	post:	none
+	ret:	0 if the whole snapshot was read intact, otherwise -1
+ */
+int snapshotGetTrailer(struct SnapshotStream* stream)
+{
+	uint32_t expected = stream->hash;
+	uint32_t hash = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		hash |= (uint32_t)snapshotGet(stream) << (8 * i);
+	}
+	return stream->failed || hash != expected ? -1 : 0;
+}
+
+// ------------------------------------------------------------------------- //
+//                                 TRACING                                   //
+// ------------------------------------------------------------------------- //
+
+/**
+	Gives the calling thread a ring of the given capacity and links it
+	into the log's list of rings with a compare and swap.
+	param:	log			struct TraceLog ptr
+	param:	capacity	size_t, a power of two
+	pre:	log is not null and the calling thread has no ring in it
+	post:	the ring is the newest of the log's rings
+	ret:	the thread's new, empty ring
+ */
+struct TraceRing* traceAttach(struct TraceLog* log, size_t capacity)
+{
+	assert(log != 0);
+	struct TraceRing* ring = malloc(sizeof(struct TraceRing) + capacity * sizeof(struct TraceEvent));
+	assert(ring != 0);
+	ring->head = 0;
+	ring->mask = capacity - 1;
+	ring->thread = __atomic_fetch_add(&log->threads, 1, __ATOMIC_RELAXED);
+	ring->next = __atomic_load_n(&log->rings, __ATOMIC_RELAXED);
+	while (!__atomic_compare_exchange_n(&log->rings, &ring->next, ring, 1,
+		__ATOMIC_RELEASE, __ATOMIC_RELAXED))
+		;
+	return ring;
+}
+
+/**
+	Turns tracing into the log on or off. A thread gets its ring the
+	first time it traces, sized by the latest call to this; turning
+	tracing off keeps the rings, so they can still be dumped.
+	param:	log		struct TraceLog ptr
+	param:	events	events each thread keeps (rounded up to a power of
+					two), 0 to turn tracing off
+	pre:	log is not null
+	post:	ops are traced into log if events > 0
+ */
+void traceEnable(struct TraceLog* log, size_t events)
+{
+	assert(log != 0);
+	size_t capacity = 0;
+	if (events > 0)
+	{
+		capacity = 1;
+		while (capacity < events)
+		{
+			capacity *= 2;
+		}
+	}
+	__atomic_store_n(&log->capacity, capacity, __ATOMIC_RELAXED);
+}
+
+/**
+	Writes a little-endian field of a trace dump.
+	param:	out		FILE ptr
+	param:	value	uint64_t
+	param:	bytes	width of the field
+	pre:	out is not null
+	post:	bytes bytes are written to out
+ */
+static void tracePut(FILE* out, uint64_t value, int bytes)
+{
+	for (int i = 0; i < bytes; i++)
+	{
+		fputc((int)(value >> (8 * i)) & 0xff, out);
+	}
+}
+
+/**
+	Returns how many ticks of the event clock there are per second,
+	timing the time stamp counter against the monotonic clock for 10ms.
+	pre:	none
+	post:	none
+	ret:	ticks per second
+ */
+static uint64_t traceTicksPerSecond()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	struct timespec start, now;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	uint64_t startTicks = __rdtsc();
+	uint64_t elapsed;
+	do
+	{
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		elapsed = (uint64_t)(now.tv_sec - start.tv_sec) * 1000000000u
+			+ (uint64_t)now.tv_nsec - (uint64_t)start.tv_nsec;
+	}
+	while (elapsed < 10000000u);
+	return (uint64_t)((double)(__rdtsc() - startTicks) * 1e9 / (double)elapsed);
+#else
+	return 1000000000u;
+#endif
+}
+
+/**
+	Writes every ring of the log in the dump format of dequeCommon.h.
+	Threads may keep tracing while this runs: each ring is copied and any
+	events that were overwritten during the copy are left out, along with
+	another thread's oldest event if its ring is full (it may be the one
+	being overwritten). The event clock is timed for 10ms to record its
+	rate.
+	param:	log		struct TraceLog ptr
+	param:	own		the calling thread's ring in log, or 0
+	param:	module	'L', 'C' or 'Q'
+	param:	out		FILE ptr open for writing
+	pre:	log and out are not null
+	post:	a dump of every ring is written to out
+	ret:	0 on success, -1 if writing failed
+ */
+int traceDump(struct TraceLog* log, struct TraceRing* own, char module, FILE* out)
+{
+	assert(log != 0 && out != 0);
+	struct TraceRing* rings = __atomic_load_n(&log->rings, __ATOMIC_ACQUIRE);
+	uint32_t count = 0;
+	for (struct TraceRing* ring = rings; ring != 0; ring = ring->next)
+	{
+		count++;
+	}
+	fwrite("DQT1", 1, 4, out);
+	tracePut(out, (unsigned char)module, 1);
+	tracePut(out, traceTicksPerSecond(), 8);
+	tracePut(out, count, 4);
+	for (struct TraceRing* ring = rings; ring != 0; ring = ring->next)
+	{
+		size_t capacity = ring->mask + 1;
+		uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+		uint64_t first = head > capacity ? head - capacity : 0;
+		struct TraceEvent* events = malloc((head - first + 1) * sizeof(struct TraceEvent));
+		assert(events != 0);
+		for (uint64_t i = first; i < head; i++)
+		{
+			events[i - first] = ring->events[i & ring->mask];
+		}
+		// events another thread lapped (or is lapping) while they were
+		// copied may be torn
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		uint64_t now = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) + (ring != own);
+		uint64_t valid = now > capacity && now - capacity > first ? now - capacity : first;
+		if (valid > head)
+		{
+			valid = head;
+		}
+		tracePut(out, ring->thread, 4);
+		tracePut(out, head - valid, 8);
+		for (uint64_t i = valid; i < head; i++)
+		{
+			struct TraceEvent* event = &events[i - first];
+			tracePut(out, event->ticks, 8);
+			tracePut(out, event->size, 8);
+			tracePut(out, event->hash, 4);
+			tracePut(out, event->op, 2);
+			tracePut(out, event->object, 2);
+		}
+		free(events);
+	}
+	return fflush(out) == 0 && !ferror(out) ? 0 : -1;
+}
@@ -0,0 +1,305 @@
+#ifndef DEQUE_COMMON_H
+#define DEQUE_COMMON_H
+
+/*
+	Support code shared by the linked list, the circular list and the
+	stack from queues that doesn't depend on their TYPE. Each module
+	keeps only its TYPE-specific parts on top of this.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Memory tally
+
+// Totals of every list, deque and queue in the process (see tallyRead)
+struct MemoryTally
+{
+	size_t elements;
+	size_t payloadBytes;	// bytes holding values, whatever each one's TYPE
+	size_t requestedBytes;	// bytes asked of malloc
+	size_t usableBytes;		// bytes malloc handed out
+};
+
+void* tallyMalloc(size_t bytes);
+void tallyFree(void* ptr, size_t bytes);
+void tallyElements(ptrdiff_t count, size_t elementBytes);
+void tallyRead(struct MemoryTally* totals);
+
+// Arena
+
+// Largest chunk an arena grows to, in slots
+#ifndef ARENA_MAX_CHUNK_SLOTS
+#define ARENA_MAX_CHUNK_SLOTS ((size_t)1 << 20)
+#endif
+
+// Lines a chunk's slots up for any TYPE the modules hold
+union ArenaAlign
+{
+	void* ptr;
+	long long integer;
+	double real;
+};
+
+// Block of slots handed out by an arena's bump pointer
+struct ArenaChunk
+{
+	struct ArenaChunk* next;
+	size_t capacity;
+	size_t used;
+	union ArenaAlign slots[];
+};
+
+// Bump-pointer region fixed-size slots (one module's links) come from
+struct Arena
+{
+	struct ArenaChunk* chunks;	// first chunk
+	struct ArenaChunk* current;	// chunk being bumped
+	void* freeSlots;			// freed slots, chained through their first bytes
+	size_t slotBytes;
+};
+
+void arenaInit(struct Arena* arena, size_t slotBytes, size_t firstSlots);
+void arenaFinish(struct Arena* arena);
+void* arenaGrow(struct Arena* arena);
+void arenaReset(struct Arena* arena);
+void* arenaBlock(struct Arena* arena, size_t count);
+void arenaMemory(struct Arena* arena, size_t* requested, size_t* usable);
+void arenaRelease(struct Arena* arena);
+
+/**
+	Takes a slot from the arena: a previously freed slot if there is one,
+	otherwise the next unused slot of the current chunk (see arenaGrow
+	for when it is full).
+	param:	arena	struct Arena ptr
+	pre:	arena is not null
+	post:	returned slot is not null
+	ret:	slot ptr
+ */
+static inline void* arenaAlloc(struct Arena* arena)
+{
+	if (arena->freeSlots != 0)
+	{
+		void* slot = arena->freeSlots;
+		arena->freeSlots = *(void**)slot;
+		return slot;
+	}
+	if (arena->current->used == arena->current->capacity)
+	{
+		return arenaGrow(arena);
+	}
+	return (char*)arena->current->slots + arena->current->used++ * arena->slotBytes;
+}
+
+/**
+	Gives a slot back to the arena it came from for the next arenaAlloc.
+	param:	arena	struct Arena ptr
+	param:	slot	slot from arenaAlloc or arenaBlock
+	pre:	arena and slot are not null
+	post:	slot may no longer be used
+ */
+static inline void arenaFree(struct Arena* arena, void* slot)
+{
+	*(void**)slot = arena->freeSlots;
+	arena->freeSlots = slot;
+}
+
+// Snapshots
+
+/*
+	Snapshot format, all multi-byte fields little-endian:
+		"DQS1"			magic
+		kind			'i' for integer TYPEs, 'f' for floating point
+		width			sizeof(TYPE)
+		count			varint
+		values			integers: zigzag varint of the difference from the
+						previous value (the first from 0); floating point:
+						the width raw bytes
+		checksum		4 bytes, FNV-1a of everything after the magic
+	Values are streamed through stdio one at a time, so neither side ever
+	holds the whole encoding in memory. Each module encodes its own TYPE
+	with the put and get functions below.
+*/
+
+// Snapshot being written or read, with its running checksum
+struct SnapshotStream
+{
+	FILE* file;
+	uint32_t hash;
+	int failed;
+};
+
+void snapshotPut(struct SnapshotStream* stream, unsigned char byte);
+unsigned char snapshotGet(struct SnapshotStream* stream);
+void snapshotPutVarint(struct SnapshotStream* stream, uint64_t value);
+uint64_t snapshotGetVarint(struct SnapshotStream* stream);
+void snapshotPutDelta(struct SnapshotStream* stream, int64_t delta);
+int64_t snapshotGetDelta(struct SnapshotStream* stream);
+void snapshotPutBytes(struct SnapshotStream* stream, const void* value, size_t width);
+void snapshotGetBytes(struct SnapshotStream* stream, void* value, size_t width);
+void snapshotPutHeader(struct SnapshotStream* stream, char kind, size_t width, size_t count);
+size_t snapshotGetHeader(struct SnapshotStream* stream, char kind, size_t width);
+int snapshotPutTrailer(struct SnapshotStream* stream);
+int snapshotGetTrailer(struct SnapshotStream* stream);
+
+// Tracing
+
+/*
+	Tracing records each op in a ring of events owned by the calling
+	thread, so recording never takes a lock or touches another thread's
+	cache lines. Rings are linked into their module's TraceLog when their
+	thread first traces and are kept for the life of the process, so a
+	dump still has the events of threads that have exited.
+
+	Trace dump format, all multi-byte fields little-endian:
+		"DQT1"			magic
+		module			'L' linked list, 'C' circular list, 'Q' queues and stacks
+		ticksPerSecond	8 bytes, rate of the event clock
+		rings			4 bytes, number of thread rings that follow
+	and for each ring:
+		thread			4 bytes, order the thread first traced in
+		count			8 bytes, number of events that follow, oldest first
+		events			ticks (8), size (8), hash (4), op (2), object (2)
+	Trace/traceDecode prints a dump as one timeline.
+*/
+
+// Trace op codes, the same in every module's dumps
+enum TraceOp
+{
+	TRACE_CREATE = 1, TRACE_DESTROY, TRACE_ADD_FRONT, TRACE_ADD_BACK, TRACE_REMOVE_FRONT,
+	TRACE_REMOVE_BACK, TRACE_ADD, TRACE_CONTAINS, TRACE_REMOVE, TRACE_CLEAR, TRACE_SORT,
+	TRACE_TRIM, TRACE_REVERSE, TRACE_PUSH, TRACE_POP
+};
+
+/**
+	Returns the name of a trace op code, for printing dumps.
+	param:	op	op code from a dump
+	pre:	none
+	post:	none
+	ret:	name of the op, or "?" if it is not an enum TraceOp
+ */
+static inline const char* traceOpName(unsigned op)
+{
+	static const char* const names[] = {
+		[TRACE_CREATE] = "Create", [TRACE_DESTROY] = "Destroy",
+		[TRACE_ADD_FRONT] = "AddFront", [TRACE_ADD_BACK] = "AddBack",
+		[TRACE_REMOVE_FRONT] = "RemoveFront", [TRACE_REMOVE_BACK] = "RemoveBack",
+		[TRACE_ADD] = "Add", [TRACE_CONTAINS] = "Contains", [TRACE_REMOVE] = "Remove",
+		[TRACE_CLEAR] = "Clear", [TRACE_SORT] = "Sort", [TRACE_TRIM] = "Trim",
+		[TRACE_REVERSE] = "Reverse", [TRACE_PUSH] = "Push", [TRACE_POP] = "Pop"
+	};
+	return op < sizeof(names) / sizeof(names[0]) && names[op] != 0 ? names[op] : "?";
+}
+
+// One traced op
+struct TraceEvent
+{
+	uint64_t ticks;		// time stamp counter (monotonic ns where there is none)
+	uint64_t size;		// size of the structure when the op started
+	uint32_t hash;		// hash of the op's value, 0 if it has none
+	uint16_t op;		// enum TraceOp
+	uint16_t object;	// hash of the structure's address, to tell them apart
+};
+
+// Events of one thread, oldest overwritten first
+struct TraceRing
+{
+	struct TraceRing* next;		// every ring, newest first
+	uint32_t thread;			// order the thread first traced in
+	uint64_t head;				// events written so far
+	size_t mask;				// capacity - 1, capacity a power of two
+	struct TraceEvent events[];
+};
+
+// Tracing state of one module, shared by every thread; capacity is 0
+// while it is off
+struct TraceLog
+{
+	size_t capacity;
+	struct TraceRing* rings;
+	uint32_t threads;
+};
+
+struct TraceRing* traceAttach(struct TraceLog* log, size_t capacity);
+void traceEnable(struct TraceLog* log, size_t events);
+int traceDump(struct TraceLog* log, struct TraceRing* own, char module, FILE* out);
+
+/**
+	Mixes the bits of a hash so that nearby values land far apart.
+	param:	x	uint64_t
+	pre:	none
+	post:	none
+	ret:	mixed hash
+ */
+static inline uint64_t mixHash(uint64_t x)
+{
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ull;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebull;
+	x ^= x >> 31;
+	return x;
+}
+
+/**
+	Reads the event clock: the time stamp counter on x86, otherwise the
+	monotonic clock in nanoseconds.
+	pre:	none
+	post:	none
+	ret:	ticks
+ */
+static inline uint64_t traceNow()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+#endif
+}
+
+/**
+	Records an op in the calling thread's ring of the log, giving the
+	thread a ring first if it has none, and overwriting its oldest event
+	once the ring is full. While tracing is off this is one load and a
+	branch; while it is on, a time stamp and a 24 byte store.
+	param:	log		struct TraceLog ptr
+	param:	own		the calling thread's ring ptr for log, 0 until it has one
+	param:	op		enum TraceOp
+	param:	object	the structure the op is on
+	param:	hash	bits or hash of the value, or 0
+	param:	size	size of the structure
+	pre:	log and own are not null
+	post:	the op is the thread's newest event if tracing is on
+ */
+static inline void traceRecord(struct TraceLog* log, struct TraceRing** own, int op,
+	const void* object, uint64_t hash, size_t size)
+{
+	size_t capacity = __atomic_load_n(&log->capacity, __ATOMIC_RELAXED);
+	if (capacity == 0)
+	{
+		return;
+	}
+	if (*own == 0)
+	{
+		*own = traceAttach(log, capacity);
+	}
+	struct TraceRing* ring = *own;
+	uint64_t head = ring->head;
+	struct TraceEvent* event = &ring->events[head & ring->mask];
+	event->ticks = traceNow();
+	event->size = size;
+	event->hash = (uint32_t)(mixHash(hash) >> 32);
+	event->op = (uint16_t)op;
+	event->object = (uint16_t)(mixHash((uintptr_t)object) >> 48);
+	// publish the finished event to a dump running on another thread
+	__atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+#endif
@@ -16,6 +16,8 @@
 *		- adding a new link
 *		- checking if a link exists with a given value
 *		- removing a link  with a given value if it exists
+*		- union, intersection and difference with another bag,
+*		  in O(n + m) with a hash table counting the other bag
 *	Both allow for:
 *		- checking if empty
 *		- printing the values of all of the links
@@ -23,39 +25,299 @@
 *	Note that both implementations utilize a linked list with
 *	both a front and back sentinel and double links (links with
 *	next and prev pointers).
+*	The sentinels and the first few links (LINKED_LIST_SMALL) are
+*	part of the list struct, so creating and filling a short list
+*	takes a single allocation; links beyond those come from malloc
+*	(or the list's arena).
+*	After a burst, linkedListTrim packs an arena list's links into
+*	its first chunks and hands the pages of the rest back to the
+*	OS (the chunks are kept for the next burst); it can also run
+*	on its own when a list shrinks well below its peak.
+*	The add ops have variants that return a handle to the new link,
+*	which removes or moves it to either end in O(1) (an LRU list).
+*	In lazy delete mode (linkedListLazyDelete) a bag remove only marks
+*	the link as a tombstone; tombstones are unlinked and their links
+*	recycled in one pass once there are enough of them.
+*	Op tracing (linkedListTraceEnable) keeps each thread's most
+*	recent ops in a ring of its own for post-mortem debugging.
 ************************************************************/
+#define _DEFAULT_SOURCE
 #include "linkedList.h"
+#include "linkedListInline.h"
+#include "dequeCommon.h"
 #include <assert.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
 
 #ifndef FORMAT_SPECIFIER
 #define FORMAT_SPECIFIER "%d"
 #endif
 
-// Double link
-struct Link
+#ifndef SORT_MAX_THREADS
+#define SORT_MAX_THREADS 64
+#endif
+
+// Auto trim runs once a list is down to 1 / TRIM_RATIO of its peak
+#ifndef TRIM_RATIO
+#define TRIM_RATIO 4
+#endif
+
+// Bump-pointer region the links of one list at a time are allocated from
+struct LinkedListArena
 {
-	TYPE value;
-	struct Link* next;
-	struct Link* prev;
+	struct Arena links;
+	struct LinkedList* owner;
 };
 
-// Double linked list with front and back sentinels
-struct LinkedList
+// Counting Bloom filter over the list's values (see linkedListEnableFilter)
+struct BagFilter
 {
-	struct Link* frontSentinel;
-	struct Link* backSentinel;
-	int size;
+	unsigned char* counters;	// saturate at 255 and then never go down
+	size_t slots;
+	int hashes;
+	size_t expected;
+	double falsePositiveRate;
 };
 
 /**
-  	Allocates the list's sentinel and sets the size to 0.
+	Fills in the derived fields of a memory usage report from its element
+	count and the bytes requested from and handed out by the allocator.
+	param:	usage		struct LinkedListMemory ptr
+	param:	elements	size_t
+	param:	payload		size_t, bytes holding the values
+	param:	requested	size_t
+	param:	usable		size_t
+	pre:	usage is not null
+	post:	every field of usage is set
+ */
+static void fillMemory(struct LinkedListMemory* usage, size_t elements,
+	size_t payload, size_t requested, size_t usable)
+{
+	assert(usage != 0);
+	usage->elements = elements;
+	usage->payloadBytes = payload;
+	usage->overheadBytes = requested - usage->payloadBytes;
+	usage->slackBytes = usable - requested;
+	usage->totalBytes = usable;
+	usage->bytesPerElement = elements == 0 ? 0.0 : (double)usable / elements;
+}
+
+/**
+	Returns 1 if the link is one of the list's embedded small links.
+	param:	list	struct LinkedList ptr
+	param:	link	struct Link ptr
+	pre:	list and link are not null
+	post:	none
+	ret:	1 if link is in list->small, otherwise 0
+ */
+static int isSmallLink(struct LinkedList* list, struct Link* link)
+{
+	return (uintptr_t)link - (uintptr_t)list->small < sizeof(list->small);
+}
+
+/**
+	Chains every embedded small link onto the list's small free list.
+	param:	list	struct LinkedList ptr
+	pre:	list is not null
+	pre:	no small link is in use
+	post:	every small link is free
+ */
+static void smallReset(struct LinkedList* list)
+{
+	list->smallFree = 0;
+	for (int i = LINKED_LIST_SMALL - 1; i >= 0; i--)
+	{
+		list->small[i].next = list->smallFree;
+		list->smallFree = &list->small[i];
+	}
+}
+
+/**
+	Allocates a link for the list: a tombstone from its graveyard (see
+	linkedListLazyDelete) or a free embedded small link if there is one,
+	otherwise from its arena if it has one, otherwise from malloc.
+	param:	list	struct LinkedList ptr
+	pre:	list is not null
+	post:	returned link is not null
+	ret:	link ptr
+ */
+static struct Link* allocLink(struct LinkedList* list)
+{
+	assert(list != 0);
+	if (list->graveyard != 0)
+	{
+		struct Link* link = list->graveyard;
+		list->graveyard = link->next;
+		list->buried--;
+		return link;
+	}
+	if (list->smallFree != 0)
+	{
+		struct Link* link = list->smallFree;
+		list->smallFree = link->next;
+		return link;
+	}
+	if (list->arena != 0)
+	{
+		return arenaAlloc(&list->arena->links);
+	}
+	return tallyMalloc(sizeof(struct Link));
+}
+
+/**
+	Releases a link allocated with allocLink: back onto the small free
+	list if it is embedded, onto the arena's free list if the list has
+	one, otherwise to the allocator.
+	param:	list	struct LinkedList ptr
+	param:	link	struct Link ptr
+	pre:	list and link are not null
+	post:	link may no longer be used
+ */
+static void freeLink(struct LinkedList* list, struct Link* link)
+{
+	assert(list != 0 && link != 0);
+	if (isSmallLink(list, link))
+	{
+		link->next = list->smallFree;
+		list->smallFree = link;
+		return;
+	}
+	if (list->arena != 0)
+	{
+		arenaFree(&list->arena->links, link);
+		return;
+	}
+	tallyFree(link, sizeof(struct Link));
+}
+
+/**
+	Allocates a filter sized for the expected number of values at the
+	given false positive rate: hashes = log2(1 / rate) rounded up, and
+	slots = expected * hashes / ln 2, the optimal ratio for that many
+	hashes.
+	param:	expected			size_t
+	param:	falsePositiveRate	double, between 0 and 1
+	pre:	0 < falsePositiveRate < 1
+	post:	filter is empty
+	ret:	filter
+ */
+static struct BagFilter* filterCreate(size_t expected, double falsePositiveRate)
+{
+	assert(falsePositiveRate > 0 && falsePositiveRate < 1);
+	struct BagFilter* filter = tallyMalloc(sizeof(struct BagFilter));
+	filter->hashes = 1;
+	for (double rate = 0.5; rate > falsePositiveRate && filter->hashes < 16; rate /= 2)
+	{
+		filter->hashes++;
+	}
+	filter->expected = expected > 0 ? expected : 1;
+	filter->falsePositiveRate = falsePositiveRate;
+	filter->slots = (size_t)(filter->expected * filter->hashes * 1.4427) + 1;
+	filter->counters = tallyMalloc(filter->slots);
+	for (size_t i = 0; i < filter->slots; i++)
+	{
+		filter->counters[i] = 0;
+	}
+	return filter;
+}
+
+/**
+	Frees the filter and its counters.
+	param:	filter	struct BagFilter ptr
+	pre:	filter is not null
+	post:	filter may no longer be used
+ */
+static void filterDestroy(struct BagFilter* filter)
+{
+	assert(filter != 0);
+	tallyFree(filter->counters, filter->slots);
+	tallyFree(filter, sizeof(struct BagFilter));
+}
+
+/**
+	Adds (delta 1), removes (delta -1) or looks up (delta 0) a value in
+	the filter. Each of the filter's hashes picks one counter, by double
+	hashing. A counter that reaches 255 stays there, since it no longer
+	knows how many values share it.
+	param:	filter	struct BagFilter ptr
+	param:	value	TYPE
+	param:	delta	1, -1 or 0
+	pre:	filter is not null
+	post:	the value's counters are updated
+	ret:	0 if the value is certainly not in the list, otherwise 1
+ */
+static int filterUpdate(struct BagFilter* filter, TYPE value, int delta)
+{
+	uint64_t h1 = mixHash(HASH(value));
+	uint64_t h2 = mixHash(h1) | 1;
+	for (int i = 0; i < filter->hashes; i++)
+	{
+		unsigned char* counter = &filter->counters[(h1 + i * h2) % filter->slots];
+		if (delta == 0 && *counter == 0)
+		{
+			return 0;
+		}
+		if (*counter != 255)
+		{
+			*counter += delta;
+		}
+	}
+	return 1;
+}
+
+/**
+	Replaces the list's filter with one sized for twice its current size
+	and adds every value to it. Called when the list has grown well past
+	what the filter was sized for, so the false positive rate holds.
+	param:	list	struct LinkedList ptr
+	pre:	list is not null and has a filter
+	post:	list has a new filter holding every value
+ */
+static void filterRebuild(struct LinkedList* list)
+{
+	double rate = list->filter->falsePositiveRate;
+	filterDestroy(list->filter);
+	list->filter = filterCreate(2 * list->size, rate);
+	for (struct Link* link = list->frontSentinel->next; link != list->backSentinel; link = link->next)
+	{
+		if (!link->dead)
+		{
+			filterUpdate(list->filter, link->value, 1);
+		}
+	}
+}
+
+// Tracing state of every list's ops (see linkedListTraceEnable); each thread
+// records into a ring of its own (see dequeCommon.h)
+static struct TraceLog trace;
+static __thread struct TraceRing* traceRing;
+
+/**
+	Records an op in the calling thread's ring (see traceRecord).
+	param:	op		enum TraceOp
+	param:	object	the list the op is on
+	param:	hash	HASH of the value, or 0
+	param:	size	size of the list
+	pre:	none
+	post:	the op is the thread's newest event if tracing is on
+ */
+static void traceOp(int op, const void* object, uint64_t hash, size_t size)
+{
+	traceRecord(&trace, &traceRing, op, object, hash, size);
+}
+
+/**
+  	Sets up the list's sentinel and sets the size to 0.
   	The sentinels' next and prev should point to eachother or NULL
-  	as appropriate.
+  	as appropriate. The sentinels are embedded in the list struct.
 	param: 	list 	struct LinkedList ptr
 	pre: 	list is not null
 	post: 	list front and back sentinel not null
+			every small link is free
 			front sentinel next points to back
 			front sentinel prev points to null
 			back sentinel prev points to front
@@ -70,16 +332,19 @@ static void init(struct LinkedList* list) {
 
 	assert(list !=0);
 
-	list->frontSentinel = (struct Link *) malloc(sizeof(struct Link));
-	assert(list->frontSentinel != 0);
-	// allocate back sentinel
-	list->backSentinel = (struct Link *) malloc(sizeof(struct Link));
-	assert(list->backSentinel);
+	list->frontSentinel = &list->sentinels[0];
+	list->backSentinel = &list->sentinels[1];
 	list->frontSentinel->next = list->backSentinel;
 	list->backSentinel->prev = list->frontSentinel;
 	list->frontSentinel->prev = 0;
 	list->backSentinel->next = 0;
+	list->frontSentinel->dead = 0;
+	list->backSentinel->dead = 0;
 	list->size = 0;
+	list->tombstones = 0;
+	list->graveyard = 0;
+	list->buried = 0;
+	smallReset(list);
 }
 
 /**
@@ -101,7 +366,7 @@ static void adLinkBefore(struct LinkedList* list, struct Link* link, TYPE value)
 	//void _adLink (struct linkedList *q, struct Link *lnk, TYPE e) {
 	// allocate new link
 	assert(list != 0 && link != 0);
-	struct Link* newLink = malloc(sizeof(struct Link));
+	struct Link* newLink = allocLink(list);
 	assert(newLink != 0);
 	// set pointer connections
 	newLink->prev = link->prev;
@@ -110,7 +375,149 @@ static void adLinkBefore(struct LinkedList* list, struct Link* link, TYPE value)
 	link->prev = newLink;
 	// set new link value and increment size of list
 	newLink->value = value;
+	newLink->dead = 0;
 	list->size++;
+	tallyElements(1, sizeof(TYPE));
+	if (list->size > list->peak)
+	{
+		list->peak = list->size;
+	}
+	if (list->filter != 0)
+	{
+		if (list->size > 2 * list->filter->expected)
+		{
+			filterRebuild(list);
+		}
+		else
+		{
+			filterUpdate(list->filter, value, 1);
+		}
+	}
+}
+
+/**
+	Unlinks a tombstone (see linkedListLazyDelete) and puts it in the
+	list's graveyard, where it waits, still allocated, to be recycled
+	with the rest at the next compaction. Its value was already taken
+	out of the size, tally and filter when it was marked.
+	param:	list	struct LinkedList ptr
+	param:	link	struct Link ptr
+	pre:	list and link are not null
+	pre:	link is a tombstone in list
+	post:	link is in the graveyard; list has one tombstone fewer
+ */
+static void unlinkDead(struct LinkedList* list, struct Link* link)
+{
+	assert(list != 0 && link != 0 && link->dead);
+	link->next->prev = link->prev;
+	link->prev->next = link->next;
+	link->next = list->graveyard;
+	list->graveyard = link;
+	list->tombstones--;
+	list->buried++;
+}
+
+/**
+	Unlinks every tombstone in the list and recycles their links along
+	with those in the graveyard, in one pass. O(n + tombstones).
+	param:	list	struct LinkedList ptr
+	pre:	list is not null
+	post:	list has no tombstones and an empty graveyard
+ */
+static void compact(struct LinkedList* list)
+{
+	struct Link* link = list->frontSentinel->next;
+	while (list->tombstones != 0 && link != list->backSentinel)
+	{
+		struct Link* next = link->next;
+		if (link->dead)
+		{
+			unlinkDead(list, link);
+		}
+		link = next;
+	}
+	while (list->graveyard != 0)
+	{
+		link = list->graveyard;
+		list->graveyard = link->next;
+		freeLink(list, link);
+	}
+	list->buried = 0;
+}
+
+/**
+	Marks a link as a tombstone instead of unlinking it: its value is
+	taken out of the list's size, the tally and the filter, and the link
+	is skipped from then on. Once tombstones (linked or in the graveyard)
+	make up more than the list's compactRatio of its links, they are all
+	recycled at once (or the
+	list is trimmed, if its auto trim policy says so, which does the
+	same).
+	param:	list	struct LinkedList ptr
+	param:	link	struct Link ptr
+	pre:	list and link are not null
+	pre:	link is live and is neither the first nor the last link
+	post:	link is a tombstone or has been unlinked and freed
+ */
+static void markDead(struct LinkedList* list, struct Link* link)
+{
+	assert(list != 0 && link != 0 && !link->dead);
+	link->dead = 1;
+	if (list->filter != 0)
+	{
+		filterUpdate(list->filter, link->value, -1);
+	}
+	list->size--;
+	list->tombstones++;
+	tallyElements(-1, sizeof(TYPE));
+	if (list->trimPeak != 0 && list->peak >= list->trimPeak
+		&& list->size < list->peak / TRIM_RATIO)
+	{
+		linkedListTrim(list);
+	}
+	else if (list->tombstones + list->buried
+		> list->compactRatio * (list->size + list->tombstones + list->buried))
+	{
+		compact(list);
+	}
+}
+
+/**
+	Unlinks the tombstones at the front and back of the list, so its
+	first and last links are always live and the deque ops never have
+	to skip any. Each tombstone is unlinked once, so this is O(1)
+	amortized.
+	param:	list	struct LinkedList ptr
+	pre:	list is not null
+	post:	list's first and last links (if any) are not tombstones
+ */
+static void dropDeadEnds(struct LinkedList* list)
+{
+	while (list->frontSentinel->next->dead)
+	{
+		unlinkDead(list, list->frontSentinel->next);
+	}
+	while (list->backSentinel->prev->dead)
+	{
+		unlinkDead(list, list->backSentinel->prev);
+	}
+}
+
+/**
+	Steps a walk over the tombstones it has reached without touching
+	them, so a walk never changes the list's links.
+	param:	link	struct Link ptr, where the walk is
+	pre:	link is not null
+	post:	none
+	ret:	the next live link at or after link, or the back sentinel
+ */
+static struct Link* skipDead(struct Link* link)
+{
+	while (link->dead)
+	{
+		link = link->next;
+	}
+	return link;
 }
 
 /**
@@ -134,12 +541,25 @@ static void removeLink(struct LinkedList* list, struct Link* link)
 
 	link->next->prev = link->prev;
 	link->prev->next = link->next;
+	if (list->filter != 0)
+	{
+		filterUpdate(list->filter, link->value, -1);
+	}
 	// free memory
-	free(link);
+	freeLink(list, link);
 	link = 0;
 	// decrement size
 	list->size--;
-
+	tallyElements(-1, sizeof(TYPE));
+	if (list->tombstones != 0)
+	{
+		dropDeadEnds(list);
+	}
+	if (list->trimPeak != 0 && list->peak >= list->trimPeak
+		&& list->size < list->peak / TRIM_RATIO)
+	{
+		linkedListTrim(list);
+	}
 }
 
 /**
@@ -151,127 +571,468 @@ static void removeLink(struct LinkedList* list, struct Link* link)
  */
 struct LinkedList* linkedListCreate()
 {
-	struct LinkedList* list = malloc(sizeof(struct LinkedList));
+	struct LinkedList* list = tallyMalloc(sizeof(struct LinkedList));
+	list->arena = 0;
+	list->ownsArena = 0;
+	list->filter = 0;
+	list->peak = 0;
+	list->trimPeak = 0;
+	list->pinned = 0;
+	list->compactRatio = 0;
 	init(list);
+	traceOp(TRACE_CREATE, list, 0, 0);
 	return list;
 }
 
 /**
-	Deallocates every link in the list including the sentinels,
-	and frees the list itself.
-	param:	list 	struct LinkedList ptr
-	pre: 	list is not null
-	post: 	memory allocated to each link is freed
-			" " front and back sentinel " "
-			" " list " "
+	Allocates and initializes a list whose links all come from the given
+	arena, so that destroying or clearing it is O(number of chunks)
+	instead of a free per link. The arena serves one list at a time and
+	is ready for the next list once this one is destroyed.
+	param:	arena	struct LinkedListArena ptr
+	pre: 	arena is not null
+	pre:	arena is not in use by another list
+	post: 	memory allocated for new struct LinkedList ptr
+			list init (call to init func)
+			arena is owned by list
+	return: list
  */
-void linkedListDestroy(struct LinkedList* list)
+struct LinkedList* linkedListCreateInArena(struct LinkedListArena* arena)
 {
-	assert(list != NULL);
-	while (!linkedListIsEmpty(list)) {
-		linkedListRemoveFront(list);
-	}
-	free(list->frontSentinel);
-	free(list->backSentinel);
-	free(list);
-	list = NULL;
+	assert(arena != 0);
+	assert(arena->owner == 0);
+	struct LinkedList* list = linkedListCreate();
+	list->arena = arena;
+	arena->owner = list;
+	return list;
 }
 
 /**
-	Adds a new link with the given value to the front of the deque.
-	param: 	deque 	struct LinkedList ptr
-	param: 	value 	TYPE
-	pre: 	deque is not null
-	post: 	link is created w/ param value stored before current first link
-			(call to adLinkBefore)
+	Allocates an arena for list links along with its first chunk.
+	param:	chunkLinks	number of links in the first chunk; each later
+						chunk is twice the size of the one before, up
+						to ARENA_MAX_CHUNK_SLOTS links
+	pre: 	chunkLinks > 0
+	post: 	memory allocated for arena and one chunk of chunkLinks links
+	return: arena
  */
-void linkedListAddFront(struct LinkedList* deque, TYPE value)
+struct LinkedListArena* linkedListArenaCreate(size_t chunkLinks)
 {
-	/* FIXME: You will write this function */
-	// From worksheet 19
-	// void LinkedListAddFront (struct linkedList *q, TYPE e)
-
-	assert(deque != 0);
-
-	adLinkBefore(deque, deque->frontSentinel->next, value);
+	assert(chunkLinks > 0);
+	struct LinkedListArena* arena = tallyMalloc(sizeof(struct LinkedListArena));
+	arenaInit(&arena->links, sizeof(struct Link), chunkLinks);
+	arena->owner = 0;
+	return arena;
 }
 
 /**
-	Adds a new link with the given value to the back of the deque.
-	param: 	deque 	struct LinkedList ptr
-	param: 	value 	TYPE
-	pre: 	deque is not null
-	post: 	link is created with given value before current last link
-			(call to adLinkBefore)
+	Frees every chunk of the arena and the arena itself.
+	param:	arena	struct LinkedListArena ptr
+	pre: 	arena is not null
+	pre:	arena is not in use by a list
+	post: 	memory allocated to each chunk and the arena is freed
  */
-void linkedListAddBack(struct LinkedList* deque, TYPE value)
+void linkedListArenaDestroy(struct LinkedListArena* arena)
 {
-	/* FIXME: You will write this function */
-	// From worksheet 19
-	// void LinkedListAddback (struct linkedList *q, TYPE e)
-	assert(deque != 0);
-
-  adLinkBefore(deque, deque->backSentinel, value);
+	assert(arena != 0);
+	assert(arena->owner == 0);
+	arenaFinish(&arena->links);
+	tallyFree(arena, sizeof(struct LinkedListArena));
 }
 
 /**
-	Returns the value of the link at the front of the deque.
-	param: 	deque 	struct LinkedList ptr
-	pre:	deque is not null
-	pre:	deque is not empty
-	post:	none
-	ret:	first link's value
+	Removes every link from the list, leaving it empty but usable.
+	An arena list just rewinds its arena, which is O(number of chunks);
+	otherwise every link is freed.
+	param:	list 	struct LinkedList ptr
+	pre: 	list is not null
+	post: 	list is empty
  */
-TYPE linkedListFront(struct LinkedList* deque)
+void linkedListClear(struct LinkedList* list)
 {
-	/* FIXME: You will write this function */
-	// From worksheet 19
-	// TYPE LinkedListFront (struct linkedList *q) {
-
-	assert(deque != 0);
-
-	assert(!linkedListIsEmpty(deque));
-	return deque->frontSentinel->next->value;
-
+	assert(list != NULL);
+	traceOp(TRACE_CLEAR, list, 0, list->size);
+	if (list->arena == 0)
+	{
+		while (!linkedListIsEmpty(list)) {
+			linkedListRemoveFront(list);
+		}
+		compact(list);
+		list->pinned = 0;
+		return;
+	}
+	list->pinned = 0;
+	arenaReset(&list->arena->links);
+	smallReset(list);
+	if (list->filter != 0)
+	{
+		for (size_t i = 0; i < list->filter->slots; i++)
+		{
+			list->filter->counters[i] = 0;
+		}
+	}
+	tallyElements(-(ptrdiff_t)list->size, sizeof(TYPE));
+	list->frontSentinel->next = list->backSentinel;
+	list->backSentinel->prev = list->frontSentinel;
+	list->size = 0;
+	list->tombstones = 0;
+	list->graveyard = 0;
+	list->buried = 0;
+	if (list->trimPeak != 0 && list->peak >= list->trimPeak)
+	{
+		linkedListTrim(list);
+	}
 }
 
 /**
-	Returns the value of the link at the back of the deque.
-	param: 	deque 	struct LinkedList ptr
-	pre:	deque is not null
-	pre:	deque is not empty
-	post:	none
-	ret:	last link's value
+	Puts count values into one block of links at the start of the list's
+	arena, wired up in one pass as the values are copied in, either from
+	an array or from a chain of links, and makes them the list's links.
+	The list's size and the tally are left alone.
+	param:	list	struct LinkedList ptr
+	param:	count	size_t
+	param:	values	array of count values, or NULL to copy from
+	param:	from	first link of a chain holding at least count live
+					values (tombstones are skipped), used if values is
+					NULL
+	pre:	list is not null and nothing has been allocated from its arena
+	pre:	values or from is not null if count > 0
+	post:	list's links are the block, in the same order as the values
  */
-TYPE linkedListBack(struct LinkedList* deque)
+static void wireBlock(struct LinkedList* list, size_t count, const TYPE* values, struct Link* from)
 {
-	/* FIXME: You will write this function */
-	// From worksheet 19
-	// TYPE LinkedListBack (struct linkedList *q) {
-
-	assert(deque != 0);
-
-	assert(!linkedListIsEmpty(deque));
-	return deque->backSentinel->prev->value;
+	struct Link* links = arenaBlock(&list->arena->links, count);
+	struct Link* prev = list->frontSentinel;
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (values != NULL)
+		{
+			links[i].value = values[i];
+		}
+		else
+		{
+			while (from->dead)
+			{
+				from = from->next;
+			}
+			links[i].value = from->value;
+			from = from->next;
+		}
+		links[i].dead = 0;
+		links[i].prev = prev;
+		prev->next = &links[i];
+		prev = &links[i];
+	}
+	prev->next = list->backSentinel;
+	list->backSentinel->prev = prev;
 }
 
 /**
-	Removes the link at the front of the deque.
-	param: 	deque 	struct LinkedList ptr
-	pre:	deque is not null
-	pre:	deque is not empty
-	post:	first link is removed and freed (call to removeLink)
+	Makes a list of count values whose links are one block (the first
+	chunk of an arena the list owns), copied from an array or from a
+	chain of links (see wireBlock).
+	param:	count	size_t
+	param:	values	array of count values, or NULL to copy from
+	param:	from	first link of a chain holding at least count live
+					values, used if values is NULL
+	pre: 	values or from is not null if count > 0
+	post: 	memory allocated for the list, its sentinels and its links
+	ret:	list with the values in the same order
  */
-void linkedListRemoveFront(struct LinkedList* deque)
+static struct LinkedList* blockList(size_t count, const TYPE* values, struct Link* from)
 {
-	/* FIXME: You will write this function */
-	// From worksheet 19
-	// void linkedListRemoveFront (struct linkedList *q) {
-
-	assert(deque != 0);
-
-	assert(!linkedListIsEmpty(deque));
-	removeLink(deque, deque->frontSentinel->next);
+	struct LinkedList* list = linkedListCreateInArena(linkedListArenaCreate(count > 0 ? count : 1));
+	list->ownsArena = 1;
+	wireBlock(list, count, values, from);
+	list->size = count;
+	tallyElements((ptrdiff_t)count, sizeof(TYPE));
+	return list;
+}
+
+/**
+	Returns memory the list no longer needs after it has shrunk. An arena
+	list has its links packed, in order, into the first links of its
+	arena (the embedded small links, then the first chunks), and the
+	pages of the chunk space left over are handed back to the OS with
+	madvise(MADV_DONTNEED). The chunks themselves are kept, so the next
+	burst reuses them without calling malloc. A list whose links come
+	from malloc has its values copied into one block of links in a new
+	arena, which the list owns and takes its links from from then on;
+	the old links are freed and the allocator is asked to release what
+	it can with malloc_trim. O(n) plus the number of chunks; links move,
+	so pointers to them are no longer valid. A list that has handed out
+	handles (see linkedListAddHandle) is not packed, so they stay valid;
+	only the pages past its last chunk's used links are handed back (for
+	a malloc list, whatever malloc_trim finds).
+	param:	list 	struct LinkedList ptr
+	pre: 	list is not null
+	post: 	list has the same values in the same order
+			list peak is its current size
+ */
+void linkedListTrim(struct LinkedList* list)
+{
+	assert(list != NULL);
+	traceOp(TRACE_TRIM, list, 0, list->size);
+	compact(list);
+	list->peak = list->size;
+	if (list->arena == 0)
+	{
+		if (!list->pinned && list->size > 0)
+		{
+			struct Link* old = list->frontSentinel->next;
+			list->arena = linkedListArenaCreate(list->size);
+			list->arena->owner = list;
+			list->ownsArena = 1;
+			wireBlock(list, list->size, NULL, old);
+			for (size_t i = 0; i < list->size; ++i)
+			{
+				struct Link* next = old->next;
+				if (!isSmallLink(list, old))
+				{
+					tallyFree(old, sizeof(struct Link));
+				}
+				old = next;
+			}
+			smallReset(list);
+		}
+		malloc_trim(0);
+		return;
+	}
+	if (!list->pinned)
+	{
+		TYPE* values = malloc((list->size > 0 ? list->size : 1) * sizeof(TYPE));
+		assert(values != 0);
+		linkedListToArray(list, values);
+		arenaReset(&list->arena->links);
+		smallReset(list);
+		struct Link* prev = list->frontSentinel;
+		for (size_t i = 0; i < list->size; ++i)
+		{
+			struct Link* link = allocLink(list);
+			link->value = values[i];
+			link->dead = 0;
+			link->prev = prev;
+			prev->next = link;
+			prev = link;
+		}
+		prev->next = list->backSentinel;
+		list->backSentinel->prev = prev;
+		free(values);
+	}
+
+	arenaRelease(&list->arena->links);
+}
+
+/**
+	Turns the high-watermark trim policy on or off. With it on, once the
+	list has held at least minPeak values, it is trimmed (see
+	linkedListTrim) whenever a remove takes it below 1 / TRIM_RATIO of the
+	largest size it has reached since it was last trimmed. Each trim costs
+	O(n), but runs only after the list has lost most of its values, so
+	this adds O(1) amortized per remove.
+	param:	list 	struct LinkedList ptr
+	param:	minPeak	size_t, 0 to turn the policy off
+	pre: 	list is not null
+	post: 	list trims itself when it falls well below its peak
+ */
+void linkedListAutoTrim(struct LinkedList* list, size_t minPeak)
+{
+	assert(list != NULL);
+	list->trimPeak = minPeak;
+}
+
+/**
+	Deallocates every link in the list, and frees the list itself
+	(which holds the sentinels and small links).
+	param:	list 	struct LinkedList ptr
+	pre: 	list is not null
+	post: 	memory allocated to each link is freed
+			(or handed back to the list's arena)
+			" " list " "
+			" " list's arena if it was made by linkedListClone
+ */
+void linkedListDestroy(struct LinkedList* list)
+{
+	assert(list != NULL);
+	traceOp(TRACE_DESTROY, list, 0, list->size);
+	linkedListClear(list);
+	if (list->arena != 0)
+	{
+		list->arena->owner = 0;
+		if (list->ownsArena)
+		{
+			linkedListArenaDestroy(list->arena);
+		}
+	}
+	if (list->filter != 0)
+	{
+		filterDestroy(list->filter);
+	}
+	tallyFree(list, sizeof(struct LinkedList));
+	list = NULL;
+}
+
+/**
+	Makes a copy of the list. All of the copy's links are allocated as a
+	single block, laid out in front to back order, and the pointers are
+	set up in one pass over the original, so the copy costs two
+	allocations besides its sentinels rather than one per link. The
+	block is the first chunk of an arena the copy owns; links added to
+	the copy later come from the same arena.
+	param:	list 	struct LinkedList ptr
+	pre: 	list is not null
+	post: 	memory allocated for the copy, its sentinels and its links
+	ret:	copy of list with the same values in the same order
+ */
+struct LinkedList* linkedListClone(struct LinkedList* list)
+{
+	assert(list != NULL);
+	return blockList(list->size, NULL, list->frontSentinel->next);
+}
+
+/**
+	Copies the values of the list, front to back, into an array in one
+	pass over the links.
+	param:	list	struct LinkedList ptr
+	param:	values	array with room for the list's size values
+	pre: 	list and values are not null
+	post: 	values holds the list's values; the list is unchanged
+	ret:	number of values copied (the list's size)
+ */
+size_t linkedListToArray(struct LinkedList* list, TYPE* values)
+{
+	assert(list != NULL && values != NULL);
+	struct Link* current = list->frontSentinel->next;
+	for (size_t i = 0; i < list->size; ++i)
+	{
+		while (current->dead)
+		{
+			current = current->next;
+		}
+		values[i] = current->value;
+		current = current->next;
+	}
+	return list->size;
+}
+
+/**
+	Makes a list holding the values of an array, front to back. As with
+	linkedListClone, the links are one block (the first chunk of an
+	arena the list owns), set up in one pass over the array.
+	param:	values	array of count values
+	param:	count	size_t
+	pre: 	values is not null if count > 0
+	post: 	memory allocated for the list, its sentinels and its links
+	ret:	list with the array's values in the same order
+ */
+struct LinkedList* linkedListFromArray(const TYPE* values, size_t count)
+{
+	assert(values != NULL || count == 0);
+	return blockList(count, values, NULL);
+}
+
+/**
+	Adds a new link with the given value to the front of the deque.
+	param: 	deque 	struct LinkedList ptr
+	param: 	value 	TYPE
+	pre: 	deque is not null
+	post: 	link is created w/ param value stored before current first link
+			(call to adLinkBefore)
+ */
+void linkedListAddFront(struct LinkedList* deque, TYPE value)
+{
+	/* FIXME: You will write this function */
+	// From worksheet 19
+	// void LinkedListAddFront (struct linkedList *q, TYPE e)
+
+	assert(deque != 0);
+	traceOp(TRACE_ADD_FRONT, deque, HASH(value), deque->size);
+
+	adLinkBefore(deque, deque->frontSentinel->next, value);
+}
+
+/**
+	Adds a new link with the given value to the back of the deque.
+	param: 	deque 	struct LinkedList ptr
+	param: 	value 	TYPE
+	pre: 	deque is not null
+	post: 	link is created with given value before current last link
+			(call to adLinkBefore)
+ */
+void linkedListAddBack(struct LinkedList* deque, TYPE value)
+{
+	/* FIXME: You will write this function */
+	// From worksheet 19
+	// void LinkedListAddback (struct linkedList *q, TYPE e)
+	assert(deque != 0);
+	traceOp(TRACE_ADD_BACK, deque, HASH(value), deque->size);
+
+  adLinkBefore(deque, deque->backSentinel, value);
+}
+
+#ifndef LINKED_LIST_INLINE
+
+/**
+	Returns the value of the link at the front of the deque.
+	param: 	deque 	struct LinkedList ptr
+	pre:	deque is not null
+	pre:	deque is not empty
+	post:	none
+	ret:	first link's value
+ */
+TYPE linkedListFront(struct LinkedList* deque)
+{
+	/* FIXME: You will write this function */
+	// From worksheet 19
+	// TYPE LinkedListFront (struct linkedList *q) {
+
+	LINKED_LIST_CHECK(deque != 0);
+
+	LINKED_LIST_CHECK(!linkedListIsEmpty(deque));
+	return deque->frontSentinel->next->value;
+
+}
+
+/**
+	Returns the value of the link at the back of the deque.
+	param: 	deque 	struct LinkedList ptr
+	pre:	deque is not null
+	pre:	deque is not empty
+	post:	none
+	ret:	last link's value
+ */
+TYPE linkedListBack(struct LinkedList* deque)
+{
+	/* FIXME: You will write this function */
+	// From worksheet 19
+	// TYPE LinkedListBack (struct linkedList *q) {
+
+	LINKED_LIST_CHECK(deque != 0);
+
+	LINKED_LIST_CHECK(!linkedListIsEmpty(deque));
+	return deque->backSentinel->prev->value;
+}
+
+#endif
+
+/**
+	Removes the link at the front of the deque.
+	param: 	deque 	struct LinkedList ptr
+	pre:	deque is not null
+	pre:	deque is not empty
+	post:	first link is removed and freed (call to removeLink)
+ */
+void linkedListRemoveFront(struct LinkedList* deque)
+{
+	/* FIXME: You will write this function */
+	// From worksheet 19
+	// void linkedListRemoveFront (struct linkedList *q) {
+
+	assert(deque != 0);
+
+	assert(!linkedListIsEmpty(deque));
+	traceOp(TRACE_REMOVE_FRONT, deque, HASH(deque->frontSentinel->next->value), deque->size);
+	removeLink(deque, deque->frontSentinel->next);
 }
 
 /**
@@ -290,9 +1051,12 @@ void linkedListRemoveBack(struct LinkedList* deque)
 	assert(deque != 0);
 
 	assert(!linkedListIsEmpty(deque));
+	traceOp(TRACE_REMOVE_BACK, deque, HASH(deque->backSentinel->prev->value), deque->size);
 	removeLink(deque, deque->backSentinel->prev);
 }
 
+#ifndef LINKED_LIST_INLINE
+
 /**
 	Returns 1 if the deque is empty and 0 otherwise.
 	param:	deque	struct LinkedList ptr
@@ -305,11 +1069,13 @@ int linkedListIsEmpty(struct LinkedList* deque)
 	/* FIXME: You will write this function */
 	// From worksheet 19
 	// int LinkedListIsEmpty (struct linkedList *q) {
-	assert(deque != 0);
+	LINKED_LIST_CHECK(deque != 0);
 
 	return deque->size == 0;
 }
 
+#endif
+
 /**
 	Prints the values of the links in the deque from front to back.
 	param:	deque	struct LinkedList ptr
@@ -333,8 +1099,10 @@ void linkedListPrint(struct LinkedList* deque)
 
 
 //temp is temporary link variable
-	for(int i = 0; i < deque->size; ++i)
+	for(size_t i = 0; i < deque->size; ++i)
 	{
+	 while (temp->dead)
+	 	temp = temp->next;
 	 printf(FORMAT_SPECIFIER"\n", temp->value);
 	 temp = temp->next;
  	}
@@ -362,6 +1130,7 @@ void linkedListAdd(struct LinkedList* bag, TYPE value)
 	// From worksheet 22
 	// void linkedListAdd (struct linkedList * lst, TYPE e)
 	assert(bag !=0);
+	traceOp(TRACE_ADD, bag, HASH(value), bag->size);
   adLinkBefore(bag, bag->frontSentinel->next, value);
 
 }
@@ -381,10 +1150,14 @@ int linkedListContains(struct LinkedList* bag, TYPE value)
 	// From worksheet 22
 	//int linkedListContains (struct linkedList *lst, TYPE e)
 assert(bag !=0);
+	traceOp(TRACE_CONTAINS, bag, HASH(value), bag->size);
+	// the filter has no false negatives, so a miss there is a miss
+	if (bag->filter != 0 && !filterUpdate(bag->filter, value, 0))
+		return 0;
 
 	struct Link *current = bag->frontSentinel->next;
 
-	while (current != bag->backSentinel)
+	while ((current = skipDead(current)) != bag->backSentinel)
 	{
 		if(EQ(current->value,value))
 	      return 1;
@@ -409,16 +1182,947 @@ void linkedListRemove(struct LinkedList* bag, TYPE value)
 	// void linkedListRemove (struct linkedList *lst, TYPE e) {
 
 	assert(bag !=0);
+	traceOp(TRACE_REMOVE, bag, HASH(value), bag->size);
 
  	struct Link *current = bag->frontSentinel->next;
 
-		while(current != bag->backSentinel)
+		while((current = skipDead(current)) != bag->backSentinel)
 		{
 			if(EQ(current->value,value))
 			{
+					if (bag->compactRatio > 0 && current->prev != bag->frontSentinel
+						&& current->next != bag->backSentinel)
+					{
+						markDead(bag, current);
+						return;
+					}
 					removeLink(bag, current);
+					return;
   		}
 
   		current = current->next;
 		}
 }
+
+/**
+	Gives the bag a counting Bloom filter, so that Contains can answer
+	most misses without walking the list. The filter is kept up to date
+	by every add and remove (deque ones too) and is rebuilt at twice the
+	size once the bag holds more than twice the expected number of
+	values. Calling this again resizes the filter. Values that are EQ
+	must have the same HASH.
+	param:	bag					struct LinkedList ptr
+	param:	expected			number of values the bag is expected to hold
+	param:	falsePositiveRate	chance a miss still walks the list,
+								between 0 and 1
+	pre:	bag is not null
+	pre:	0 < falsePositiveRate < 1
+	post:	bag has a filter holding every value in it
+ */
+void linkedListEnableFilter(struct LinkedList* bag, size_t expected, double falsePositiveRate)
+{
+	assert(bag != 0);
+	if (bag->filter != 0)
+	{
+		filterDestroy(bag->filter);
+	}
+	bag->filter = filterCreate(expected, falsePositiveRate);
+	for (struct Link* link = bag->frontSentinel->next; link != bag->backSentinel; link = link->next)
+	{
+		if (!link->dead)
+		{
+			filterUpdate(bag->filter, link->value, 1);
+		}
+	}
+}
+
+/**
+	Turns lazy delete mode on or off. With it on, linkedListRemove only
+	marks the link it finds as a tombstone, which Contains, Print, the
+	set ops and the rest skip (a removed first or last link is still
+	unlinked right away, so Front and Back never see one). Contains and
+	Remove only step over the tombstones they walk past and never change
+	the bag's links, so a Contains is a pure read. Links are not freed one
+	remove at a time: once tombstones are
+	more than compactRatio of the bag's links, they are all freed in one
+	pass, which is O(1)
+	amortized per remove and keeps a burst of removes from freeing
+	links that are still being pointed at. Turning it off compacts the
+	bag.
+	param:	bag				struct LinkedList ptr
+	param:	compactRatio	fraction of links that may be tombstones
+							before a compaction, 1 to compact only in
+							linkedListCompact, 0 to turn the mode off
+	pre:	bag is not null
+	pre:	0 <= compactRatio <= 1
+	post:	bag removes lazily if compactRatio > 0
+ */
+void linkedListLazyDelete(struct LinkedList* bag, double compactRatio)
+{
+	assert(bag != 0);
+	assert(compactRatio >= 0 && compactRatio <= 1);
+	bag->compactRatio = compactRatio;
+	if (compactRatio == 0)
+	{
+		compact(bag);
+	}
+}
+
+/**
+	Unlinks every tombstone left by lazy removes and recycles their
+	links, and those already unlinked from the ends, now, in one pass
+	over the bag. O(n + tombstones).
+	param:	bag		struct LinkedList ptr
+	pre:	bag is not null
+	post:	bag has no tombstones; its values are unchanged
+ */
+void linkedListCompact(struct LinkedList* bag)
+{
+	assert(bag != 0);
+	compact(bag);
+}
+
+// Multiplicity of one value of a bag (see countsCreate)
+struct BagCount
+{
+	TYPE value;
+	size_t count;
+	int used;
+};
+
+// Bag set operations, all done by setOp
+enum SetOp
+{
+	SET_UNION, SET_INTERSECTION, SET_DIFFERENCE
+};
+
+/**
+	Finds the slot for a value in a table made by countsCreate, by linear
+	probing from its hash: the slot holding it, or the empty slot where
+	it would go.
+	param:	counts	struct BagCount array
+	param:	mask	size_t, number of slots - 1
+	param:	value	TYPE
+	pre:	counts is not null and has an empty slot
+	post:	none
+	ret:	slot ptr
+ */
+static struct BagCount* countsFind(struct BagCount* counts, size_t mask, TYPE value)
+{
+	size_t i = mixHash(HASH(value)) & mask;
+	while (counts[i].used && !EQ(counts[i].value, value))
+	{
+		i = (i + 1) & mask;
+	}
+	return &counts[i];
+}
+
+/**
+	Counts how many times each value is in the bag, in an open addressing
+	hash table with at least twice as many slots as the bag has values.
+	param:	bag		struct LinkedList ptr
+	param:	mask	size_t ptr, set to the number of slots - 1
+	pre:	bag and mask are not null
+	post:	memory is allocated for the table; free it with free
+	ret:	table
+ */
+static struct BagCount* countsCreate(struct LinkedList* bag, size_t* mask)
+{
+	size_t slots = 2;
+	while (slots < 2 * bag->size)
+	{
+		slots *= 2;
+	}
+	struct BagCount* counts = calloc(slots, sizeof(struct BagCount));
+	assert(counts != 0);
+	*mask = slots - 1;
+	for (struct Link* link = bag->frontSentinel->next; link != bag->backSentinel; link = link->next)
+	{
+		if (link->dead)
+		{
+			continue;
+		}
+		struct BagCount* slot = countsFind(counts, *mask, link->value);
+		slot->value = link->value;
+		slot->used = 1;
+		slot->count++;
+	}
+	return counts;
+}
+
+/**
+	Does a set operation between two bags in O(n + m) expected time, with
+	a hash table counting the values of b. A value's count in the result
+	is the larger of its counts in a and b for a union, the smaller for
+	an intersection, and its count in a less its count in b (at least 0)
+	for a difference. Values from a come first, in a's order, followed
+	(for a union) by the values only b has enough of, in b's order.
+	When result is a, the values a loses are unlinked from it and its
+	remaining links are kept where they are; otherwise result gets a
+	copy of every value.
+	param:	a		struct LinkedList ptr
+	param:	b		struct LinkedList ptr
+	param:	op		enum SetOp
+	param:	result	struct LinkedList ptr, a or an empty list
+	pre:	a, b and result are not null
+	post:	result holds a op b; b is unchanged unless it is a
+ */
+static void setOp(struct LinkedList* a, struct LinkedList* b, enum SetOp op,
+	struct LinkedList* result)
+{
+	assert(a != 0 && b != 0 && result != 0);
+	size_t mask;
+	struct BagCount* counts = countsCreate(b, &mask);
+	struct Link* link = a->frontSentinel->next;
+	while (link != a->backSentinel)
+	{
+		struct Link* next = link->next;
+		if (link->dead)
+		{
+			link = next;
+			continue;
+		}
+		struct BagCount* slot = countsFind(counts, mask, link->value);
+		int inB = slot->count > 0;
+		if (inB)
+		{
+			slot->count--;
+		}
+		int keep = op == SET_UNION || inB == (op == SET_INTERSECTION);
+		if (result != a)
+		{
+			if (keep)
+			{
+				adLinkBefore(result, result->backSentinel, link->value);
+			}
+		}
+		else if (!keep)
+		{
+			// unlinked here rather than with removeLink, which could
+			// auto trim and move the links still to be visited
+			link->next->prev = link->prev;
+			link->prev->next = link->next;
+			if (a->filter != 0)
+			{
+				filterUpdate(a->filter, link->value, -1);
+			}
+			freeLink(a, link);
+			a->size--;
+			tallyElements(-1, sizeof(TYPE));
+		}
+		link = next;
+	}
+	if (op == SET_UNION)
+	{
+		for (link = b->frontSentinel->next; link != b->backSentinel; link = link->next)
+		{
+			struct BagCount* slot = countsFind(counts, mask, link->value);
+			if (!link->dead && slot->count > 0)
+			{
+				slot->count--;
+				adLinkBefore(result, result->backSentinel, link->value);
+			}
+		}
+	}
+	free(counts);
+	if (result->tombstones != 0)
+	{
+		dropDeadEnds(result);
+	}
+	if (result->trimPeak != 0 && result->peak >= result->trimPeak
+		&& result->size < result->peak / TRIM_RATIO)
+	{
+		linkedListTrim(result);
+	}
+}
+
+/**
+	Makes an empty list whose links come from a single block with room
+	for the given number of values (the first chunk of an arena the list
+	owns), for the result of a set operation.
+	param:	capacity	size_t, the most values the result can hold
+	pre:	none
+	post:	memory allocated for the list and its block of links
+	ret:	empty list
+ */
+static struct LinkedList* setResult(size_t capacity)
+{
+	struct LinkedList* result = linkedListCreateInArena(linkedListArenaCreate(capacity > 0 ? capacity : 1));
+	result->ownsArena = 1;
+	return result;
+}
+
+/**
+	Makes a new bag holding the union of two bags: each value as many
+	times as the bag that has more of it. O(n + m) expected; the result's
+	links are one block with room for n + m values (linkedListTrim hands
+	back the pages of what is left unused).
+	param:	a	struct LinkedList ptr
+	param:	b	struct LinkedList ptr
+	pre:	a and b are not null
+	post:	a and b are unchanged
+	ret:	new bag
+ */
+struct LinkedList* linkedListUnion(struct LinkedList* a, struct LinkedList* b)
+{
+	assert(a != 0 && b != 0);
+	struct LinkedList* result = setResult(a->size + b->size);
+	setOp(a, b, SET_UNION, result);
+	return result;
+}
+
+/**
+	Makes a new bag holding the intersection of two bags: each value as
+	many times as the bag that has fewer of it. O(n + m) expected; the
+	result's links are one block with room for the smaller bag.
+	param:	a	struct LinkedList ptr
+	param:	b	struct LinkedList ptr
+	pre:	a and b are not null
+	post:	a and b are unchanged
+	ret:	new bag
+ */
+struct LinkedList* linkedListIntersection(struct LinkedList* a, struct LinkedList* b)
+{
+	assert(a != 0 && b != 0);
+	struct LinkedList* result = setResult(a->size < b->size ? a->size : b->size);
+	setOp(a, b, SET_INTERSECTION, result);
+	return result;
+}
+
+/**
+	Makes a new bag holding the values of a that are not matched by one
+	in b (a value a has 3 of and b has 1 of is in it twice). O(n + m)
+	expected; the result's links are one block with room for a's values.
+	param:	a	struct LinkedList ptr
+	param:	b	struct LinkedList ptr
+	pre:	a and b are not null
+	post:	a and b are unchanged
+	ret:	new bag
+ */
+struct LinkedList* linkedListDifference(struct LinkedList* a, struct LinkedList* b)
+{
+	assert(a != 0 && b != 0);
+	struct LinkedList* result = setResult(a->size);
+	setOp(a, b, SET_DIFFERENCE, result);
+	return result;
+}
+
+/**
+	Turns the bag into its union with another, adding the values only
+	the other has enough of to its back. Its own links stay where they
+	are. O(n + m) expected.
+	param:	bag		struct LinkedList ptr
+	param:	other	struct LinkedList ptr
+	pre:	bag and other are not null
+	post:	bag holds the union; other is unchanged
+ */
+void linkedListUnionWith(struct LinkedList* bag, struct LinkedList* other)
+{
+	setOp(bag, other, SET_UNION, bag);
+}
+
+/**
+	Turns the bag into its intersection with another by unlinking the
+	values the other doesn't match. The links kept are not moved or
+	reallocated. O(n + m) expected.
+	param:	bag		struct LinkedList ptr
+	param:	other	struct LinkedList ptr
+	pre:	bag and other are not null
+	post:	bag holds the intersection; other is unchanged
+ */
+void linkedListIntersectWith(struct LinkedList* bag, struct LinkedList* other)
+{
+	setOp(bag, other, SET_INTERSECTION, bag);
+}
+
+/**
+	Removes from the bag one value for each EQ value in another. The
+	links kept are not moved or reallocated. O(n + m) expected.
+	param:	bag		struct LinkedList ptr
+	param:	other	struct LinkedList ptr
+	pre:	bag and other are not null
+	post:	bag holds its difference with other; other is unchanged
+			unless it is bag, which leaves it empty
+ */
+void linkedListSubtract(struct LinkedList* bag, struct LinkedList* other)
+{
+	setOp(bag, other, SET_DIFFERENCE, bag);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// HANDLES
+//
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+	A handle is the link a value was added in, so removing or moving it
+	is O(1) with no search. Once a list has handed out a handle, trim no
+	longer packs its links (see linkedListTrim), so a handle stays valid
+	until its value is removed (by handle, by value or from an end) or
+	the list is cleared or destroyed. Sorting relinks the links but
+	doesn't move them, so handles survive it.
+*/
+
+/**
+	Adds a link with the given value to the front of the deque, like
+	linkedListAddFront, and returns a handle to it.
+	param: 	deque 	struct LinkedList ptr
+	param: 	value 	TYPE
+	pre: 	deque is not null
+	post: 	link is created w/ param value stored before current first link
+	ret:	handle to the new link
+ */
+struct LinkedListHandle* linkedListAddFrontHandle(struct LinkedList* deque, TYPE value)
+{
+	linkedListAddFront(deque, value);
+	deque->pinned = 1;
+	return (struct LinkedListHandle*)deque->frontSentinel->next;
+}
+
+/**
+	Adds a link with the given value to the back of the deque, like
+	linkedListAddBack, and returns a handle to it.
+	param: 	deque 	struct LinkedList ptr
+	param: 	value 	TYPE
+	pre: 	deque is not null
+	post: 	link is created w/ param value stored after current last link
+	ret:	handle to the new link
+ */
+struct LinkedListHandle* linkedListAddBackHandle(struct LinkedList* deque, TYPE value)
+{
+	linkedListAddBack(deque, value);
+	deque->pinned = 1;
+	return (struct LinkedListHandle*)deque->backSentinel->prev;
+}
+
+/**
+	Adds a link with the given value to the bag, like linkedListAdd, and
+	returns a handle to it.
+	param:	bag		struct LinkedList ptr
+	param: 	value 	TYPE
+	pre: 	bag is not null
+	post: 	link is created w/ given value
+	ret:	handle to the new link
+ */
+struct LinkedListHandle* linkedListAddHandle(struct LinkedList* bag, TYPE value)
+{
+	linkedListAdd(bag, value);
+	bag->pinned = 1;
+	return (struct LinkedListHandle*)bag->frontSentinel->next;
+}
+
+/**
+	Returns the value of the link a handle refers to.
+	param:	handle	struct LinkedListHandle ptr
+	pre:	handle is a valid handle
+	post:	none
+	ret:	the link's value
+ */
+TYPE linkedListHandleValue(struct LinkedListHandle* handle)
+{
+	assert(handle != 0);
+	return ((struct Link*)handle)->value;
+}
+
+/**
+	Removes the link a handle refers to in O(1) (call to removeLink).
+	param:	list	struct LinkedList ptr
+	param:	handle	struct LinkedListHandle ptr
+	pre:	list is not null
+	pre:	handle is a valid handle from list
+	post:	link is removed and freed; handle may no longer be used
+ */
+void linkedListRemoveHandle(struct LinkedList* list, struct LinkedListHandle* handle)
+{
+	assert(list != 0 && handle != 0);
+	struct Link* link = (struct Link*)handle;
+	assert(link != list->frontSentinel && link != list->backSentinel && !link->dead);
+	traceOp(TRACE_REMOVE, list, HASH(link->value), list->size);
+	removeLink(list, link);
+}
+
+/**
+	Moves the link a handle refers to to the front of the list in O(1),
+	e.g. to mark an entry of an LRU cache as just used. The link itself
+	is relinked, so the handle stays valid.
+	param:	list	struct LinkedList ptr
+	param:	handle	struct LinkedListHandle ptr
+	pre:	list is not null
+	pre:	handle is a valid handle from list
+	post:	link is first in the list
+ */
+void linkedListMoveToFront(struct LinkedList* list, struct LinkedListHandle* handle)
+{
+	assert(list != 0 && handle != 0);
+	struct Link* link = (struct Link*)handle;
+	assert(link != list->frontSentinel && link != list->backSentinel && !link->dead);
+	link->next->prev = link->prev;
+	link->prev->next = link->next;
+	link->prev = list->frontSentinel;
+	link->next = list->frontSentinel->next;
+	link->next->prev = link;
+	list->frontSentinel->next = link;
+	if (list->tombstones != 0)
+	{
+		dropDeadEnds(list);
+	}
+}
+
+/**
+	Moves the link a handle refers to to the back of the list in O(1).
+	The link itself is relinked, so the handle stays valid.
+	param:	list	struct LinkedList ptr
+	param:	handle	struct LinkedListHandle ptr
+	pre:	list is not null
+	pre:	handle is a valid handle from list
+	post:	link is last in the list
+ */
+void linkedListMoveToBack(struct LinkedList* list, struct LinkedListHandle* handle)
+{
+	assert(list != 0 && handle != 0);
+	struct Link* link = (struct Link*)handle;
+	assert(link != list->frontSentinel && link != list->backSentinel && !link->dead);
+	link->next->prev = link->prev;
+	link->prev->next = link->next;
+	link->next = list->backSentinel;
+	link->prev = list->backSentinel->prev;
+	link->prev->next = link;
+	list->backSentinel->prev = link;
+	if (list->tombstones != 0)
+	{
+		dropDeadEnds(list);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// SORTING
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// One piece of a list being sorted by its own thread
+struct SortTask
+{
+	struct Link* chain;
+	pthread_t thread;
+	int started;
+};
+
+/**
+	Merges two sorted chains (linked through next, ending in null) into
+	one. Ties are taken from the first chain, which keeps the merge stable.
+	param:	a	struct Link ptr, the earlier chain
+	param:	b	struct Link ptr, the later chain
+	pre:	a and b are sorted by LT
+	post:	next pointers are relinked; prev pointers are not touched
+	ret:	head of the merged chain
+ */
+static struct Link* mergeChains(struct Link* a, struct Link* b)
+{
+	struct Link* head = 0;
+	struct Link** tail = &head;
+	while (a != 0 && b != 0)
+	{
+		if (LT(b->value, a->value))
+		{
+			*tail = b;
+			b = b->next;
+		}
+		else
+		{
+			*tail = a;
+			a = a->next;
+		}
+		tail = &(*tail)->next;
+	}
+	*tail = a != 0 ? a : b;
+	return head;
+}
+
+/**
+	Sorts a chain (linked through next, ending in null) with a bottom-up
+	merge sort. bins[i] holds a sorted run of 2^i links, so no memory is
+	allocated and runs are always merged older-first, keeping it stable.
+	param:	chain	struct Link ptr
+	pre:	none
+	post:	next pointers are relinked; prev pointers are not touched
+	ret:	head of the sorted chain
+ */
+static struct Link* sortChain(struct Link* chain)
+{
+	struct Link* bins[64] = { 0 };
+	int i;
+	while (chain != 0)
+	{
+		struct Link* carry = chain;
+		chain = chain->next;
+		carry->next = 0;
+		for (i = 0; i < 63 && bins[i] != 0; ++i)
+		{
+			carry = mergeChains(bins[i], carry);
+			bins[i] = 0;
+		}
+		bins[i] = mergeChains(bins[i], carry);
+	}
+	struct Link* sorted = 0;
+	for (i = 0; i < 64; ++i)
+	{
+		sorted = mergeChains(bins[i], sorted);
+	}
+	return sorted;
+}
+
+/**
+	Thread entry point that sorts one task's chain.
+	param:	arg		struct SortTask ptr
+	pre:	arg is not null
+	post:	task chain is sorted
+	ret:	null
+ */
+static void* sortTask(void* arg)
+{
+	struct SortTask* task = arg;
+	task->chain = sortChain(task->chain);
+	return 0;
+}
+
+/**
+	Attaches a chain (linked through next, ending in null) between the
+	list's sentinels and restores the prev pointers along it.
+	param:	list	struct LinkedList ptr
+	param:	chain	struct Link ptr to attach
+	pre:	list is not null
+	post:	list links are chain, front to back, with prev pointers set
+ */
+static void attachChain(struct LinkedList* list, struct Link* chain)
+{
+	struct Link* prev = list->frontSentinel;
+	while (chain != 0)
+	{
+		prev->next = chain;
+		chain->prev = prev;
+		prev = chain;
+		chain = chain->next;
+	}
+	prev->next = list->backSentinel;
+	list->backSentinel->prev = prev;
+}
+
+/**
+	Sorts the list in place by LT with a stable bottom-up merge sort that
+	relinks the existing links, so no memory is allocated. O(n log n).
+	param:	list	struct LinkedList ptr
+	pre:	list is not null
+	post:	list values are in non-decreasing order by LT; equal values
+			keep their original order
+ */
+void linkedListSort(struct LinkedList* list)
+{
+	linkedListSortParallel(list, 1);
+}
+
+/**
+	Sorts the list like linkedListSort, but splits it into one piece per
+	thread, sorts the pieces at the same time and then merges them in
+	order. If a thread can't be started its piece is sorted by the
+	calling thread instead.
+	param:	list	struct LinkedList ptr
+	param:	threads	number of threads to sort with (at most SORT_MAX_THREADS)
+	pre:	list is not null
+	pre:	threads >= 1
+	post:	list values are in non-decreasing order by LT; equal values
+			keep their original order
+ */
+void linkedListSortParallel(struct LinkedList* list, int threads)
+{
+	assert(list != 0);
+	assert(threads >= 1);
+	traceOp(TRACE_SORT, list, 0, list->size);
+	compact(list);
+	if (list->size < 2)
+	{
+		return;
+	}
+	if (threads > SORT_MAX_THREADS)
+	{
+		threads = SORT_MAX_THREADS;
+	}
+	if ((size_t)threads > list->size)
+	{
+		threads = (int)list->size;
+	}
+	list->backSentinel->prev->next = 0;
+	struct Link* chain = list->frontSentinel->next;
+	if (threads == 1)
+	{
+		attachChain(list, sortChain(chain));
+		return;
+	}
+
+	// cut the chain into pieces of about size / threads links each
+	struct SortTask tasks[SORT_MAX_THREADS];
+	int i;
+	for (i = 0; i < threads; ++i)
+	{
+		size_t count = list->size / threads + ((size_t)i < list->size % threads);
+		tasks[i].chain = chain;
+		for (size_t j = 1; j < count; ++j)
+		{
+			chain = chain->next;
+		}
+		struct Link* next = chain->next;
+		chain->next = 0;
+		chain = next;
+		tasks[i].started = i > 0
+			&& pthread_create(&tasks[i].thread, 0, sortTask, &tasks[i]) == 0;
+	}
+	for (i = 0; i < threads; ++i)
+	{
+		if (tasks[i].started)
+		{
+			pthread_join(tasks[i].thread, 0);
+		}
+		else
+		{
+			sortTask(&tasks[i]);
+		}
+	}
+	// merge neighbouring pieces in rounds, earlier piece first
+	for (int width = 1; width < threads; width *= 2)
+	{
+		for (i = 0; i + width < threads; i += 2 * width)
+		{
+			tasks[i].chain = mergeChains(tasks[i].chain, tasks[i + width].chain);
+		}
+	}
+	attachChain(list, tasks[0].chain);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// SNAPSHOTS
+//
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+	Snapshot format: see dequeCommon.h. Only how a value of this build's
+	TYPE is encoded lives here.
+*/
+
+#define SNAPSHOT_INTEGER ((TYPE)0.5 == 0)
+#define SNAPSHOT_KIND (SNAPSHOT_INTEGER ? 'i' : 'f')
+
+/**
+	Writes a value: the zigzag varint of its difference from the previous
+	value for integer TYPEs, its raw little-endian bytes otherwise.
+	param:	stream	struct SnapshotStream ptr
+	param:	value	TYPE
+	param:	prev	TYPE ptr to the previous value, set to value
+	pre:	stream and prev are not null
+	post:	value is written
+ */
+static void snapshotPutValue(struct SnapshotStream* stream, TYPE value, TYPE* prev)
+{
+	if (SNAPSHOT_INTEGER)
+	{
+		snapshotPutDelta(stream, (int64_t)value - (int64_t)*prev);
+		*prev = value;
+		return;
+	}
+	snapshotPutBytes(stream, &value, sizeof(TYPE));
+}
+
+/**
+	Reads a value written by snapshotPutValue.
+	param:	stream	struct SnapshotStream ptr
+	param:	prev	TYPE ptr to the previous value, set to the value read
+	pre:	stream and prev are not null
+	post:	failed is set if the value is cut off
+	ret:	value
+ */
+static TYPE snapshotGetValue(struct SnapshotStream* stream, TYPE* prev)
+{
+	if (SNAPSHOT_INTEGER)
+	{
+		*prev = (TYPE)((int64_t)*prev + snapshotGetDelta(stream));
+		return *prev;
+	}
+	TYPE value;
+	snapshotGetBytes(stream, &value, sizeof(TYPE));
+	return value;
+}
+
+/**
+	Writes the list's values, front to back, as a binary snapshot.
+	param:	list	struct LinkedList ptr
+	param:	out		FILE ptr open for writing
+	pre:	list and out are not null
+	post:	snapshot is written to out; the list is unchanged
+	ret:	0 on success, -1 if writing failed
+ */
+int linkedListWriteSnapshot(struct LinkedList* list, FILE* out)
+{
+	assert(list != NULL && out != NULL);
+	struct SnapshotStream stream = { out, 0, 0 };
+	snapshotPutHeader(&stream, SNAPSHOT_KIND, sizeof(TYPE), list->size);
+	TYPE prev = 0;
+	for (struct Link* link = list->frontSentinel->next; link != list->backSentinel; link = link->next)
+	{
+		if (!link->dead)
+		{
+			snapshotPutValue(&stream, link->value, &prev);
+		}
+	}
+	return snapshotPutTrailer(&stream);
+}
+
+/**
+	Makes a list from a snapshot written by linkedListWriteSnapshot. The
+	links come from an arena the list owns, sized from the snapshot's
+	count (a first chunk of at most 65536 links).
+	param:	in		FILE ptr open for reading
+	pre:	in is not null
+	post:	the snapshot is consumed from in
+	ret:	list with the snapshot's values, or null if the snapshot is
+			cut off, corrupt or for another TYPE
+ */
+struct LinkedList* linkedListReadSnapshot(FILE* in)
+{
+	assert(in != NULL);
+	struct SnapshotStream stream = { in, 0, 0 };
+	size_t count = snapshotGetHeader(&stream, SNAPSHOT_KIND, sizeof(TYPE));
+	if (stream.failed)
+	{
+		return NULL;
+	}
+	size_t chunkLinks = count == 0 ? 1 : count < 65536 ? count : 65536;
+	struct LinkedList* list = linkedListCreateInArena(linkedListArenaCreate(chunkLinks));
+	list->ownsArena = 1;
+	TYPE prev = 0;
+	for (size_t i = 0; i < count && !stream.failed; i++)
+	{
+		TYPE value = snapshotGetValue(&stream, &prev);
+		adLinkBefore(list, list->backSentinel, value);
+	}
+	if (snapshotGetTrailer(&stream) != 0)
+	{
+		linkedListDestroy(list);
+		return NULL;
+	}
+	return list;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// TRACING
+//
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+	Turns op tracing on or off. With it on, every thread that works on a
+	list records each op (its code, a hash of its value, the list's
+	size and a time stamp) in a ring of its own holding its most recent
+	events, to be written out with linkedListTraceDump. A thread gets its
+	ring the first time it traces, sized by the latest call to this;
+	turning tracing off keeps the rings, so they can still be dumped.
+	param:	events	events each thread keeps (rounded up to a power of
+					two), 0 to turn tracing off
+	pre:	none
+	post:	ops are traced if events > 0
+ */
+void linkedListTraceEnable(size_t events)
+{
+	traceEnable(&trace, events);
+}
+
+/**
+	Writes the trace rings of every thread that has traced list
+	ops. Threads may keep tracing while this runs: each ring is copied
+	and any events that were overwritten during the copy are left out,
+	along with another thread's oldest event if its ring is full (it
+	may be the one being overwritten).
+	The event clock is timed for 10ms to record its rate.
+	param:	out		FILE ptr open for writing
+	pre:	out is not null
+	post:	a dump of every ring is written to out
+	ret:	0 on success, -1 if writing failed
+ */
+int linkedListTraceDump(FILE* out)
+{
+	assert(out != 0);
+	return traceDump(&trace, traceRing, 'L', out);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// MEMORY USAGE
+//
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+	Reports the memory held by one list: the bytes holding its values,
+	the link pointers, sentinels and list struct around them, and the
+	slack the allocator added to each block (from malloc_usable_size).
+	Walks every link, so this is O(n). For an arena list the arena's
+	chunks are counted instead, with unused chunk space as overhead.
+	param:	list	struct LinkedList ptr
+	param:	usage	struct LinkedListMemory ptr
+	pre:	list and usage are not null
+	post:	usage is filled in for list
+ */
+void linkedListMemoryUsage(struct LinkedList* list, struct LinkedListMemory* usage)
+{
+	assert(list != 0 && usage != 0);
+	size_t requested = sizeof(struct LinkedList);
+	size_t usable = malloc_usable_size(list);
+	if (list->filter != 0)
+	{
+		requested += sizeof(struct BagFilter) + list->filter->slots;
+		usable += malloc_usable_size(list->filter) + malloc_usable_size(list->filter->counters);
+	}
+	if (list->arena != 0)
+	{
+		// links live in the arena's chunks, so count those instead
+		arenaMemory(&list->arena->links, &requested, &usable);
+		fillMemory(usage, list->size, list->size * sizeof(TYPE), requested, usable);
+		return;
+	}
+	struct Link* current = list->frontSentinel->next;
+	while (current != list->backSentinel)
+	{
+		// small links are part of the list struct, already counted
+		if (!isSmallLink(list, current))
+		{
+			requested += sizeof(struct Link);
+			usable += malloc_usable_size(current);
+		}
+		current = current->next;
+	}
+	for (current = list->graveyard; current != 0; current = current->next)
+	{
+		if (!isSmallLink(list, current))
+		{
+			requested += sizeof(struct Link);
+			usable += malloc_usable_size(current);
+		}
+	}
+	fillMemory(usage, list->size, list->size * sizeof(TYPE), requested, usable);
+}
+
+/**
+	Reports the memory held by every list, deque and queue in the process
+	(the linked list, circular list and stack from queues modules share
+	one tally, kept with atomic counters as links and structs are
+	allocated and freed on any thread). O(1).
+	param:	usage	struct LinkedListMemory ptr
+	pre:	usage is not null
+	post:	usage is filled in for all of them combined
+ */
+void linkedListMemoryTotal(struct LinkedListMemory* usage)
+{
+	struct MemoryTally totals;
+	tallyRead(&totals);
+	fillMemory(usage, totals.elements, totals.payloadBytes, totals.requestedBytes,
+		totals.usableBytes);
+}
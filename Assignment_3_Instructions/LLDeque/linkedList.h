@@ -13,26 +13,108 @@
 #define EQ(A, B) ((A) == (B))
 #endif
 
+// Hash for the bag filter; values that are EQ must hash the same
+#ifndef HASH
+#define HASH(A) ((unsigned long long)(long long)(A))
+#endif
+
+#include <stddef.h>
+#include <stdio.h>
+
 struct LinkedList;
+struct LinkedListArena;
+struct LinkedListHandle;
+
+// Memory usage report (see linkedListMemoryUsage)
+struct LinkedListMemory
+{
+	size_t elements;
+	size_t payloadBytes;	// bytes holding values
+	size_t overheadBytes;	// link pointers, sentinels and the list struct
+	size_t slackBytes;		// allocator rounding beyond what was requested
+	size_t totalBytes;		// payload + overhead + slack
+	double bytesPerElement;
+};
 
 struct LinkedList* linkedListCreate();
 void linkedListDestroy(struct LinkedList* list);
 void linkedListPrint(struct LinkedList* list);
+void linkedListClear(struct LinkedList* list);
+struct LinkedList* linkedListClone(struct LinkedList* list);
+void linkedListTrim(struct LinkedList* list);
+void linkedListAutoTrim(struct LinkedList* list, size_t minPeak);
+
+// Array import/export
+
+size_t linkedListToArray(struct LinkedList* list, TYPE* values);
+struct LinkedList* linkedListFromArray(const TYPE* values, size_t count);
+
+// Arena interface
+
+struct LinkedListArena* linkedListArenaCreate(size_t chunkLinks);
+void linkedListArenaDestroy(struct LinkedListArena* arena);
+struct LinkedList* linkedListCreateInArena(struct LinkedListArena* arena);
 
 // Deque interface
 
+#ifdef LINKED_LIST_INLINE
+#include "linkedListInline.h"
+#else
 int linkedListIsEmpty(struct LinkedList* list);
-void linkedListAddFront(struct LinkedList* list, TYPE value);
-void linkedListAddBack(struct LinkedList* list, TYPE value);
 TYPE linkedListFront(struct LinkedList* list);
 TYPE linkedListBack(struct LinkedList* list);
+#endif
+void linkedListAddFront(struct LinkedList* list, TYPE value);
+void linkedListAddBack(struct LinkedList* list, TYPE value);
 void linkedListRemoveFront(struct LinkedList* list);
 void linkedListRemoveBack(struct LinkedList* list);
 
+// Handles
+
+struct LinkedListHandle* linkedListAddFrontHandle(struct LinkedList* list, TYPE value);
+struct LinkedListHandle* linkedListAddBackHandle(struct LinkedList* list, TYPE value);
+struct LinkedListHandle* linkedListAddHandle(struct LinkedList* list, TYPE value);
+TYPE linkedListHandleValue(struct LinkedListHandle* handle);
+void linkedListRemoveHandle(struct LinkedList* list, struct LinkedListHandle* handle);
+void linkedListMoveToFront(struct LinkedList* list, struct LinkedListHandle* handle);
+void linkedListMoveToBack(struct LinkedList* list, struct LinkedListHandle* handle);
+
 // Bag interface
 
 void linkedListAdd(struct LinkedList* list, TYPE value);
 int linkedListContains(struct LinkedList* list, TYPE value);
 void linkedListRemove(struct LinkedList* list, TYPE value);
+void linkedListEnableFilter(struct LinkedList* list, size_t expected, double falsePositiveRate);
+void linkedListLazyDelete(struct LinkedList* list, double compactRatio);
+void linkedListCompact(struct LinkedList* list);
+
+// Bag set operations
+
+struct LinkedList* linkedListUnion(struct LinkedList* a, struct LinkedList* b);
+struct LinkedList* linkedListIntersection(struct LinkedList* a, struct LinkedList* b);
+struct LinkedList* linkedListDifference(struct LinkedList* a, struct LinkedList* b);
+void linkedListUnionWith(struct LinkedList* bag, struct LinkedList* other);
+void linkedListIntersectWith(struct LinkedList* bag, struct LinkedList* other);
+void linkedListSubtract(struct LinkedList* bag, struct LinkedList* other);
+
+// Sorting
+
+void linkedListSort(struct LinkedList* list);
+void linkedListSortParallel(struct LinkedList* list, int threads);
+
+// Snapshots
+
+int linkedListWriteSnapshot(struct LinkedList* list, FILE* out);
+struct LinkedList* linkedListReadSnapshot(FILE* in);
+
+// Op tracing
+
+void linkedListTraceEnable(size_t events);
+int linkedListTraceDump(FILE* out);
+
+// Memory usage
+
+void linkedListMemoryUsage(struct LinkedList* list, struct LinkedListMemory* usage);
+void linkedListMemoryTotal(struct LinkedListMemory* usage);
 
 #endif
\ No newline at end of file
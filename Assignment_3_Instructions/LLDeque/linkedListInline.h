@@ -0,0 +1,82 @@
+#ifndef LINKED_LIST_INLINE_H
+#define LINKED_LIST_INLINE_H
+
+/*
+	Layout of the list, shared by linkedList.c and (when built with
+	-DLINKED_LIST_INLINE) by callers, who then get the hot read-only
+	deque ops below as static inline functions instead of calls into
+	linkedList.c. Building with -DLINKED_LIST_UNCHECKED as well drops
+	their precondition asserts. Include linkedList.h, not this file.
+*/
+
+#include <assert.h>
+#include <stddef.h>
+
+#ifdef LINKED_LIST_UNCHECKED
+#define LINKED_LIST_CHECK(COND) ((void)0)
+#else
+#define LINKED_LIST_CHECK(COND) assert(COND)
+#endif
+
+// Links embedded in the list struct, used before any are allocated
+#ifndef LINKED_LIST_SMALL
+#define LINKED_LIST_SMALL 8
+#endif
+
+// Double link
+struct Link
+{
+	TYPE value;
+	int dead;						// tombstone left by a lazy remove
+	struct Link* next;
+	struct Link* prev;
+};
+
+// Double linked list with front and back sentinels. The sentinels and
+// the first LINKED_LIST_SMALL links live in the struct itself, so a
+// short list costs one allocation.
+struct LinkedList
+{
+	struct Link* frontSentinel;
+	struct Link* backSentinel;
+	size_t size;
+	struct LinkedListArena* arena;	// null when links come from malloc
+	int ownsArena;					// arena is freed with the list
+	struct Link* smallFree;			// unused small links, chained through next
+	struct BagFilter* filter;		// counting Bloom filter for Contains, or null
+	size_t peak;					// largest size since the last trim
+	size_t trimPeak;				// auto trim once peak reaches this, 0 for never
+	int pinned;						// handles were handed out, so trim can't move links
+	size_t tombstones;				// links marked dead but still linked
+	struct Link* graveyard;			// unlinked tombstones to recycle, chained through next
+	size_t buried;					// links in the graveyard
+	double compactRatio;			// lazy delete mode when > 0
+	struct Link sentinels[2];
+	struct Link small[LINKED_LIST_SMALL];
+};
+
+#ifdef LINKED_LIST_INLINE
+
+static inline int linkedListIsEmpty(struct LinkedList* deque)
+{
+	LINKED_LIST_CHECK(deque != 0);
+	return deque->size == 0;
+}
+
+static inline TYPE linkedListFront(struct LinkedList* deque)
+{
+	LINKED_LIST_CHECK(deque != 0);
+	LINKED_LIST_CHECK(deque->size != 0);
+	return deque->frontSentinel->next->value;
+}
+
+static inline TYPE linkedListBack(struct LinkedList* deque)
+{
+	LINKED_LIST_CHECK(deque != 0);
+	LINKED_LIST_CHECK(deque->size != 0);
+	return deque->backSentinel->prev->value;
+}
+
+#endif
+
+#endif
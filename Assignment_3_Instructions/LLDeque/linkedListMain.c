@@ -1,5 +1,178 @@
+#define _POSIX_C_SOURCE 200809L
 #include "linkedList.h"
+#include "linkedListInline.h"
+#include "persistentDeque.h"
+#include "dequeCommon.h"
+#include <limits.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+void assertTrue(int pred, char* msg)
+{
+	printf("%s: ", msg);
+	if(pred)
+		printf("\tPASSED\n");
+	else
+		printf("\tFAILED\n");
+}
+
+/*
+	Returns 1 if the list holds exactly the count values, front to back.
+*/
+int listEquals(struct LinkedList* list, const TYPE* values, size_t count)
+{
+	TYPE found[64];
+	if (list->size != count || count > 64)
+		return 0;
+	linkedListToArray(list, found);
+	for (size_t i = 0; i < count; i++)
+		if (found[i] != values[i])
+			return 0;
+	return 1;
+}
+
+/*
+	Returns 1 if linkedListPrint writes exactly the expected text, caught
+	by pointing stdout at a temporary file while it runs.
+*/
+int printsAs(struct LinkedList* list, const char* expected)
+{
+	char printed[256] = { 0 };
+	FILE* capture = tmpfile();
+	fflush(stdout);
+	int saved = dup(STDOUT_FILENO);
+	dup2(fileno(capture), STDOUT_FILENO);
+	linkedListPrint(list);
+	fflush(stdout);
+	dup2(saved, STDOUT_FILENO);
+	close(saved);
+	rewind(capture);
+	size_t length = fread(printed, 1, sizeof(printed) - 1, capture);
+	fclose(capture);
+	return length == strlen(expected) && strcmp(printed, expected) == 0;
+}
+
+/*
+	Writes the list as a snapshot into bytes and returns its length, or
+	0 if it didn't fit.
+*/
+size_t snapshotBytes(struct LinkedList* list, unsigned char* bytes, size_t capacity)
+{
+	FILE* file = tmpfile();
+	size_t length = 0;
+	if (linkedListWriteSnapshot(list, file) == 0)
+	{
+		rewind(file);
+		length = fread(bytes, 1, capacity, file);
+		length = fgetc(file) == EOF ? length : 0;
+	}
+	fclose(file);
+	return length;
+}
+
+/*
+	Reads a list back from the first length bytes of a snapshot, or
+	returns null if the read rejects them.
+*/
+struct LinkedList* snapshotFromBytes(unsigned char* bytes, size_t length)
+{
+	FILE* file = fmemopen(bytes, length, "r");
+	struct LinkedList* list = linkedListReadSnapshot(file);
+	fclose(file);
+	return list;
+}
+
+/*
+	Reads a little-endian field of the given number of bytes from a
+	trace dump.
+*/
+uint64_t dumpField(FILE* dump, int bytes)
+{
+	uint64_t value = 0;
+	for (int i = 0; i < bytes; i++)
+		value |= (uint64_t)(fgetc(dump) & 0xff) << (8 * i);
+	return value;
+}
+
+/*
+	Reads a trace dump of the list module holding one thread ring into
+	events (at most max of them) and returns how many it holds, or -1 if
+	it is not such a dump.
+*/
+long readTrace(FILE* dump, struct TraceEvent* events, size_t max)
+{
+	char magic[5];
+	rewind(dump);
+	if (fread(magic, 1, 5, dump) != 5 || memcmp(magic, "DQT1L", 5) != 0)
+		return -1;
+	dumpField(dump, 8);
+	if (dumpField(dump, 4) != 1)
+		return -1;
+	dumpField(dump, 4);
+	uint64_t count = dumpField(dump, 8);
+	if (count > max)
+		return -1;
+	for (uint64_t i = 0; i < count; i++)
+	{
+		events[i].ticks = dumpField(dump, 8);
+		events[i].size = dumpField(dump, 8);
+		events[i].hash = (uint32_t)dumpField(dump, 4);
+		events[i].op = (uint16_t)dumpField(dump, 2);
+		events[i].object = (uint16_t)dumpField(dump, 2);
+	}
+	return fgetc(dump) == EOF ? (long)count : -1;
+}
+
+/*
+	Makes a lazy delete bag of the values, added at the back, then
+	removes every dead value so that each leaves a tombstone.
+*/
+struct LinkedList* bagWithTombstones(const TYPE* values, size_t count, TYPE dead)
+{
+	struct LinkedList* bag = linkedListCreate();
+	linkedListLazyDelete(bag, 1);
+	for (size_t i = 0; i < count; i++)
+		linkedListAddBack(bag, values[i]);
+	while (linkedListContains(bag, dead))
+		linkedListRemove(bag, dead);
+	return bag;
+}
+
+/*
+	Fills links with the list's live links, front to back, and returns
+	how many there are.
+*/
+size_t liveLinks(struct LinkedList* list, struct Link** links)
+{
+	size_t count = 0;
+	for (struct Link* link = list->frontSentinel->next; link != list->backSentinel; link = link->next)
+		if (!link->dead)
+			links[count++] = link;
+	return count;
+}
+
+/*
+	Returns 1 if the version holds exactly the size values, front to
+	back, checked by popping a copy of it down to empty.
+*/
+int versionMatches(struct PersistentDeque* version, const TYPE* values, size_t size)
+{
+	struct PersistentDeque* at = persistentDequeRetain(version);
+	int ok = persistentDequeSize(at) == size
+		&& (size == 0 || persistentDequeBack(at) == values[size - 1]);
+	for (size_t i = 0; ok && i < size; i++)
+	{
+		ok = persistentDequeFront(at) == values[i];
+		struct PersistentDeque* next = persistentDequeRemoveFront(at);
+		persistentDequeRelease(at);
+		at = next;
+	}
+	ok = ok && persistentDequeIsEmpty(at);
+	persistentDequeRelease(at);
+	return ok;
+}
 
 int main(){
 	struct LinkedList* l = linkedListCreate(); 
@@ -26,6 +199,544 @@ int main(){
        linkedListRemove(k, (TYPE)11);
         linkedListPrint(k);
         linkedListDestroy(k);
+/* LAZY DELETE */
+
+	struct LinkedList* z = linkedListCreate();
+	linkedListLazyDelete(z, 1);
+	for (int i = 40; i < 46; i++)
+		linkedListAddBack(z, (TYPE)i);
+	linkedListRemove(z, (TYPE)41);
+	linkedListRemove(z, (TYPE)42);
+	assertTrue(z->tombstones == 2 && !linkedListContains(z, (TYPE)41) && linkedListContains(z, (TYPE)43),
+		"contains skips tombstones");
+	assertTrue(printsAs(z, "40\n43\n44\n45\n"), "print skips tombstones");
+	linkedListRemoveFront(z);
+	assertTrue(linkedListFront(z) == 43 && z->tombstones == 0 && z->buried == 2,
+		"tombstones behind the front go to the graveyard");
+	linkedListRemove(z, (TYPE)44);
+	linkedListRemoveBack(z);
+	assertTrue(linkedListFront(z) == 43 && linkedListBack(z) == 43 && z->buried == 3,
+		"front and back skip tombstones");
+	struct Link* buried = z->graveyard;
+	linkedListAddBack(z, (TYPE)41);
+	assertTrue(z->backSentinel->prev == buried && z->buried == 2, "adds recycle the graveyard");
+	linkedListAddFront(z, (TYPE)42);
+	linkedListAddBack(z, (TYPE)41);
+	assertTrue(z->buried == 0 && linkedListContains(z, (TYPE)41) && printsAs(z, "42\n43\n41\n41\n"),
+		"a value removed before can be added again");
+	linkedListRemove(z, (TYPE)41);
+	linkedListRemove(z, (TYPE)41);
+	assertTrue(z->tombstones == 0 && listEquals(z, (TYPE[]){ 42, 43 }, 2), "remove skips tombstones of its value");
+	linkedListDestroy(z);
+
+	z = linkedListCreate();
+	linkedListLazyDelete(z, 0.5);
+	for (int i = 0; i < 10; i++)
+		linkedListAddBack(z, (TYPE)i);
+	for (int i = 1; i < 6; i++)
+		linkedListRemove(z, (TYPE)i);
+	assertTrue(z->tombstones == 5 && z->size == 5, "half the links dead is not yet compacted");
+	linkedListRemove(z, (TYPE)6);
+	assertTrue(z->tombstones == 0 && z->buried == 0 && listEquals(z, (TYPE[]){ 0, 7, 8, 9 }, 4),
+		"compacted once the dead links cross the ratio");
+	linkedListDestroy(z);
+
+	// bursts of adds and removes, checked against an array model
+	z = linkedListCreate();
+	linkedListLazyDelete(z, 0.25);
+	TYPE burstModel[1000];
+	TYPE burstFound[1000];
+	size_t modelSize = 0;
+	int compactions = 0;
+	int bounded = 1;
+	int matching = 1;
+	srand(3);
+	for (int burst = 0; burst < 20; burst++)
+	{
+		for (int i = 0; i < 50; i++)
+		{
+			TYPE value = (TYPE)(rand() % 50);
+			linkedListAddBack(z, value);
+			burstModel[modelSize++] = value;
+		}
+		for (int i = 0; i < 40; i++)
+		{
+			size_t at = (size_t)rand() % modelSize;
+			TYPE value = burstModel[at];
+			size_t first = 0;
+			while (burstModel[first] != value)
+				first++;
+			memmove(&burstModel[first], &burstModel[first + 1], (modelSize - first - 1) * sizeof(TYPE));
+			modelSize--;
+			size_t dead = z->tombstones + z->buried;
+			linkedListRemove(z, value);
+			compactions += dead > 0 && z->tombstones + z->buried == 0;
+			// a remove that leaves a tombstone compacts if it crosses the ratio
+			if (z->tombstones + z->buried > dead)
+				bounded = bounded && z->tombstones + z->buried <= 0.25 * (z->size + z->tombstones + z->buried);
+		}
+		matching = matching && linkedListToArray(z, burstFound) == modelSize
+			&& memcmp(burstFound, burstModel, modelSize * sizeof(TYPE)) == 0;
+	}
+	assertTrue(matching, "bursts of adds and removes match the model");
+	assertTrue(compactions > 0 && bounded, "bursts compact as they cross the ratio");
+	linkedListDestroy(z);
+/* BLOOM FILTER */
+
+	struct LinkedList* f = linkedListCreate();
+	linkedListAdd(f, (TYPE)-1);
+	linkedListEnableFilter(f, 16, 0.01);
+	assertTrue(linkedListContains(f, (TYPE)-1), "filter holds values added before it");
+	int present[600] = {0};
+	for (int i = 0; i < 300; i++)
+	{
+		int value = rand() % 600;
+		linkedListAdd(f, (TYPE)value);
+		present[value]++;
+	}
+	linkedListLazyDelete(f, 0.5);
+	for (int i = 0; i < 200; i++)
+	{
+		int value = rand() % 600;
+		if (present[value] > 0)
+		{
+			linkedListRemove(f, (TYPE)value);
+			present[value]--;
+		}
+	}
+	linkedListAddFront(f, (TYPE)600);
+	linkedListRemoveFront(f);
+	linkedListAddBack(f, (TYPE)-1);
+	linkedListRemoveBack(f);
+	int exact = 1;
+	for (int value = 0; value < 600; value++)
+	{
+		exact = exact && linkedListContains(f, (TYPE)value) == (present[value] > 0);
+	}
+	assertTrue(exact, "no false negatives after removes and rebuilds");
+	assertTrue(!linkedListContains(f, (TYPE)600) && linkedListContains(f, (TYPE)-1),
+		"deque ops keep the filter up to date");
+	linkedListEnableFilter(f, 1000, 0.001);
+	exact = 1;
+	for (int value = 0; value < 600; value++)
+	{
+		exact = exact && linkedListContains(f, (TYPE)value) == (present[value] > 0);
+	}
+	assertTrue(exact, "no false negatives after resizing the filter");
+	linkedListDestroy(f);
+/* SET OPERATIONS */
+
+	// 7 is removed again, leaving tombstones at both ends and in between
+	const TYPE xValues[] = { 7, 1, 7, 2, 2, 3, 7, 5, 2, 9, 7 };
+	const TYPE yValues[] = { 2, 7, 3, 3, 2, 6 };
+	const TYPE xLive[] = { 1, 2, 2, 3, 5, 2, 9 };
+	const TYPE yLive[] = { 2, 3, 3, 2, 6 };
+	struct LinkedList* x = bagWithTombstones(xValues, 11, (TYPE)7);
+	struct LinkedList* y = bagWithTombstones(yValues, 6, (TYPE)7);
+	assertTrue(x->tombstones > 0 && y->tombstones > 0 && listEquals(x, xLive, 7) && listEquals(y, yLive, 5),
+		"set op inputs skip their tombstones");
+	struct LinkedList* u = linkedListUnion(x, y);
+	assertTrue(listEquals(u, (TYPE[]){ 1, 2, 2, 3, 5, 2, 9, 3, 6 }, 9),
+		"union keeps the larger count, a's values first");
+	linkedListDestroy(u);
+	u = linkedListIntersection(x, y);
+	assertTrue(listEquals(u, (TYPE[]){ 2, 2, 3 }, 3), "intersection keeps the smaller count");
+	linkedListDestroy(u);
+	u = linkedListDifference(x, y);
+	assertTrue(listEquals(u, (TYPE[]){ 1, 5, 2, 9 }, 4), "difference subtracts the counts");
+	linkedListDestroy(u);
+	u = linkedListDifference(y, x);
+	assertTrue(listEquals(u, (TYPE[]){ 3, 6 }, 2), "difference the other way round");
+	linkedListDestroy(u);
+	assertTrue(listEquals(x, xLive, 7) && listEquals(y, yLive, 5), "set ops leave their inputs alone");
+
+	struct Link* before[16];
+	struct Link* after[16];
+	liveLinks(x, before);
+	linkedListUnionWith(x, y);
+	size_t live = liveLinks(x, after);
+	int inPlace = live == 9;
+	for (int i = 0; i < 7; i++)
+		inPlace = inPlace && after[i] == before[i];
+	assertTrue(listEquals(x, (TYPE[]){ 1, 2, 2, 3, 5, 2, 9, 3, 6 }, 9), "union with adds what the bag lacks");
+	assertTrue(inPlace, "union with keeps the bag's links where they are");
+	linkedListDestroy(x);
+
+	x = bagWithTombstones(xValues, 11, (TYPE)7);
+	liveLinks(x, before);
+	linkedListIntersectWith(x, y);
+	live = liveLinks(x, after);
+	assertTrue(listEquals(x, (TYPE[]){ 2, 2, 3 }, 3), "intersect with keeps the smaller count");
+	assertTrue(live == 3 && after[0] == before[1] && after[1] == before[2] && after[2] == before[3],
+		"intersect with keeps the links it doesn't drop");
+	linkedListDestroy(x);
+
+	x = bagWithTombstones(xValues, 11, (TYPE)7);
+	liveLinks(x, before);
+	linkedListSubtract(x, y);
+	live = liveLinks(x, after);
+	assertTrue(listEquals(x, (TYPE[]){ 1, 5, 2, 9 }, 4), "subtract removes one value per match");
+	assertTrue(live == 4 && after[0] == before[0] && after[1] == before[4] && after[2] == before[5]
+		&& after[3] == before[6], "subtract keeps the links it doesn't drop");
+	assertTrue(listEquals(y, yLive, 5), "in place set ops leave the other bag alone");
+	linkedListSubtract(x, x);
+	assertTrue(linkedListIsEmpty(x), "subtracting a bag from itself empties it");
+	linkedListDestroy(x);
+	linkedListDestroy(y);
+/* HANDLES */
+
+	// most recently used at the front, least recently used at the back
+	struct LinkedList* lru = linkedListCreate();
+	struct LinkedListHandle* h31 = linkedListAddFrontHandle(lru, (TYPE)31);
+	struct LinkedListHandle* h32 = linkedListAddFrontHandle(lru, (TYPE)32);
+	struct LinkedListHandle* h33 = linkedListAddFrontHandle(lru, (TYPE)33);
+	assertTrue(listEquals(lru, (TYPE[]){ 33, 32, 31 }, 3), "add front handles");
+	linkedListMoveToFront(lru, h31);
+	assertTrue(listEquals(lru, (TYPE[]){ 31, 33, 32 }, 3), "move the back to the front");
+	struct LinkedListHandle* h34 = linkedListAddHandle(lru, (TYPE)34);
+	assertTrue(listEquals(lru, (TYPE[]){ 34, 31, 33, 32 }, 4), "add handle adds to the bag's front");
+	linkedListMoveToBack(lru, h33);
+	assertTrue(listEquals(lru, (TYPE[]){ 34, 31, 32, 33 }, 4), "move a middle link to the back");
+	struct LinkedListHandle* h35 = linkedListAddBackHandle(lru, (TYPE)35);
+	linkedListMoveToFront(lru, h35);
+	assertTrue(listEquals(lru, (TYPE[]){ 35, 34, 31, 32, 33 }, 5), "add back handle, then move it to the front");
+	linkedListRemoveHandle(lru, h32);
+	assertTrue(listEquals(lru, (TYPE[]){ 35, 34, 31, 33 }, 4), "remove a middle handle");
+	linkedListMoveToBack(lru, h35);
+	linkedListMoveToFront(lru, h31);
+	assertTrue(listEquals(lru, (TYPE[]){ 31, 34, 33, 35 }, 4), "move the front to the back, then a middle link forward");
+	linkedListMoveToFront(lru, h31);
+	linkedListMoveToBack(lru, h35);
+	assertTrue(listEquals(lru, (TYPE[]){ 31, 34, 33, 35 }, 4), "moving a link to where it is changes nothing");
+	linkedListRemoveHandle(lru, h31);
+	linkedListRemoveHandle(lru, h35);
+	assertTrue(listEquals(lru, (TYPE[]){ 34, 33 }, 2), "remove the front and back handles");
+	assertTrue(linkedListHandleValue(h34) == 34 && linkedListHandleValue(h33) == 33
+		&& linkedListFront(lru) == 34 && linkedListBack(lru) == 33, "handles still valid");
+	linkedListDestroy(lru);
+/* ARRAYS */
+
+	TYPE in[4] = { 20, 21, 22, 23 };
+	TYPE out[4];
+	struct LinkedList* a = linkedListFromArray(in, 4);
+	linkedListAddBack(a, (TYPE)24);
+	linkedListRemoveFront(a);
+	printf("%zu\n", linkedListToArray(a, out));
+	printf("%i %i\n", out[0], out[3]);
+	linkedListDestroy(a);
+/* CLONE */
+
+	struct LinkedList* original = linkedListCreate();
+	linkedListLazyDelete(original, 1);
+	for (int i = 0; i < 6; i++)
+		linkedListAddBack(original, (TYPE)i);
+	linkedListRemove(original, (TYPE)3);
+	struct LinkedList* clone = linkedListClone(original);
+	linkedListRemoveFront(original);
+	linkedListAddBack(clone, (TYPE)6);
+	TYPE copied[7];
+	assertTrue(linkedListToArray(clone, copied) == 6 && copied[0] == 0 && copied[2] == 2
+		&& copied[3] == 4 && copied[5] == 6, "clone skips tombstones, keeps order");
+	assertTrue(linkedListFront(original) == 1 && linkedListBack(original) == 5,
+		"original unchanged by clone");
+	struct LinkedListMemory cloneUsage;
+	linkedListMemoryUsage(clone, &cloneUsage);
+	assertTrue(cloneUsage.elements == 6, "clone elements == 6");
+	linkedListDestroy(clone);
+	linkedListClear(original);
+	clone = linkedListClone(original);
+	assertTrue(linkedListIsEmpty(clone), "clone of empty is empty");
+	linkedListAddFront(clone, (TYPE)7);
+	assertTrue(linkedListFront(clone) == 7 && linkedListIsEmpty(original), "empty clone grows");
+	linkedListDestroy(clone);
+	linkedListDestroy(original);
+/* SORT */
+
+	struct LinkedList* serial = linkedListCreate();
+	linkedListLazyDelete(serial, 1);
+	srand(1);
+	long total = 0;
+	for (int i = 0; i < 1000; i++)
+	{
+		TYPE value = (TYPE)(rand() % 100 - 50);
+		linkedListAddBack(serial, value);
+		total += value;
+	}
+	TYPE dropped = (TYPE)(rand() % 100 - 50);
+	while (linkedListContains(serial, dropped))
+	{
+		linkedListRemove(serial, dropped);
+		total -= dropped;
+	}
+	struct LinkedList* parallel = linkedListClone(serial);
+	linkedListSort(serial);
+	linkedListSortParallel(parallel, 4);
+	TYPE sorted[1000];
+	TYPE merged[1000];
+	size_t count = linkedListToArray(serial, sorted);
+	int inOrder = linkedListToArray(parallel, merged) == count && count < 1000;
+	for (size_t i = 0; i < count; i++)
+	{
+		inOrder = inOrder && (i == 0 || sorted[i - 1] <= sorted[i]) && sorted[i] == merged[i];
+		total -= sorted[i];
+	}
+	assertTrue(inOrder, "sort and parallel sort agree, in order");
+	assertTrue(total == 0, "sort keeps every live value");
+	linkedListAddFront(serial, (TYPE)-100);
+	linkedListAddBack(parallel, (TYPE)100);
+	assertTrue(linkedListFront(serial) == -100 && linkedListBack(parallel) == 100,
+		"sorted lists still work as deques");
+	linkedListDestroy(parallel);
+	linkedListClear(serial);
+	linkedListSortParallel(serial, 4);
+	linkedListAddBack(serial, (TYPE)3);
+	linkedListSort(serial);
+	assertTrue(linkedListFront(serial) == 3 && linkedListBack(serial) == 3, "sort of one value");
+	linkedListDestroy(serial);
+/* TRIM */
+
+	struct LinkedListArena* trimArena = linkedListArenaCreate(8);
+	struct LinkedList* t = linkedListCreateInArena(trimArena);
+	for (int i = 0; i < 1000; i++)
+		linkedListAddBack(t, (TYPE)i);
+	struct LinkedListMemory burst;
+	struct LinkedListMemory trimmed;
+	linkedListMemoryUsage(t, &burst);
+	for (int i = 0; i < 990; i++)
+		linkedListRemoveFront(t);
+	linkedListTrim(t);
+	TYPE kept[1000];
+	assertTrue(linkedListToArray(t, kept) == 10 && kept[0] == 990 && kept[9] == 999,
+		"trim keeps the values in order");
+	for (int i = 989; i >= 0; i--)
+		linkedListAddFront(t, (TYPE)i);
+	linkedListMemoryUsage(t, &trimmed);
+	assertTrue(trimmed.totalBytes == burst.totalBytes, "next burst reuses the chunks");
+	assertTrue(linkedListToArray(t, kept) == 1000 && kept[0] == 0 && kept[999] == 999,
+		"values in order after the next burst");
+	struct LinkedListHandle* pinned = linkedListAddBackHandle(t, (TYPE)5000);
+	for (int i = 0; i < 900; i++)
+		linkedListRemoveFront(t);
+	linkedListTrim(t);
+	assertTrue(linkedListHandleValue(pinned) == 5000 && linkedListBack(t) == 5000,
+		"trim keeps handles valid");
+	linkedListRemoveHandle(t, pinned);
+	assertTrue(linkedListBack(t) == 999 && linkedListFront(t) == 900, "handle removed after trim");
+	linkedListDestroy(t);
+	linkedListArenaDestroy(trimArena);
+
+	t = linkedListCreate();
+	linkedListAutoTrim(t, 100);
+	linkedListLazyDelete(t, 1);
+	for (int i = 0; i < 400; i++)
+		linkedListAdd(t, (TYPE)i);
+	for (int i = 1; i < 351; i++)
+		linkedListRemove(t, (TYPE)i);
+	int trimmedOk = linkedListToArray(t, kept) == 50 && kept[0] == 399 && kept[49] == 0;
+	for (int i = 351; i < 399; i++)
+		trimmedOk = trimmedOk && linkedListContains(t, (TYPE)i) && !linkedListContains(t, (TYPE)(i - 350));
+	assertTrue(trimmedOk, "auto trim of a lazy bag keeps the live values");
+	linkedListDestroy(t);
+
+	t = linkedListCreate();
+	struct LinkedList* scatter = linkedListCreate();
+	for (int i = 0; i < 200; i++)
+	{
+		linkedListAddBack(t, (TYPE)i);
+		linkedListAddBack(scatter, (TYPE)i);
+	}
+	for (int i = 0; i < 150; i++)
+		linkedListRemoveFront(t);
+	linkedListTrim(t);
+	int contiguous = 1;
+	for (struct Link* link = t->frontSentinel->next; link->next != t->backSentinel; link = link->next)
+		contiguous = contiguous && link->next == link + 1;
+	assertTrue(contiguous, "trim packs a malloc list's links into one block");
+	assertTrue(linkedListToArray(t, kept) == 50 && kept[0] == 150 && kept[49] == 199,
+		"trim of a malloc list keeps the values in order");
+	linkedListAddFront(t, (TYPE)149);
+	linkedListRemoveBack(t);
+	assertTrue(linkedListToArray(t, kept) == 50 && kept[0] == 149 && kept[49] == 198,
+		"trimmed malloc list takes links from its new arena");
+	linkedListDestroy(scatter);
+	linkedListDestroy(t);
+/* SNAPSHOTS */
+
+	// deltas of both signs, including ones that overflow an int
+	const TYPE signedValues[] = { 0, -1, 5, INT_MIN, INT_MAX, -300, 300, -7, INT_MIN };
+	struct LinkedList* saved = linkedListFromArray(signedValues, 9);
+	unsigned char bytes[1024];
+	size_t length = snapshotBytes(saved, bytes, sizeof(bytes));
+	struct LinkedList* loaded = snapshotFromBytes(bytes, length);
+	assertTrue(loaded != 0 && listEquals(loaded, signedValues, 9), "snapshot round trip of negative ints");
+	linkedListDestroy(loaded);
+	linkedListDestroy(saved);
+
+	saved = linkedListCreate();
+	for (int i = 1; i <= 100; i++)
+		linkedListAddBack(saved, (TYPE)-i);
+	length = snapshotBytes(saved, bytes, sizeof(bytes));
+	assertTrue(length == 4 + 3 + 100 + 4, "small negative deltas take one byte each");
+	loaded = snapshotFromBytes(bytes, length);
+	assertTrue(loaded != 0 && linkedListFront(loaded) == -1 && linkedListBack(loaded) == -100
+		&& linkedListToArray(loaded, kept) == 100, "decreasing run read back");
+	linkedListDestroy(loaded);
+	bytes[length - 1] ^= 1;
+	assertTrue(snapshotFromBytes(bytes, length) == 0, "bad checksum rejected");
+	bytes[length - 1] ^= 1;
+	bytes[50] ^= 4;
+	assertTrue(snapshotFromBytes(bytes, length) == 0, "changed value rejected");
+	bytes[50] ^= 4;
+	bytes[4] = 'f';
+	assertTrue(snapshotFromBytes(bytes, length) == 0, "snapshot of another TYPE rejected");
+	bytes[4] = 'i';
+	assertTrue(snapshotFromBytes(bytes, length - 2) == 0, "cut off snapshot rejected");
+	loaded = snapshotFromBytes(bytes, length);
+	assertTrue(loaded != 0, "restored snapshot read");
+	linkedListDestroy(loaded);
+	linkedListDestroy(saved);
+
+	saved = bagWithTombstones((TYPE[]){ 7, -3, 7, 4, -9, 7 }, 6, (TYPE)7);
+	length = snapshotBytes(saved, bytes, sizeof(bytes));
+	loaded = snapshotFromBytes(bytes, length);
+	assertTrue(loaded != 0 && listEquals(loaded, (TYPE[]){ -3, 4, -9 }, 3), "snapshot leaves out tombstones");
+	linkedListDestroy(loaded);
+	linkedListClear(saved);
+	length = snapshotBytes(saved, bytes, sizeof(bytes));
+	loaded = snapshotFromBytes(bytes, length);
+	assertTrue(loaded != 0 && linkedListIsEmpty(loaded), "snapshot of an empty list");
+	linkedListDestroy(loaded);
+	linkedListDestroy(saved);
+/* TRACING */
+
+	linkedListTraceEnable(3);
+	struct LinkedList* traced = linkedListCreate();
+	linkedListAddBack(traced, (TYPE)-2);
+	linkedListAddFront(traced, (TYPE)-3);
+	linkedListAdd(traced, (TYPE)-4);
+	linkedListRemove(traced, (TYPE)-2);
+	linkedListRemoveBack(traced);
+	linkedListTraceEnable(0);
+	linkedListAddBack(traced, (TYPE)5);
+	FILE* dump = tmpfile();
+	struct TraceEvent events[8];
+	assertTrue(linkedListTraceDump(dump) == 0, "trace dump written");
+	assertTrue(readTrace(dump, events, 8) == 4, "one ring keeps the last 4 ops");
+	assertTrue(events[0].op == TRACE_ADD_FRONT && events[1].op == TRACE_ADD && events[2].op == TRACE_REMOVE
+		&& events[3].op == TRACE_REMOVE_BACK, "ops oldest first");
+	assertTrue(events[0].size == 1 && events[1].size == 2 && events[2].size == 3 && events[3].size == 2,
+		"size before each op");
+	assertTrue(events[0].hash == (uint32_t)(mixHash(HASH((TYPE)-3)) >> 32)
+		&& events[2].hash == (uint32_t)(mixHash(HASH((TYPE)-2)) >> 32), "hashes of negative values");
+	assertTrue(events[0].object == events[3].object && events[0].ticks <= events[3].ticks,
+		"one list, in time order");
+	fclose(dump);
+	linkedListDestroy(traced);
+/* PERSISTENT DEQUE */
+
+	struct PersistentDeque* v0 = persistentDequeCreate();
+	struct PersistentDeque* v1 = persistentDequeAddBack(v0, (TYPE)7);
+	struct PersistentDeque* v2 = persistentDequeAddFront(v1, (TYPE)8);
+	assertTrue(persistentDequeSize(v1) == 1 && persistentDequeSize(v2) == 2, "versions have their own sizes");
+	assertTrue(persistentDequeFront(v2) == 8 && persistentDequeBack(v2) == 7, "front and back of a version");
+	assertTrue(persistentDequeIsEmpty(v0) && persistentDequeFront(v1) == 7, "adds leave the old version alone");
+	struct PersistentDequeSlot* slot = persistentDequeSlotCreate(persistentDequeRetain(v2));
+	struct PersistentDeque* seen = persistentDequeLoad(slot);
+	persistentDequeStore(slot, persistentDequeAddBack(seen, (TYPE)9));
+	struct PersistentDeque* stale = seen;
+	seen = persistentDequeLoad(slot);
+	assertTrue(persistentDequeSize(seen) == 3 && persistentDequeBack(seen) == 9, "load sees the stored version");
+	struct PersistentDeque* lost = persistentDequeAddFront(stale, (TYPE)1);
+	assertTrue(!persistentDequeCompareAndStore(slot, stale, lost), "compare and store fails on a stale version");
+	persistentDequeRelease(lost);
+	assertTrue(persistentDequeCompareAndStore(slot, seen, persistentDequeRemoveBack(seen)),
+		"compare and store on the current version");
+	persistentDequeRelease(seen);
+	seen = persistentDequeLoad(slot);
+	assertTrue(versionMatches(seen, (TYPE[]){8, 7}, 2), "load sees the compared and stored version");
+	persistentDequeRelease(seen);
+	persistentDequeRelease(stale);
+	persistentDequeSlotDestroy(slot);
+	persistentDequeRelease(v2);
+	persistentDequeRelease(v1);
+	persistentDequeRelease(v0);
+
+	/*
+		Every version is checked against an array model. Long runs at one
+		end push one stack past three times the other, so versionCreate
+		rebalances, and removes at the other end then pop the values the
+		rebalance moved across.
+	*/
+	enum { STEPS = 700 };
+	TYPE* model = malloc(2 * STEPS * sizeof(TYPE));
+	TYPE** models = malloc((STEPS + 1) * sizeof(TYPE*));
+	size_t* modelSizes = malloc((STEPS + 1) * sizeof(size_t));
+	struct PersistentDeque** versions = malloc((STEPS + 1) * sizeof(struct PersistentDeque*));
+	size_t lo = STEPS;
+	size_t hi = STEPS;
+	int matches = 1;
+	unsigned seed = 1;
+	versions[0] = persistentDequeCreate();
+	models[0] = 0;
+	modelSizes[0] = 0;
+	for (int step = 0; step < STEPS; step++)
+	{
+		struct PersistentDeque* at = versions[step];
+		struct PersistentDeque* next;
+		seed = seed * 1103515245 + 12345;
+		int op = step < 150 ? 1 : step < 250 ? 2 : step < 400 ? 0 : step < 520 ? 3 : (int)(seed >> 16) % 4;
+		if (hi == lo && op >= 2)
+			op -= 2;
+		if (op == 0)
+		{
+			next = persistentDequeAddFront(at, (TYPE)-step);
+			model[--lo] = (TYPE)-step;
+		}
+		else if (op == 1)
+		{
+			next = persistentDequeAddBack(at, (TYPE)step);
+			model[hi++] = (TYPE)step;
+		}
+		else if (op == 2)
+		{
+			matches = matches && persistentDequeFront(at) == model[lo];
+			next = persistentDequeRemoveFront(at);
+			lo++;
+		}
+		else
+		{
+			matches = matches && persistentDequeBack(at) == model[hi - 1];
+			next = persistentDequeRemoveBack(at);
+			hi--;
+		}
+		versions[step + 1] = next;
+		modelSizes[step + 1] = hi - lo;
+		models[step + 1] = malloc((hi - lo + 1) * sizeof(TYPE));
+		for (size_t i = lo; i < hi; i++)
+			models[step + 1][i - lo] = model[i];
+		matches = matches && persistentDequeSize(next) == hi - lo
+			&& (hi == lo || (persistentDequeFront(next) == model[lo] && persistentDequeBack(next) == model[hi - 1]));
+	}
+	assertTrue(matches, "every version's size, front and back match the model");
+	assertTrue(versionMatches(versions[150], models[150], 150), "values added at the back pop from the front");
+	assertTrue(versionMatches(versions[400], models[400], modelSizes[400]), "values added at the front after front removes");
+	int survive = 1;
+	for (int step = 0; step <= STEPS; step++)
+		survive = survive && versionMatches(versions[step], models[step], modelSizes[step]);
+	assertTrue(survive, "old versions survive every later version");
+	struct PersistentDeque* branch = persistentDequeRemoveBack(versions[150]);
+	assertTrue(versionMatches(branch, models[150], 149) && versionMatches(versions[151], models[151], modelSizes[151]),
+		"branching an old version leaves its successor alone");
+	persistentDequeRelease(branch);
+	for (int step = 0; step <= STEPS; step++)
+	{
+		persistentDequeRelease(versions[step]);
+		free(models[step]);
+	}
+	free(versions);
+	free(modelSizes);
+	free(models);
+	free(model);
 	return 0;
 }
 
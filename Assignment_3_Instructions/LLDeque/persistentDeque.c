@@ -0,0 +1,481 @@
+/***********************************************************
+* Filename: persistentDeque.c
+*
+* Overview:
+*   This program is a persistent (immutable) deque. Instead of
+*	changing a deque in place, every add or remove returns a new
+*	version and the version it was given stays exactly as it was,
+*	so a reader holding a version needs no lock while a writer
+*	keeps making new ones. A reader only holds a version once it
+*	has a reference of its own, though: the newest version is
+*	shared through a PersistentDequeSlot, whose load takes that
+*	reference without racing the writer that replaces (and
+*	releases) the version (see persistentDequeLoad).
+*	Each version is two stacks of single links: the front stack
+*	(top is the front of the deque) and the back stack (top is the
+*	back of the deque). Versions share every link they have in
+*	common, so a push or pop allocates at most one link. When one
+*	stack grows to more than three times the other (plus one), the
+*	values are split evenly between two new stacks; that copy is
+*	paid for by the pushes and pops that unbalanced the stacks, so
+*	each op is O(1) amortized as long as each version is changed
+*	once. (Popping the same lopsided version over and over can pay
+*	for the same copy more than once.)
+*	Links and versions are reference counted with atomic counts, so
+*	any thread may release a version, and memory is freed as soon
+*	as no version uses it.
+************************************************************/
+#include "persistentDeque.h"
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+
+// Shared single link
+struct Node
+{
+	TYPE value;
+	struct Node* next;
+	int refs;
+};
+
+// One version of the deque
+struct PersistentDeque
+{
+	struct Node* front;	// top is the front value
+	struct Node* back;	// top is the back value
+	size_t frontSize;
+	size_t backSize;
+	int refs;
+};
+
+// Current version shared between threads (see persistentDequeLoad)
+struct PersistentDequeSlot
+{
+	struct PersistentDeque* current;	// holds one reference
+	unsigned epoch;						// readers count in readers[epoch & 1]
+	unsigned readers[2];				// loads in flight
+	pthread_mutex_t writer;				// one store at a time
+};
+
+/**
+	Adds a reference to the node, if there is one.
+	param:	node	struct Node ptr or null
+	pre:	none
+	post:	node reference count is incremented
+ */
+static void nodeRetain(struct Node* node)
+{
+	if (node != 0)
+	{
+		__atomic_add_fetch(&node->refs, 1, __ATOMIC_RELAXED);
+	}
+}
+
+/**
+	Drops a reference to the node, freeing it (and then dropping its
+	reference to the next node) if it was the last one.
+	param:	node	struct Node ptr or null
+	pre:	none
+	post:	every node no longer referenced is freed
+ */
+static void nodeRelease(struct Node* node)
+{
+	while (node != 0 && __atomic_sub_fetch(&node->refs, 1, __ATOMIC_ACQ_REL) == 0)
+	{
+		struct Node* next = node->next;
+		free(node);
+		node = next;
+	}
+}
+
+/**
+	Creates a node on top of the given stack.
+	param:	value	TYPE
+	param:	next	struct Node ptr or null, a reference is added to it
+	pre:	none
+	post:	node is not null and has one reference
+	ret:	node
+ */
+static struct Node* nodeCreate(TYPE value, struct Node* next)
+{
+	struct Node* node = malloc(sizeof(struct Node));
+	assert(node != 0);
+	node->value = value;
+	node->next = next;
+	node->refs = 1;
+	nodeRetain(next);
+	return node;
+}
+
+/**
+	Makes a version from a front and back stack, splitting the values
+	evenly between two new stacks if either stack is more than three
+	times the size of the other plus one.
+	param:	front		struct Node ptr, one reference is taken over
+	param:	frontSize	size_t
+	param:	back		struct Node ptr, one reference is taken over
+	param:	backSize	size_t
+	pre:	stack sizes match the stacks
+	post:	version is not null and has one reference
+	ret:	version
+ */
+static struct PersistentDeque* versionCreate(struct Node* front, size_t frontSize,
+	struct Node* back, size_t backSize)
+{
+	if (frontSize > 3 * backSize + 1 || backSize > 3 * frontSize + 1)
+	{
+		// lay the values out front to back, then rebuild both stacks
+		size_t size = frontSize + backSize;
+		TYPE* values = malloc(size * sizeof(TYPE));
+		assert(values != 0);
+		size_t i = 0;
+		for (struct Node* node = front; node != 0; node = node->next)
+		{
+			values[i++] = node->value;
+		}
+		i = size;
+		for (struct Node* node = back; node != 0; node = node->next)
+		{
+			values[--i] = node->value;
+		}
+		nodeRelease(front);
+		nodeRelease(back);
+		frontSize = (size + 1) / 2;
+		backSize = size - frontSize;
+		front = 0;
+		back = 0;
+		for (i = frontSize; i > 0; --i)
+		{
+			struct Node* node = nodeCreate(values[i - 1], front);
+			nodeRelease(front);
+			front = node;
+		}
+		for (i = frontSize; i < size; ++i)
+		{
+			struct Node* node = nodeCreate(values[i], back);
+			nodeRelease(back);
+			back = node;
+		}
+		free(values);
+	}
+	struct PersistentDeque* deque = malloc(sizeof(struct PersistentDeque));
+	assert(deque != 0);
+	deque->front = front;
+	deque->back = back;
+	deque->frontSize = frontSize;
+	deque->backSize = backSize;
+	deque->refs = 1;
+	return deque;
+}
+
+/**
+	Allocates an empty version.
+	pre: 	none
+	post: 	version is not null and has one reference
+	return: version
+ */
+struct PersistentDeque* persistentDequeCreate()
+{
+	return versionCreate(0, 0, 0, 0);
+}
+
+/**
+	Adds a reference to the version, e.g. before handing it to another
+	thread, which must release it when done. The caller must already
+	hold a reference; to share the newest version with threads that
+	hold none, store it in a PersistentDequeSlot instead.
+	param:	deque	struct PersistentDeque ptr
+	pre:	deque is not null
+	post:	deque reference count is incremented
+	ret:	deque
+ */
+struct PersistentDeque* persistentDequeRetain(struct PersistentDeque* deque)
+{
+	assert(deque != 0);
+	__atomic_add_fetch(&deque->refs, 1, __ATOMIC_RELAXED);
+	return deque;
+}
+
+/**
+	Drops a reference to the version. Once the last reference is gone the
+	version is freed, along with any links no other version shares.
+	param:	deque	struct PersistentDeque ptr
+	pre:	deque is not null
+	post:	deque may no longer be used by the caller
+ */
+void persistentDequeRelease(struct PersistentDeque* deque)
+{
+	assert(deque != 0);
+	if (__atomic_sub_fetch(&deque->refs, 1, __ATOMIC_ACQ_REL) == 0)
+	{
+		nodeRelease(deque->front);
+		nodeRelease(deque->back);
+		free(deque);
+	}
+}
+
+/**
+	Returns 1 if the version is empty and 0 otherwise.
+	param:	deque	struct PersistentDeque ptr
+	pre:	deque is not null
+	post:	none
+	ret:	1 if its size is 0 (empty), otherwise 0 (not empty)
+ */
+int persistentDequeIsEmpty(struct PersistentDeque* deque)
+{
+	assert(deque != 0);
+	return deque->frontSize + deque->backSize == 0;
+}
+
+/**
+	Returns the number of values in the version.
+	param:	deque	struct PersistentDeque ptr
+	pre:	deque is not null
+	post:	none
+	ret:	size
+ */
+size_t persistentDequeSize(struct PersistentDeque* deque)
+{
+	assert(deque != 0);
+	return deque->frontSize + deque->backSize;
+}
+
+/**
+	Returns a new version with the value added to the front.
+	param: 	deque 	struct PersistentDeque ptr
+	param: 	value 	TYPE
+	pre: 	deque is not null
+	post: 	deque is unchanged
+	ret:	new version with one reference
+ */
+struct PersistentDeque* persistentDequeAddFront(struct PersistentDeque* deque, TYPE value)
+{
+	assert(deque != 0);
+	nodeRetain(deque->back);
+	return versionCreate(nodeCreate(value, deque->front), deque->frontSize + 1,
+		deque->back, deque->backSize);
+}
+
+/**
+	Returns a new version with the value added to the back.
+	param: 	deque 	struct PersistentDeque ptr
+	param: 	value 	TYPE
+	pre: 	deque is not null
+	post: 	deque is unchanged
+	ret:	new version with one reference
+ */
+struct PersistentDeque* persistentDequeAddBack(struct PersistentDeque* deque, TYPE value)
+{
+	assert(deque != 0);
+	nodeRetain(deque->front);
+	return versionCreate(deque->front, deque->frontSize,
+		nodeCreate(value, deque->back), deque->backSize + 1);
+}
+
+/**
+	Returns the value at the front of the version. The stacks are kept
+	balanced, so if the front stack is empty the back stack holds the
+	only value.
+	param: 	deque 	struct PersistentDeque ptr
+	pre:	deque is not null
+	pre:	deque is not empty
+	post:	none
+	ret:	front value
+ */
+TYPE persistentDequeFront(struct PersistentDeque* deque)
+{
+	assert(deque != 0);
+	assert(!persistentDequeIsEmpty(deque));
+	return deque->frontSize > 0 ? deque->front->value : deque->back->value;
+}
+
+/**
+	Returns the value at the back of the version.
+	param: 	deque 	struct PersistentDeque ptr
+	pre:	deque is not null
+	pre:	deque is not empty
+	post:	none
+	ret:	back value
+ */
+TYPE persistentDequeBack(struct PersistentDeque* deque)
+{
+	assert(deque != 0);
+	assert(!persistentDequeIsEmpty(deque));
+	return deque->backSize > 0 ? deque->back->value : deque->front->value;
+}
+
+/**
+	Returns a new version without the front value.
+	param: 	deque 	struct PersistentDeque ptr
+	pre:	deque is not null
+	pre:	deque is not empty
+	post:	deque is unchanged
+	ret:	new version with one reference
+ */
+struct PersistentDeque* persistentDequeRemoveFront(struct PersistentDeque* deque)
+{
+	assert(deque != 0);
+	assert(!persistentDequeIsEmpty(deque));
+	if (deque->frontSize == 0)
+	{
+		return versionCreate(0, 0, 0, 0);
+	}
+	nodeRetain(deque->front->next);
+	nodeRetain(deque->back);
+	return versionCreate(deque->front->next, deque->frontSize - 1,
+		deque->back, deque->backSize);
+}
+
+/**
+	Returns a new version without the back value.
+	param: 	deque 	struct PersistentDeque ptr
+	pre:	deque is not null
+	pre:	deque is not empty
+	post:	deque is unchanged
+	ret:	new version with one reference
+ */
+struct PersistentDeque* persistentDequeRemoveBack(struct PersistentDeque* deque)
+{
+	assert(deque != 0);
+	assert(!persistentDequeIsEmpty(deque));
+	if (deque->backSize == 0)
+	{
+		return versionCreate(0, 0, 0, 0);
+	}
+	nodeRetain(deque->front);
+	nodeRetain(deque->back->next);
+	return versionCreate(deque->front, deque->frontSize,
+		deque->back->next, deque->backSize - 1);
+}
+
+/**
+	Allocates a slot holding the given version as its current one.
+	param:	deque	struct PersistentDeque ptr, its reference is taken over
+	pre:	deque is not null
+	post:	slot holds deque
+	ret:	slot
+ */
+struct PersistentDequeSlot* persistentDequeSlotCreate(struct PersistentDeque* deque)
+{
+	assert(deque != 0);
+	struct PersistentDequeSlot* slot = malloc(sizeof(struct PersistentDequeSlot));
+	assert(slot != 0);
+	slot->current = deque;
+	slot->epoch = 0;
+	slot->readers[0] = 0;
+	slot->readers[1] = 0;
+	pthread_mutex_init(&slot->writer, 0);
+	return slot;
+}
+
+/**
+	Frees the slot and drops its reference to its current version.
+	param:	slot	struct PersistentDequeSlot ptr
+	pre:	slot is not null and no thread is loading or storing
+	post:	slot is freed
+ */
+void persistentDequeSlotDestroy(struct PersistentDequeSlot* slot)
+{
+	assert(slot != 0);
+	persistentDequeRelease(slot->current);
+	pthread_mutex_destroy(&slot->writer);
+	free(slot);
+}
+
+/**
+	Returns the slot's current version with a reference of the caller's
+	own, which it must release. Never blocks: the load is counted in the
+	readers of the slot's epoch for the few instructions between reading
+	the pointer and retaining it, and a store waits for those counts
+	before it releases the version it replaced.
+	param:	slot	struct PersistentDequeSlot ptr
+	pre:	slot is not null
+	post:	the returned version has one more reference
+	ret:	current version
+ */
+struct PersistentDeque* persistentDequeLoad(struct PersistentDequeSlot* slot)
+{
+	assert(slot != 0);
+	unsigned epoch;
+	for (;;)
+	{
+		epoch = __atomic_load_n(&slot->epoch, __ATOMIC_SEQ_CST);
+		__atomic_add_fetch(&slot->readers[epoch & 1], 1, __ATOMIC_SEQ_CST);
+		// a store that flipped the epoch meanwhile may not wait for us
+		if (__atomic_load_n(&slot->epoch, __ATOMIC_SEQ_CST) == epoch)
+		{
+			break;
+		}
+		__atomic_sub_fetch(&slot->readers[epoch & 1], 1, __ATOMIC_RELEASE);
+	}
+	struct PersistentDeque* deque = __atomic_load_n(&slot->current, __ATOMIC_SEQ_CST);
+	persistentDequeRetain(deque);
+	__atomic_sub_fetch(&slot->readers[epoch & 1], 1, __ATOMIC_RELEASE);
+	return deque;
+}
+
+/**
+	Makes a version the slot's current one and releases the one it
+	replaces once no load can still be taking a reference to it. Loads
+	that start after the swap count in the other epoch, so this waits
+	at most for the loads already in flight.
+	param:	slot	struct PersistentDequeSlot ptr
+	param:	deque	struct PersistentDeque ptr, its reference is taken over
+	pre:	slot and deque are not null
+	pre:	the caller holds the slot's writer lock
+	post:	slot holds deque
+ */
+static void publish(struct PersistentDequeSlot* slot, struct PersistentDeque* deque)
+{
+	struct PersistentDeque* old = __atomic_exchange_n(&slot->current, deque, __ATOMIC_SEQ_CST);
+	unsigned epoch = __atomic_fetch_add(&slot->epoch, 1, __ATOMIC_SEQ_CST);
+	while (__atomic_load_n(&slot->readers[epoch & 1], __ATOMIC_ACQUIRE) != 0)
+	{
+		sched_yield();
+	}
+	persistentDequeRelease(old);
+}
+
+/**
+	Makes the given version the slot's current one. Readers that loaded
+	the old version keep it until they release it.
+	param:	slot	struct PersistentDequeSlot ptr
+	param:	deque	struct PersistentDeque ptr, its reference is taken over
+	pre:	slot and deque are not null
+	post:	slot holds deque; its old version has lost the slot's reference
+ */
+void persistentDequeStore(struct PersistentDequeSlot* slot, struct PersistentDeque* deque)
+{
+	assert(slot != 0 && deque != 0);
+	pthread_mutex_lock(&slot->writer);
+	publish(slot, deque);
+	pthread_mutex_unlock(&slot->writer);
+}
+
+/**
+	Makes the given version the slot's current one if the current one is
+	still expected, so that writers on several threads can each load,
+	change and store without losing each other's changes (retrying from
+	a fresh load when this fails).
+	param:	slot		struct PersistentDequeSlot ptr
+	param:	expected	struct PersistentDeque ptr the caller built on
+	param:	deque		struct PersistentDeque ptr, its reference is
+						taken over only if it is stored
+	pre:	slot, expected and deque are not null
+	post:	slot holds deque if it held expected
+	ret:	1 if deque was stored, otherwise 0
+ */
+int persistentDequeCompareAndStore(struct PersistentDequeSlot* slot,
+	struct PersistentDeque* expected, struct PersistentDeque* deque)
+{
+	assert(slot != 0 && expected != 0 && deque != 0);
+	pthread_mutex_lock(&slot->writer);
+	int stored = __atomic_load_n(&slot->current, __ATOMIC_RELAXED) == expected;
+	if (stored)
+	{
+		publish(slot, deque);
+	}
+	pthread_mutex_unlock(&slot->writer);
+	return stored;
+}
@@ -0,0 +1,38 @@
+#ifndef PERSISTENT_DEQUE_H
+#define PERSISTENT_DEQUE_H
+
+#ifndef TYPE
+#define TYPE int
+#endif
+
+#include <stddef.h>
+
+struct PersistentDeque;
+
+struct PersistentDeque* persistentDequeCreate();
+struct PersistentDeque* persistentDequeRetain(struct PersistentDeque* deque);
+void persistentDequeRelease(struct PersistentDeque* deque);
+
+// Shared slot holding the current version for readers on other threads
+
+struct PersistentDequeSlot;
+
+struct PersistentDequeSlot* persistentDequeSlotCreate(struct PersistentDeque* deque);
+void persistentDequeSlotDestroy(struct PersistentDequeSlot* slot);
+struct PersistentDeque* persistentDequeLoad(struct PersistentDequeSlot* slot);
+void persistentDequeStore(struct PersistentDequeSlot* slot, struct PersistentDeque* deque);
+int persistentDequeCompareAndStore(struct PersistentDequeSlot* slot,
+	struct PersistentDeque* expected, struct PersistentDeque* deque);
+
+// Deque interface; every change returns a new version
+
+int persistentDequeIsEmpty(struct PersistentDeque* deque);
+size_t persistentDequeSize(struct PersistentDeque* deque);
+struct PersistentDeque* persistentDequeAddFront(struct PersistentDeque* deque, TYPE value);
+struct PersistentDeque* persistentDequeAddBack(struct PersistentDeque* deque, TYPE value);
+TYPE persistentDequeFront(struct PersistentDeque* deque);
+TYPE persistentDequeBack(struct PersistentDeque* deque);
+struct PersistentDeque* persistentDequeRemoveFront(struct PersistentDeque* deque);
+struct PersistentDeque* persistentDequeRemoveBack(struct PersistentDeque* deque);
+
+#endif
@@ -0,0 +1,136 @@
+#include "persistentDeque.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+	Stress test for the shared slot: one writer keeps making new versions
+	and publishing them, alternating persistentDequeStore with
+	persistentDequeCompareAndStore, while several readers load the
+	current version and pop their copy of it down to empty. The writer
+	keeps the values consecutive from front to back (it adds front - 1 at
+	the front and back + 1 at the back), so every version a reader loads
+	must hold consecutive values, as many as its size says. The writer
+	also checks that a compare and store against a version it has
+	already replaced fails. Build with -fsanitize=address to catch
+	versions or links freed too early.
+*/
+
+#define READERS 8
+#define WRITES 100000
+#define MAX_SIZE 200
+
+struct PersistentDequeSlot* slot;
+int writing = 1;
+
+void* reader(void* arg)
+{
+	long* loads = arg;
+	int ok = 1;
+	while(__atomic_load_n(&writing, __ATOMIC_ACQUIRE))
+	{
+		struct PersistentDeque* version = persistentDequeLoad(slot);
+		size_t size = persistentDequeSize(version);
+		size_t popped = 0;
+		TYPE last = 0;
+		while(!persistentDequeIsEmpty(version))
+		{
+			TYPE value = persistentDequeFront(version);
+			ok = ok && (popped == 0 || value == last + 1);
+			last = value;
+			popped++;
+			struct PersistentDeque* next = persistentDequeRemoveFront(version);
+			persistentDequeRelease(version);
+			version = next;
+		}
+		persistentDequeRelease(version);
+		ok = ok && popped == size;
+		(*loads)++;
+	}
+	return ok ? arg : 0;
+}
+
+int main()
+{
+	struct PersistentDeque* empty = persistentDequeCreate();
+	struct PersistentDeque* current = persistentDequeAddBack(empty, (TYPE)0);
+	persistentDequeRelease(empty);
+	slot = persistentDequeSlotCreate(persistentDequeRetain(current));
+	size_t size = 1;
+
+	pthread_t threads[READERS];
+	long loads[READERS] = { 0 };
+	for(int i = 0; i < READERS; i++)
+	{
+		pthread_create(&threads[i], 0, reader, &loads[i]);
+	}
+
+	int stored = 1;
+	srand(1);
+	for(int i = 0; i < WRITES; i++)
+	{
+		int op = rand() % 4;
+		struct PersistentDeque* next;
+		if(size == 0)
+		{
+			next = persistentDequeAddBack(current, (TYPE)0);
+			size++;
+		}
+		else if(op == 0 && size < MAX_SIZE)
+		{
+			next = persistentDequeAddFront(current, persistentDequeFront(current) - 1);
+			size++;
+		}
+		else if(op == 1 && size < MAX_SIZE)
+		{
+			next = persistentDequeAddBack(current, persistentDequeBack(current) + 1);
+			size++;
+		}
+		else if(op == 2)
+		{
+			next = persistentDequeRemoveFront(current);
+			size--;
+		}
+		else
+		{
+			next = persistentDequeRemoveBack(current);
+			size--;
+		}
+		if(i % 2 == 0)
+		{
+			persistentDequeStore(slot, persistentDequeRetain(next));
+		}
+		else
+		{
+			stored = stored && persistentDequeCompareAndStore(slot, current, persistentDequeRetain(next));
+		}
+		// current has been replaced, so comparing against it must fail
+		struct PersistentDeque* again = persistentDequeRetain(next);
+		if(persistentDequeCompareAndStore(slot, current, again))
+		{
+			stored = 0;
+		}
+		else
+		{
+			persistentDequeRelease(again);
+		}
+		persistentDequeRelease(current);
+		current = next;
+	}
+	__atomic_store_n(&writing, 0, __ATOMIC_RELEASE);
+
+	int passed = stored;
+	long total = 0;
+	for(int i = 0; i < READERS; i++)
+	{
+		void* ok;
+		pthread_join(threads[i], &ok);
+		passed = passed && ok != 0;
+		total += loads[i];
+	}
+	persistentDequeRelease(current);
+	persistentDequeSlotDestroy(slot);
+	printf("%d writes, %ld loads by %d readers: %s\n", WRITES, total, READERS,
+		passed ? "PASSED" : "FAILED");
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,50 @@
+/***********************************************************
+* Filename: latency.c
+*
+* Overview:
+*   This program measures the latency of every single operation
+*	on the linked list deque/bag, the circular list deque and the
+*	stack from queues, instead of their average throughput. Each
+*	operation is timed on its own and recorded in a log-linear
+*	histogram (see latencyHistogram.c), and the p50, p99, p99.9 and
+*	max are printed per operation and per structure size, so a rare
+*	slow malloc inside an add, or the O(n) stack push, shows up in
+*	the tail columns rather than disappearing into a mean.
+*
+* Usage:
+* 	1) make
+*	2) ./latency [ops [size ...]]
+*		ops		operations timed per O(1) op and size (default 100000)
+*		size	structure sizes to measure at (default 16 1024 65536)
+************************************************************/
+#include "latency.h"
+#include "latencyHistogram.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MAX_SIZES 16
+
+int main(int argc, char** argv)
+{
+	size_t ops = 100000;
+	size_t sizes[MAX_SIZES] = { 16, 1024, 65536 };
+	int count = 3;
+	if (argc > 1)
+	{
+		ops = strtoul(argv[1], 0, 10);
+	}
+	if (argc > 2)
+	{
+		count = 0;
+		for (int i = 2; i < argc && count < MAX_SIZES; i++)
+		{
+			sizes[count++] = strtoul(argv[i], 0, 10);
+		}
+	}
+
+	latencyPrintHeader();
+	latencyLinkedList(sizes, count, ops);
+	latencyCircularList(sizes, count, ops);
+	latencyStack(sizes, count, ops);
+	return 0;
+}
@@ -0,0 +1,21 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stddef.h>
+
+/*
+	Each runner builds its structures at every size in sizes, times ops
+	operations of each kind on them (fewer for the O(n) ones, see
+	LATENCY_LINEAR_OPS) and prints one row per operation and size. The
+	runners live in separate files since each structure has its own TYPE.
+*/
+
+// Operations to time for an O(n) op, so each size does about the same work
+#define LATENCY_LINEAR_OPS(OPS, SIZE) \
+	((SIZE) == 0 || (OPS) / (SIZE) < 100 ? ((OPS) < 100 ? (OPS) : 100) : (OPS) / (SIZE))
+
+void latencyLinkedList(const size_t* sizes, int count, size_t ops);
+void latencyCircularList(const size_t* sizes, int count, size_t ops);
+void latencyStack(const size_t* sizes, int count, size_t ops);
+
+#endif
@@ -0,0 +1,95 @@
+#include "latency.h"
+#include "latencyHistogram.h"
+#include "circularList.h"
+
+/*
+	Latency of the circular list deque ops, with links from malloc and
+	from an arena, and with values in a ring buffer.
+*/
+
+enum { ADD_FRONT, ADD_BACK, REMOVE_FRONT, REMOVE_BACK, FRONT, BACK, REVERSE, OPS };
+
+static const char* opNames[OPS] = {
+	"AddFront", "AddBack", "RemoveFront", "RemoveBack", "Front", "Back", "Reverse"
+};
+
+/**
+	Times each op on a list holding size values and prints the results.
+	Adds are paired with removes so the list keeps its size.
+	param:	name	structure name for the report
+	param:	list	struct CircularList ptr
+	param:	size	size_t
+	param:	ops		size_t
+	pre:	list is not null and empty
+	post:	list is empty
+ */
+static void measure(const char* name, struct CircularList* list, size_t size, size_t ops)
+{
+	struct LatencyHistogram* histograms[OPS];
+	for (int op = 0; op < OPS; op++)
+	{
+		histograms[op] = latencyHistogramCreate();
+	}
+	for (size_t i = 0; i < size; i++)
+	{
+		circularListAddBack(list, (TYPE)i);
+	}
+
+	volatile TYPE sink;
+	for (size_t i = 0; i < ops; i++)
+	{
+		LATENCY_TIME(histograms[ADD_BACK], circularListAddBack(list, (TYPE)i));
+		LATENCY_TIME(histograms[REMOVE_FRONT], circularListRemoveFront(list));
+		LATENCY_TIME(histograms[ADD_FRONT], circularListAddFront(list, (TYPE)i));
+		LATENCY_TIME(histograms[REMOVE_BACK], circularListRemoveBack(list));
+		if (size > 0)
+		{
+			LATENCY_TIME(histograms[FRONT], sink = circularListFront(list));
+			LATENCY_TIME(histograms[BACK], sink = circularListBack(list));
+		}
+	}
+	size_t linearOps = LATENCY_LINEAR_OPS(ops, size);
+	for (size_t i = 0; i < linearOps; i++)
+	{
+		LATENCY_TIME(histograms[REVERSE], circularListReverse(list));
+	}
+	(void)sink;
+
+	for (int op = 0; op < OPS; op++)
+	{
+		if (histograms[op]->total > 0)
+		{
+			latencyPrintRow(name, opNames[op], size, histograms[op]);
+		}
+		latencyHistogramDestroy(histograms[op]);
+	}
+	circularListClear(list);
+}
+
+/**
+	Runs the circular list measurements at every size.
+	param:	sizes	array of sizes
+	param:	count	number of sizes
+	param:	ops		ops to time per O(1) op and size
+	pre:	sizes has count entries
+	post:	one row per op and size is printed
+ */
+void latencyCircularList(const size_t* sizes, int count, size_t ops)
+{
+	for (int i = 0; i < count; i++)
+	{
+		struct CircularList* list = circularListCreate();
+		measure("CL", list, sizes[i], ops);
+		circularListDestroy(list);
+
+		struct CircularListArena* arena = circularListArenaCreate(1024);
+		list = circularListCreateInArena(arena);
+		measure("CL arena", list, sizes[i], ops);
+		circularListDestroy(list);
+		circularListArenaDestroy(arena);
+
+		list = circularListCreateRing(1024);
+		measure("CL ring", list, sizes[i], ops);
+		circularListDestroy(list);
+	}
+}
@@ -0,0 +1,252 @@
+/***********************************************************
+* Filename: latencyHistogram.c
+*
+* Overview:
+*   This program is a latency histogram in the style of HDR
+*	histograms. Values (clock ticks) are put into buckets on a
+*	log-linear scale: every power of two is split into the same
+*	number of equal buckets, so small and huge latencies are both
+*	kept to a few percent of their true value while the whole
+*	0 .. 2^64 range fits in a fixed array and recording is a
+*	couple of shifts and an increment. The true maximum is kept
+*	exactly, since that is the number SLOs tend to be broken on.
+*	The clock is clock_gettime(CLOCK_MONOTONIC) by default, or the
+*	x86 time stamp counter when built with -DLATENCY_RDTSC (cheaper
+*	to read, converted to nanoseconds by timing it against the
+*	monotonic clock once).
+************************************************************/
+#define _POSIX_C_SOURCE 199309L
+#include "latencyHistogram.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#ifdef LATENCY_RDTSC
+#include <x86intrin.h>
+#endif
+
+#define SUB_BUCKETS (1 << LATENCY_SUB_BITS)
+
+// ------------------------------------------------------------------------- //
+//                                  CLOCK                                    //
+// ------------------------------------------------------------------------- //
+
+static uint64_t monotonicNs()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+/**
+	Reads the clock.
+	pre:	none
+	post:	none
+	ret:	current time in ticks
+ */
+uint64_t latencyNow()
+{
+#ifdef LATENCY_RDTSC
+	return __rdtsc();
+#else
+	return monotonicNs();
+#endif
+}
+
+/**
+	Converts a number of ticks to nanoseconds. With rdtsc the first call
+	spends about 20ms timing the counter against the monotonic clock.
+	param:	ticks	uint64_t
+	pre:	none
+	post:	none
+	ret:	nanoseconds
+ */
+double latencyTicksToNs(uint64_t ticks)
+{
+#ifdef LATENCY_RDTSC
+	static double nsPerTick = 0;
+	if (nsPerTick == 0)
+	{
+		uint64_t startNs = monotonicNs();
+		uint64_t startTicks = __rdtsc();
+		while (monotonicNs() - startNs < 20000000u)
+			;
+		nsPerTick = (double)(monotonicNs() - startNs) / (double)(__rdtsc() - startTicks);
+	}
+	return ticks * nsPerTick;
+#else
+	return (double)ticks;
+#endif
+}
+
+// ------------------------------------------------------------------------- //
+//                                HISTOGRAM                                  //
+// ------------------------------------------------------------------------- //
+
+/**
+	Returns the bucket a value is counted in. Values below SUB_BUCKETS
+	each have their own bucket; above that, the top LATENCY_SUB_BITS + 1
+	bits of the value pick the bucket within its power of two.
+	param:	value	uint64_t
+	pre:	none
+	post:	none
+	ret:	bucket index, less than LATENCY_BUCKETS
+ */
+static int bucketOf(uint64_t value)
+{
+	if (value < SUB_BUCKETS)
+	{
+		return (int)value;
+	}
+	int shift = 63 - __builtin_clzll(value) - LATENCY_SUB_BITS;
+	return ((shift + 1) << LATENCY_SUB_BITS) + (int)((value >> shift) - SUB_BUCKETS);
+}
+
+/**
+	Returns the largest value counted in the bucket.
+	param:	bucket	int
+	pre:	bucket is less than LATENCY_BUCKETS
+	post:	none
+	ret:	largest value of the bucket
+ */
+static uint64_t bucketTop(int bucket)
+{
+	if (bucket < SUB_BUCKETS)
+	{
+		return (uint64_t)bucket;
+	}
+	int shift = (bucket >> LATENCY_SUB_BITS) - 1;
+	uint64_t top = (uint64_t)(bucket & (SUB_BUCKETS - 1)) + SUB_BUCKETS;
+	return ((top + 1) << shift) - 1;
+}
+
+/**
+	Allocates and resets a histogram.
+	pre:	none
+	post:	histogram is not null and empty
+	ret:	histogram
+ */
+struct LatencyHistogram* latencyHistogramCreate()
+{
+	struct LatencyHistogram* histogram = malloc(sizeof(struct LatencyHistogram));
+	assert(histogram != 0);
+	latencyHistogramReset(histogram);
+	return histogram;
+}
+
+/**
+	Deallocates the histogram.
+	param:	histogram	struct LatencyHistogram ptr
+	pre:	histogram is not null
+	post:	histogram is freed
+ */
+void latencyHistogramDestroy(struct LatencyHistogram* histogram)
+{
+	assert(histogram != 0);
+	free(histogram);
+}
+
+/**
+	Drops every recorded value.
+	param:	histogram	struct LatencyHistogram ptr
+	pre:	histogram is not null
+	post:	histogram is empty
+ */
+void latencyHistogramReset(struct LatencyHistogram* histogram)
+{
+	assert(histogram != 0);
+	for (int i = 0; i < LATENCY_BUCKETS; i++)
+	{
+		histogram->counts[i] = 0;
+	}
+	histogram->total = 0;
+	histogram->max = 0;
+}
+
+/**
+	Records one duration.
+	param:	histogram	struct LatencyHistogram ptr
+	param:	ticks		uint64_t
+	pre:	histogram is not null
+	post:	the bucket of ticks has been incremented
+ */
+void latencyHistogramRecord(struct LatencyHistogram* histogram, uint64_t ticks)
+{
+	assert(histogram != 0);
+	histogram->counts[bucketOf(ticks)]++;
+	histogram->total++;
+	if (ticks > histogram->max)
+	{
+		histogram->max = ticks;
+	}
+}
+
+/**
+	Returns the value at or below which the given percentage of the
+	recorded values fall, rounded up to the top of its bucket (but never
+	above the largest value recorded).
+	param:	histogram	struct LatencyHistogram ptr
+	param:	percentile	double, 0 to 100
+	pre:	histogram is not null
+	post:	none
+	ret:	ticks, 0 if the histogram is empty
+ */
+uint64_t latencyHistogramPercentile(struct LatencyHistogram* histogram, double percentile)
+{
+	assert(histogram != 0);
+	assert(percentile >= 0 && percentile <= 100);
+	if (histogram->total == 0)
+	{
+		return 0;
+	}
+	uint64_t rank = (uint64_t)(percentile / 100 * histogram->total + 0.5);
+	if (rank == 0)
+	{
+		rank = 1;
+	}
+	uint64_t seen = 0;
+	for (int i = 0; i < LATENCY_BUCKETS; i++)
+	{
+		seen += histogram->counts[i];
+		if (seen >= rank)
+		{
+			uint64_t top = bucketTop(i);
+			return top < histogram->max ? top : histogram->max;
+		}
+	}
+	return histogram->max;
+}
+
+// ------------------------------------------------------------------------- //
+//                                  REPORT                                   //
+// ------------------------------------------------------------------------- //
+
+/**
+	Prints the column headings for latencyPrintRow.
+ */
+void latencyPrintHeader()
+{
+	printf("%-10s %-16s %9s %9s %9s %9s %9s %9s\n", "structure", "op", "size", "count",
+		"p50 ns", "p99 ns", "p99.9 ns", "max ns");
+}
+
+/**
+	Prints the count, p50, p99, p99.9 and max of the histogram in ns.
+	param:	structure	name of the structure measured
+	param:	op			name of the operation measured
+	param:	size		size of the structure while it was measured
+	param:	histogram	struct LatencyHistogram ptr
+	pre:	histogram is not null
+	post:	one line is printed
+ */
+void latencyPrintRow(const char* structure, const char* op, size_t size,
+	struct LatencyHistogram* histogram)
+{
+	assert(histogram != 0);
+	printf("%-10s %-16s %9zu %9llu %9.0f %9.0f %9.0f %9.0f\n", structure, op, size,
+		(unsigned long long)histogram->total,
+		latencyTicksToNs(latencyHistogramPercentile(histogram, 50)),
+		latencyTicksToNs(latencyHistogramPercentile(histogram, 99)),
+		latencyTicksToNs(latencyHistogramPercentile(histogram, 99.9)),
+		latencyTicksToNs(histogram->max));
+}
@@ -0,0 +1,50 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+	Each power of two is split into 2^LATENCY_SUB_BITS buckets, so a
+	recorded value is off by at most 1 / 2^LATENCY_SUB_BITS (3% at 5).
+*/
+#ifndef LATENCY_SUB_BITS
+#define LATENCY_SUB_BITS 5
+#endif
+
+#define LATENCY_BUCKETS ((64 - LATENCY_SUB_BITS + 1) << LATENCY_SUB_BITS)
+
+struct LatencyHistogram
+{
+	uint64_t counts[LATENCY_BUCKETS];
+	uint64_t total;
+	uint64_t max;
+};
+
+// Clock; ticks are nanoseconds unless built with -DLATENCY_RDTSC
+
+uint64_t latencyNow();
+double latencyTicksToNs(uint64_t ticks);
+
+// Times STMT and records its duration in HIST
+#define LATENCY_TIME(HIST, STMT) do { \
+	uint64_t latencyStart_ = latencyNow(); \
+	STMT; \
+	latencyHistogramRecord((HIST), latencyNow() - latencyStart_); \
+} while (0)
+
+// Histogram
+
+struct LatencyHistogram* latencyHistogramCreate();
+void latencyHistogramDestroy(struct LatencyHistogram* histogram);
+void latencyHistogramReset(struct LatencyHistogram* histogram);
+void latencyHistogramRecord(struct LatencyHistogram* histogram, uint64_t ticks);
+uint64_t latencyHistogramPercentile(struct LatencyHistogram* histogram, double percentile);
+
+// Report
+
+void latencyPrintHeader();
+void latencyPrintRow(const char* structure, const char* op, size_t size,
+	struct LatencyHistogram* histogram);
+
+#endif
@@ -0,0 +1,104 @@
+#include "latency.h"
+#include "latencyHistogram.h"
+#include "linkedList.h"
+
+/*
+	Latency of the linked list deque and bag ops, with links from malloc,
+	from an arena, with a Bloom filter in front of Contains, and with op
+	tracing on.
+*/
+
+enum { ADD_FRONT, ADD_BACK, REMOVE_FRONT, REMOVE_BACK, FRONT, ADD, REMOVE, CONTAINS, OPS };
+
+static const char* opNames[OPS] = {
+	"AddFront", "AddBack", "RemoveFront", "RemoveBack", "Front", "Add", "Remove", "Contains miss"
+};
+
+/**
+	Times each op on a list holding size values and prints the results.
+	Adds are paired with removes so the list keeps its size.
+	param:	name	structure name for the report
+	param:	list	struct LinkedList ptr
+	param:	size	size_t
+	param:	ops		size_t
+	pre:	list is not null and empty
+	post:	list is empty
+ */
+static void measure(const char* name, struct LinkedList* list, size_t size, size_t ops)
+{
+	struct LatencyHistogram* histograms[OPS];
+	for (int op = 0; op < OPS; op++)
+	{
+		histograms[op] = latencyHistogramCreate();
+	}
+	for (size_t i = 0; i < size; i++)
+	{
+		linkedListAddBack(list, (TYPE)i);
+	}
+
+	volatile TYPE sink;
+	for (size_t i = 0; i < ops; i++)
+	{
+		LATENCY_TIME(histograms[ADD_BACK], linkedListAddBack(list, (TYPE)i));
+		LATENCY_TIME(histograms[REMOVE_FRONT], linkedListRemoveFront(list));
+		LATENCY_TIME(histograms[ADD_FRONT], linkedListAddFront(list, (TYPE)i));
+		LATENCY_TIME(histograms[REMOVE_BACK], linkedListRemoveBack(list));
+		LATENCY_TIME(histograms[ADD], linkedListAdd(list, (TYPE)-1));
+		LATENCY_TIME(histograms[REMOVE], linkedListRemove(list, (TYPE)-1));
+		if (size > 0)
+		{
+			LATENCY_TIME(histograms[FRONT], sink = linkedListFront(list));
+		}
+	}
+	size_t linearOps = LATENCY_LINEAR_OPS(ops, size);
+	for (size_t i = 0; i < linearOps; i++)
+	{
+		LATENCY_TIME(histograms[CONTAINS], sink = linkedListContains(list, (TYPE)-1));
+	}
+	(void)sink;
+
+	for (int op = 0; op < OPS; op++)
+	{
+		if (histograms[op]->total > 0)
+		{
+			latencyPrintRow(name, opNames[op], size, histograms[op]);
+		}
+		latencyHistogramDestroy(histograms[op]);
+	}
+	linkedListClear(list);
+}
+
+/**
+	Runs the linked list measurements at every size.
+	param:	sizes	array of sizes
+	param:	count	number of sizes
+	param:	ops		ops to time per O(1) op and size
+	pre:	sizes has count entries
+	post:	one row per op and size is printed
+ */
+void latencyLinkedList(const size_t* sizes, int count, size_t ops)
+{
+	for (int i = 0; i < count; i++)
+	{
+		struct LinkedList* list = linkedListCreate();
+		measure("LL", list, sizes[i], ops);
+		linkedListDestroy(list);
+
+		struct LinkedListArena* arena = linkedListArenaCreate(1024);
+		list = linkedListCreateInArena(arena);
+		measure("LL arena", list, sizes[i], ops);
+		linkedListDestroy(list);
+		linkedListArenaDestroy(arena);
+
+		list = linkedListCreate();
+		linkedListEnableFilter(list, sizes[i], 0.01);
+		measure("LL filter", list, sizes[i], ops);
+		linkedListDestroy(list);
+
+		linkedListTraceEnable(4096);
+		list = linkedListCreate();
+		measure("LL trace", list, sizes[i], ops);
+		linkedListDestroy(list);
+		linkedListTraceEnable(0);
+	}
+}
@@ -0,0 +1,88 @@
+#include "latency.h"
+#include "latencyHistogram.h"
+
+/*
+	Latency of the stack built from two queues and of the queue itself.
+	stack_from_queue.c has no header, so the ops used are declared here;
+	it is built with -DSTACK_FROM_QUEUE_NO_MAIN to leave out its tests.
+*/
+
+#ifndef TYPE
+#define TYPE int
+#endif
+
+struct Queue;
+struct Stack;
+
+struct Queue* listQueueCreate();
+void listQueueAddBack(struct Queue* queue, TYPE value);
+TYPE listQueueRemoveFront(struct Queue* queue);
+void listQueueDestroy(struct Queue* queue);
+struct Stack* listStackFromQueuesCreate();
+void listStackDestroy(struct Stack* stack);
+void listStackPush(struct Stack* stack, TYPE value);
+TYPE listStackPop(struct Stack* stack);
+TYPE listStackTop(struct Stack* stack);
+
+enum { QUEUE_ADD_BACK, QUEUE_REMOVE_FRONT, STACK_TOP, STACK_POP, STACK_PUSH, OPS };
+
+static const char* opNames[OPS] = {
+	"AddBack", "RemoveFront", "Top", "Pop", "Push"
+};
+
+/**
+	Runs the stack and queue measurements at every size. Each push is
+	followed by a pop so the stack keeps its size; push is O(n), so it is
+	timed LATENCY_LINEAR_OPS times.
+	param:	sizes	array of sizes
+	param:	count	number of sizes
+	param:	ops		ops to time per O(1) op and size
+	pre:	sizes has count entries
+	post:	one row per op and size is printed
+ */
+void latencyStack(const size_t* sizes, int count, size_t ops)
+{
+	struct LatencyHistogram* histograms[OPS];
+	for (int op = 0; op < OPS; op++)
+	{
+		histograms[op] = latencyHistogramCreate();
+	}
+	for (int i = 0; i < count; i++)
+	{
+		size_t size = sizes[i];
+		struct Queue* queue = listQueueCreate();
+		struct Stack* stack = listStackFromQueuesCreate();
+		for (size_t j = 0; j < size; j++)
+		{
+			listQueueAddBack(queue, (TYPE)j);
+			listStackPush(stack, (TYPE)j);
+		}
+
+		volatile TYPE sink;
+		for (size_t j = 0; j < ops; j++)
+		{
+			LATENCY_TIME(histograms[QUEUE_ADD_BACK], listQueueAddBack(queue, (TYPE)j));
+			LATENCY_TIME(histograms[QUEUE_REMOVE_FRONT], sink = listQueueRemoveFront(queue));
+		}
+		size_t linearOps = LATENCY_LINEAR_OPS(ops, size);
+		for (size_t j = 0; j < linearOps; j++)
+		{
+			LATENCY_TIME(histograms[STACK_PUSH], listStackPush(stack, (TYPE)j));
+			LATENCY_TIME(histograms[STACK_TOP], sink = listStackTop(stack));
+			LATENCY_TIME(histograms[STACK_POP], sink = listStackPop(stack));
+		}
+		(void)sink;
+
+		for (int op = 0; op < OPS; op++)
+		{
+			latencyPrintRow(op < STACK_TOP ? "Queue" : "Stack", opNames[op], size, histograms[op]);
+			latencyHistogramReset(histograms[op]);
+		}
+		listStackDestroy(stack);
+		listQueueDestroy(queue);
+	}
+	for (int op = 0; op < OPS; op++)
+	{
+		latencyHistogramDestroy(histograms[op]);
+	}
+}
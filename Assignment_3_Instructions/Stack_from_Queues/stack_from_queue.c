@@ -34,18 +34,49 @@
 *	pointer that point to first/last link respectively. Each stack
 *	has two queue pointers.
 *
+*	The file also goes the other way: an aggregate queue built from
+*	two array stacks, where every stack entry caches the running
+*	aggregate (under a user-supplied monoid) of the entries below it.
+*	Enqueue pushes onto the 'in' stack; dequeue pops the 'out' stack,
+*	refilling it from 'in' when empty. This makes enqueue, dequeue and
+*	the aggregate of the whole queue O(1) amortized.
+*
+*	On Linux a queue can also signal an eventfd whenever it goes
+*	from empty to non-empty (see listQueueEnableNotify), so that a
+*	consumer can block in poll/epoll instead of polling the queue.
+*	After a burst, listQueueTrim packs an arena queue's links into
+*	its first chunks and hands the pages of the rest back to the OS;
+*	it can also run on its own when a queue shrinks well below its
+*	peak (see listQueueAutoTrim).
+*	Op tracing (listQueueTraceEnable) keeps each thread's most recent
+*	queue and stack ops in a ring of its own for post-mortem debugging.
+*
 * Usage:
 * 	1) gcc -g Wall -std=c99 -o stack_from_queue stack_from_queue
 *	2) ./stack_from_queue
 ************************************************************/
+#define _DEFAULT_SOURCE
+#include "dequeCommon.h"
 #include <assert.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <malloc.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
 
 #ifndef TYPE
 #define TYPE int
 #endif
 
+// Auto trim runs once a queue is down to 1 / TRIM_RATIO of its peak
+#ifndef TRIM_RATIO
+#define TRIM_RATIO 4
+#endif
+
 // Single link
 struct Link {
 	TYPE value;
@@ -56,6 +87,18 @@ struct Link {
 struct Queue {
 	struct Link* head;
 	struct Link* tail;
+	size_t size;
+	struct QueueArena* arena;	// null when links come from malloc
+	int ownsArena;				// arena is freed with the queue
+	int notifyFd;				// eventfd signalled on empty to non-empty, or -1
+	size_t peak;				// largest size since the last trim
+	size_t trimPeak;			// auto trim once peak reaches this, 0 for never
+};
+
+// Bump-pointer region the links of one queue at a time are allocated from
+struct QueueArena {
+	struct Arena links;
+	struct Queue* owner;
 };
 
 // Stack with two Queue instances
@@ -64,6 +107,79 @@ struct Stack {
 	struct Queue* q2;
 };
 
+// Monoid the aggregate queue folds its values with; combine must be
+// associative and identity must be its identity element
+struct Monoid {
+	TYPE identity;
+	TYPE (*combine)(TYPE a, TYPE b);
+};
+
+// Stack entry with the aggregate of itself and every entry below it
+struct AggEntry {
+	TYPE value;
+	TYPE agg;
+};
+
+// Array stack of aggregate entries
+struct AggStack {
+	struct AggEntry* entries;
+	size_t size;
+	size_t capacity;
+};
+
+// Queue with O(1) aggregate built from two stacks
+struct AggQueue {
+	struct AggStack in;		// newest entry on top
+	struct AggStack out;	// oldest entry on top
+	struct Monoid monoid;
+};
+
+// Memory usage report (see listQueueMemoryUsage)
+struct QueueMemory {
+	size_t elements;
+	size_t payloadBytes;	// bytes holding values
+	size_t overheadBytes;	// link pointers, sentinel and the queue struct
+	size_t slackBytes;		// allocator rounding beyond what was requested
+	size_t totalBytes;		// payload + overhead + slack
+	double bytesPerElement;
+};
+
+// Used by listQueueRemoveFront before it is defined
+void listQueueTrim(struct Queue* queue);
+
+// Tracing state of every queue's ops (see listQueueTraceEnable); each thread
+// records into a ring of its own (see dequeCommon.h)
+static struct TraceLog trace;
+static __thread struct TraceRing* traceRing;
+
+/**
+	Internal func returns the bits of a value (its first 8 bytes) for hashing.
+	param:	value	TYPE
+	pre:	none
+	post:	none
+	ret:	bits of value
+ */
+static uint64_t traceValue(TYPE value)
+{
+	uint64_t bits = 0;
+	memcpy(&bits, &value, sizeof(TYPE) < sizeof(bits) ? sizeof(TYPE) : sizeof(bits));
+	return bits;
+}
+
+/**
+	Internal func records an op in the calling thread's ring (see traceRecord).
+	param:	op		enum TraceOp
+	param:	object	the queue the op is on
+	param:	hash	bits of the value, or 0
+	param:	size	size of the queue
+	pre:	none
+	post:	the op is the thread's newest event if tracing is on
+ */
+static void traceOp(int op, const void* object, uint64_t hash, size_t size)
+{
+	traceRecord(&trace, &traceRing, op, object, hash, size);
+}
+
 /**
   	Internal func allocates the queue's sentinel. Sets sentinels' next to null,
   	and queue's head and tail to the sentinel.
@@ -73,16 +189,18 @@ struct Stack {
 			sentinel next points to null
 			head points to sentinel (always)
 			tail points to sentinel (always point to last link unless empty)
+			queue size is 0
  */
 void listQueueInit(struct Queue* queue)
 {
 	/* FIXME: You will write this function */
 	assert(queue !=0);
-	struct Link* link = malloc(sizeof(struct Link));
+	struct Link* link = tallyMalloc(sizeof(struct Link));
 	assert(link !=0);
 	link->next = 0;
 	queue->head = link;
 	queue->tail = link;
+	queue->size = 0;
 
 }
 
@@ -97,12 +215,74 @@ struct Queue* listQueueCreate()
 {
 
      /* FIXME: You will write this function */
-		 struct Queue* ptr = malloc(sizeof(struct Queue));
+		 struct Queue* ptr = tallyMalloc(sizeof(struct Queue));
 		 assert(ptr !=0);
+		 ptr->arena = 0;
+		 ptr->ownsArena = 0;
+		 ptr->notifyFd = -1;
+		 ptr->peak = 0;
+		 ptr->trimPeak = 0;
 		 listQueueInit(ptr);
+		 traceOp(TRACE_CREATE, ptr, 0, 0);
 		 return ptr;
 }
 
+/**
+	Allocates and initializes a queue whose links all come from the given
+	arena, so that destroying or clearing it is O(number of chunks)
+	instead of a free per link. The arena serves one queue at a time and
+	is ready for the next queue once this one is destroyed.
+	param:	arena	struct QueueArena ptr
+	pre: 	arena is not null
+	pre:	arena is not in use by another queue
+	post: 	memory allocated for new struct Queue ptr
+			queue init (call to listQueueInit func)
+			arena is owned by queue
+	return: queue
+ */
+struct Queue* listQueueCreateInArena(struct QueueArena* arena)
+{
+	assert(arena != 0);
+	assert(arena->owner == 0);
+	struct Queue* ptr = listQueueCreate();
+	ptr->arena = arena;
+	arena->owner = ptr;
+	return ptr;
+}
+
+/**
+	Allocates an arena for queue links along with its first chunk.
+	param:	chunkLinks	number of links in the first chunk; each later
+						chunk is twice the size of the one before, up
+						to ARENA_MAX_CHUNK_SLOTS links
+	pre: 	chunkLinks > 0
+	post: 	memory allocated for arena and one chunk of chunkLinks links
+	return: arena
+ */
+struct QueueArena* listQueueArenaCreate(size_t chunkLinks)
+{
+	assert(chunkLinks > 0);
+	struct QueueArena* arena = tallyMalloc(sizeof(struct QueueArena));
+	arenaInit(&arena->links, sizeof(struct Link), chunkLinks);
+	arena->owner = 0;
+	return arena;
+}
+
+/**
+	Frees every chunk of the arena and the arena itself.
+	param:	arena	struct QueueArena ptr
+	pre: 	arena is not null
+	pre:	arena is not in use by a queue
+	post: 	memory allocated to each chunk and the arena is freed
+ */
+void listQueueArenaDestroy(struct QueueArena* arena)
+{
+	assert(arena != 0);
+	assert(arena->owner == 0);
+	arenaFinish(&arena->links);
+	tallyFree(arena, sizeof(struct QueueArena));
+}
+
 /**
 	Adds a new link with the given value to the back of the queue.
 	param: 	queue 	struct Queue ptr
@@ -115,11 +295,27 @@ void listQueueAddBack (struct Queue* queue, TYPE value)
 {
 	/* FIXME: You will write this function */
 	assert(queue !=0);
-	struct Link* ptr = malloc(sizeof(struct Link));
+	traceOp(TRACE_ADD_BACK, queue, traceValue(value), queue->size);
+	struct Link* ptr = queue->arena != 0
+		? arenaAlloc(&queue->arena->links)
+		: tallyMalloc(sizeof(struct Link));
 	ptr->value = value;
 	ptr->next = 0;
 	queue->tail->next=ptr;
 	queue->tail=ptr;
+	queue->size++;
+	tallyElements(1, sizeof(TYPE));
+	if(queue->size > queue->peak)
+	{
+		queue->peak = queue->size;
+	}
+#ifdef __linux__
+	// only the first value wakes the consumer; later ones ride along
+	if(queue->size == 1 && queue->notifyFd >= 0)
+	{
+		eventfd_write(queue->notifyFd, 1);
+	}
+#endif
 
 }
 
@@ -147,7 +343,7 @@ TYPE listQueueFront(struct Queue* queue)
 	param: 	queue 	struct Queue ptr
 	pre:	queue is not null
 	pre:	queue is not empty (i.e., queue's head next pointer is not null)
-	post:	first link is removed and freed (call to removeLink)
+	post:	first link is removed and freed (or returned to the arena)
  */
 TYPE listQueueRemoveFront(struct Queue* queue)
 {
@@ -155,15 +351,30 @@ TYPE listQueueRemoveFront(struct Queue* queue)
 	assert(queue !=0);
 	assert(queue->head->next !=0);
 	TYPE front = listQueueFront(queue); //front is a temp value
+	traceOp(TRACE_REMOVE_FRONT, queue, traceValue(front), queue->size);
 	struct Link* ptr = queue->head->next;
 	queue->head->next = ptr->next;
-	free(ptr);
+	if(queue->arena != 0)
+	{
+		arenaFree(&queue->arena->links, ptr);
+	}
+	else
+	{
+		tallyFree(ptr, sizeof(struct Link));
+	}
+	queue->size--;
+	tallyElements(-1, sizeof(TYPE));
 
 	/* This updates the tail pointer to point at the sentinel again if the queue is empty*/
 	if(queue->head->next==0)
 	{
 		queue->tail=queue->head;
 	}
+	if(queue->trimPeak !=0 && queue->peak >= queue->trimPeak
+		&& queue->size < queue->peak / TRIM_RATIO)
+	{
+		listQueueTrim(queue);
+	}
 	return front;
 }
 
@@ -187,28 +398,287 @@ int listQueueIsEmpty(struct Queue* queue)
 	return 0;
 }
 
+/**
+	Removes every link from the queue, leaving it empty but usable.
+	An arena queue just rewinds its arena, which is O(number of chunks);
+	otherwise every link is freed.
+	param:	queue 	struct Queue ptr
+	pre: 	queue is not null
+	post: 	queue is empty (head next is null and tail is the sentinel)
+ */
+void listQueueClear(struct Queue* queue)
+{
+	assert(queue != NULL);
+	traceOp(TRACE_CLEAR, queue, 0, queue->size);
+	if(queue->arena == 0)
+	{
+		while(!listQueueIsEmpty(queue)) {
+			listQueueRemoveFront(queue);
+		}
+		return;
+	}
+	arenaReset(&queue->arena->links);
+	tallyElements(-(ptrdiff_t)queue->size, sizeof(TYPE));
+	queue->head->next = 0;
+	queue->tail = queue->head;
+	queue->size = 0;
+	if(queue->trimPeak !=0 && queue->peak >= queue->trimPeak)
+	{
+		listQueueTrim(queue);
+	}
+}
+
+/**
+	Returns memory the queue no longer needs after it has shrunk. An arena
+	queue has its links packed, in order, into the first links of its
+	arena, and the pages of the chunk space left over are handed back to
+	the OS with madvise(MADV_DONTNEED). The chunks themselves are kept,
+	so the next burst reuses them without calling malloc. A queue whose
+	links come from malloc has its values copied into one block of links
+	in a new arena, which the queue owns and takes its links from from
+	then on; the old links are freed and the allocator is asked to
+	release what it can with malloc_trim. O(n) plus the number of chunks.
+	param:	queue 	struct Queue ptr
+	pre: 	queue is not null
+	post: 	queue has the same values in the same order
+			queue peak is its current size
+ */
+void listQueueTrim(struct Queue* queue)
+{
+	assert(queue != NULL);
+	traceOp(TRACE_TRIM, queue, 0, queue->size);
+	queue->peak = queue->size;
+	if(queue->arena == 0)
+	{
+		if(queue->size > 0)
+		{
+			struct Link* old = queue->head->next;
+			queue->arena = listQueueArenaCreate(queue->size);
+			queue->arena->owner = queue;
+			queue->ownsArena = 1;
+			queue->tail = queue->head;
+			while(old != 0)
+			{
+				struct Link* link = arenaAlloc(&queue->arena->links);
+				link->value = old->value;
+				queue->tail->next = link;
+				queue->tail = link;
+				struct Link* next = old->next;
+				tallyFree(old, sizeof(struct Link));
+				old = next;
+			}
+			queue->tail->next = 0;
+		}
+		malloc_trim(0);
+		return;
+	}
+	TYPE* values = malloc((queue->size > 0 ? queue->size : 1) * sizeof(TYPE));
+	assert(values != 0);
+	size_t i = 0;
+	for(struct Link* link = queue->head->next; link != 0; link = link->next)
+	{
+		values[i++] = link->value;
+	}
+	arenaReset(&queue->arena->links);
+	queue->tail = queue->head;
+	for(i = 0; i < queue->size; i++)
+	{
+		struct Link* link = arenaAlloc(&queue->arena->links);
+		link->value = values[i];
+		queue->tail->next = link;
+		queue->tail = link;
+	}
+	queue->tail->next = 0;
+	free(values);
+
+	arenaRelease(&queue->arena->links);
+}
+
+/**
+	Turns the high-watermark trim policy on or off. With it on, once the
+	queue has held at least minPeak values, it is trimmed (see
+	listQueueTrim) whenever a dequeue takes it below 1 / TRIM_RATIO of
+	the largest size it has reached since it was last trimmed. Each trim
+	costs O(n), but runs only after the queue has lost most of its
+	values, so this adds O(1) amortized per dequeue.
+	param:	queue 	struct Queue ptr
+	param:	minPeak	size_t, 0 to turn the policy off
+	pre: 	queue is not null
+	post: 	queue trims itself when it falls well below its peak
+ */
+void listQueueAutoTrim(struct Queue* queue, size_t minPeak)
+{
+	assert(queue != NULL);
+	queue->trimPeak = minPeak;
+}
+
 /**
 	Deallocates every link in the queue including the sentinel,
 	and frees the queue itself.
 	param:	queue 	struct Queue ptr
 	pre: 	queue is not null
 	post: 	memory allocated to each link is freed
+			(or handed back to the queue's arena)
 			" " sentinel " "
 			" " queue " "
+			" " queue's arena if it was made by listQueueTrim
  */
 void listQueueDestroy(struct Queue* queue)
 {
 
         assert(queue != NULL);
-	while(!listQueueIsEmpty(queue)) {
-		listQueueRemoveFront(queue);
+	traceOp(TRACE_DESTROY, queue, 0, queue->size);
+	listQueueClear(queue);
+	if(queue->arena != 0)
+	{
+		queue->arena->owner = 0;
+		if(queue->ownsArena)
+		{
+			listQueueArenaDestroy(queue->arena);
+		}
 	}
-	free(queue->head);
-	free(queue);
+#ifdef __linux__
+	if(queue->notifyFd >= 0)
+	{
+		close(queue->notifyFd);
+	}
+#endif
+	tallyFree(queue->head, sizeof(struct Link));
+	tallyFree(queue, sizeof(struct Queue));
 	queue = NULL;
 
 }
 
+/**
+	Internal func fills in the derived fields of a memory usage report
+	from its element count and the bytes requested from and handed out
+	by the allocator.
+	param:	usage		struct QueueMemory ptr
+	param:	elements	size_t
+	param:	payload		size_t, bytes holding the values
+	param:	requested	size_t
+	param:	usable		size_t
+	pre:	usage is not null
+	post:	every field of usage is set
+ */
+static void fillQueueMemory(struct QueueMemory* usage, size_t elements,
+	size_t payload, size_t requested, size_t usable)
+{
+	assert(usage != 0);
+	usage->elements = elements;
+	usage->payloadBytes = payload;
+	usage->overheadBytes = requested - usage->payloadBytes;
+	usage->slackBytes = usable - requested;
+	usage->totalBytes = usable;
+	usage->bytesPerElement = elements == 0 ? 0.0 : (double)usable / elements;
+}
+
+/**
+	Reports the memory held by one queue: the bytes holding its values,
+	the link pointers, sentinel and queue struct around them, and the
+	slack the allocator added to each block (from malloc_usable_size).
+	Walks every link, so this is O(n). For an arena queue the arena's
+	chunks are counted instead, with unused chunk space as overhead.
+	param:	queue	struct Queue ptr
+	param:	usage	struct QueueMemory ptr
+	pre:	queue and usage are not null
+	post:	usage is filled in for queue
+ */
+void listQueueMemoryUsage(struct Queue* queue, struct QueueMemory* usage)
+{
+	assert(queue != 0 && usage != 0);
+	size_t requested = sizeof(struct Queue) + sizeof(struct Link);
+	size_t usable = malloc_usable_size(queue) + malloc_usable_size(queue->head);
+	if(queue->arena != 0)
+	{
+		// links live in the arena's chunks, so count those instead
+		arenaMemory(&queue->arena->links, &requested, &usable);
+		fillQueueMemory(usage, queue->size, queue->size * sizeof(TYPE), requested, usable);
+		return;
+	}
+	struct Link* current = queue->head->next;
+	while(current != 0)
+	{
+		requested += sizeof(struct Link);
+		usable += malloc_usable_size(current);
+		current = current->next;
+	}
+	fillQueueMemory(usage, queue->size, queue->size * sizeof(TYPE), requested, usable);
+}
+
+/**
+	Reports the memory held by every list, deque and queue in the process
+	(the linked list, circular list and stack from queues modules share
+	one tally, kept with atomic counters as links and structs are
+	allocated and freed on any thread). O(1).
+	param:	usage	struct QueueMemory ptr
+	pre:	usage is not null
+	post:	usage is filled in for all of them combined
+ */
+void listQueueMemoryTotal(struct QueueMemory* usage)
+{
+	struct MemoryTally totals;
+	tallyRead(&totals);
+	fillQueueMemory(usage, totals.elements, totals.payloadBytes, totals.requestedBytes,
+		totals.usableBytes);
+}
+
+/**
+	Turns on notification: from now on, an eventfd is signalled each time
+	a value is added to the queue while it is empty. Signals coalesce (the
+	eventfd just stays readable), so a producer adding to a non-empty
+	queue makes no syscall. The queue itself is not thread safe; producers
+	and consumer share it under their own lock. The consumer waits for the
+	fd to become readable, calls listQueueAckNotify, then takes the lock
+	and removes values until the queue is empty before waiting again.
+	param:	queue 	struct Queue ptr
+	pre:	queue is not null
+	post:	queue has an eventfd, signalled now if queue is not empty
+	ret:	the eventfd, to poll or add to an epoll set (owned by the
+			queue, closed when it is destroyed), or -1 if eventfd is not
+			available on this platform
+ */
+int listQueueEnableNotify(struct Queue* queue)
+{
+	assert(queue !=0);
+#ifdef __linux__
+	if(queue->notifyFd < 0)
+	{
+		queue->notifyFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if(queue->notifyFd >= 0 && queue->size > 0)
+		{
+			eventfd_write(queue->notifyFd, 1);
+		}
+	}
+	return queue->notifyFd;
+#else
+	return -1;
+#endif
+}
+
+/**
+	Resets the queue's eventfd so it is no longer readable. Call it before
+	draining the queue, so an add that lands after the drain signals again.
+	param:	queue 	struct Queue ptr
+	pre:	queue is not null
+	pre:	notification is on
+	post:	eventfd is not readable until the queue next goes non-empty
+	ret:	number of signals since the last ack (0 if none)
+ */
+int listQueueAckNotify(struct Queue* queue)
+{
+	assert(queue !=0);
+	assert(queue->notifyFd >= 0);
+#ifdef __linux__
+	eventfd_t signals;
+	if(eventfd_read(queue->notifyFd, &signals) == 0)
+	{
+		return (int)signals;
+	}
+#endif
+	return 0;
+}
+
 /**
 	Allocates and initializes a stack that is comprised of two
 	instances of Queue data structures.
@@ -303,6 +773,7 @@ void listStackPush(struct Stack* stack, TYPE value)
 {
 	/* FIXME: You will write this function */
 	assert(stack !=0);
+	traceOp(TRACE_PUSH, stack, traceValue(value), stack->q1->size);
 	listQueueAddBack(stack->q2,value);
 	while (!listQueueIsEmpty(stack->q1))
 	{
@@ -311,6 +782,62 @@ void listStackPush(struct Stack* stack, TYPE value)
 	listSwapStackQueues(stack);
 }
 
+/**
+	Pushes k values onto the stack in a single pass, as if listStackPush
+	had been called on values[0] through values[k - 1] in order (so
+	values[k - 1] ends up on top). The values are added to the back of
+	q2 in reverse order, then the links of q1 are moved across to the
+	back of q2 all at once by relinking them (no links are freed or
+	reallocated), and q1 and q2 are swapped. Once either queue takes its
+	links from an arena (see listQueueTrim), the links can't change hands,
+	so q1's values are moved across one at a time instead. This makes a bulk push
+	O(k) instead of the O(n*k) it costs to call listStackPush k times.
+	param: 	stack 	struct Stack ptr
+	param: 	values 	TYPE array
+	param: 	k 		number of values to push
+	pre: 	stack is not null
+	pre:	values is not null if k > 0
+	post: 	k new links are added to the top of the stack
+			q1 is left empty (just its sentinel) before the swap
+			q1 and q2 are swapped
+ */
+void listStackPushN(struct Stack* stack, const TYPE* values, size_t k)
+{
+	assert(stack !=0);
+	assert(values !=0 || k == 0);
+	if(k == 0)
+	{
+		return;
+	}
+	traceOp(TRACE_PUSH, stack, traceValue(values[k - 1]), stack->q1->size);
+	for(size_t i = k; i > 0; --i)
+	{
+		listQueueAddBack(stack->q2,values[i - 1]);
+	}
+	// move every link of q1 across in one go
+	if(stack->q1->arena !=0 || stack->q2->arena !=0)
+	{
+		while(!listQueueIsEmpty(stack->q1))
+		{
+			listQueueAddBack(stack->q2, listQueueRemoveFront(stack->q1));
+		}
+	}
+	else if(!listQueueIsEmpty(stack->q1))
+	{
+		stack->q2->tail->next = stack->q1->head->next;
+		stack->q2->tail = stack->q1->tail;
+		stack->q2->size += stack->q1->size;
+		if(stack->q2->size > stack->q2->peak)
+		{
+			stack->q2->peak = stack->q2->size;
+		}
+		stack->q1->head->next = 0;
+		stack->q1->tail = stack->q1->head;
+		stack->q1->size = 0;
+	}
+	listSwapStackQueues(stack);
+}
+
 /**
 	Removes the link at the top of the stack and returns its value.
 	param: 	stack 	struct Stack ptr
@@ -324,6 +851,7 @@ TYPE listStackPop(struct Stack* stack)
 	/* FIXME: You will write this function */
 	assert(stack !=0);
 	assert(!listStackIsEmpty(stack));
+	traceOp(TRACE_POP, stack, traceValue(listQueueFront(stack->q1)), stack->q1->size);
 	return listQueueRemoveFront(stack->q1);
 }
 
@@ -344,7 +872,351 @@ TYPE listStackTop(struct Stack* stack)
 }
 
 /**
-	Used for testing the stack from queue implementation.
+	Turns op tracing on or off. With it on, every thread that works on a
+	queue records each op (its code, a hash of its value, the queue's
+	size and a time stamp) in a ring of its own holding its most recent
+	events, to be written out with listQueueTraceDump. A thread gets its
+	ring the first time it traces, sized by the latest call to this;
+	turning tracing off keeps the rings, so they can still be dumped.
+	param:	events	events each thread keeps (rounded up to a power of
+					two), 0 to turn tracing off
+	pre:	none
+	post:	ops are traced if events > 0
+ */
+void listQueueTraceEnable(size_t events)
+{
+	traceEnable(&trace, events);
+}
+
+/**
+	Writes the trace rings of every thread that has traced queue and stack
+	ops. Threads may keep tracing while this runs: each ring is copied
+	and any events that were overwritten during the copy are left out,
+	along with another thread's oldest event if its ring is full (it
+	may be the one being overwritten).
+	The event clock is timed for 10ms to record its rate.
+	param:	out		FILE ptr open for writing
+	pre:	out is not null
+	post:	a dump of every ring is written to out
+	ret:	0 on success, -1 if writing failed
+ */
+int listQueueTraceDump(FILE* out)
+{
+	assert(out != 0);
+	return traceDump(&trace, traceRing, 'Q', out);
+}
+
+/*
+	Snapshot format: see dequeCommon.h. Only how a value of this build's
+	TYPE is encoded lives here.
+*/
+
+#define SNAPSHOT_INTEGER ((TYPE)0.5 == 0)
+#define SNAPSHOT_KIND (SNAPSHOT_INTEGER ? 'i' : 'f')
+
+/**
+	Internal func writes a value: the zigzag varint of its difference
+	from the previous value for integer TYPEs, its raw little-endian
+	bytes otherwise.
+	param:	stream	struct SnapshotStream ptr
+	param:	value	TYPE
+	param:	prev	TYPE ptr to the previous value, set to value
+	pre:	stream and prev are not null
+	post:	value is written
+ */
+static void snapshotPutValue(struct SnapshotStream* stream, TYPE value, TYPE* prev)
+{
+	if (SNAPSHOT_INTEGER)
+	{
+		snapshotPutDelta(stream, (int64_t)value - (int64_t)*prev);
+		*prev = value;
+		return;
+	}
+	snapshotPutBytes(stream, &value, sizeof(TYPE));
+}
+
+/**
+	Internal func reads a value written by snapshotPutValue.
+	param:	stream	struct SnapshotStream ptr
+	param:	prev	TYPE ptr to the previous value, set to the value read
+	pre:	stream and prev are not null
+	post:	failed is set if the value is cut off
+	ret:	value
+ */
+static TYPE snapshotGetValue(struct SnapshotStream* stream, TYPE* prev)
+{
+	if (SNAPSHOT_INTEGER)
+	{
+		*prev = (TYPE)((int64_t)*prev + snapshotGetDelta(stream));
+		return *prev;
+	}
+	TYPE value;
+	snapshotGetBytes(stream, &value, sizeof(TYPE));
+	return value;
+}
+
+/**
+	Writes the queue's values, front to back, as a binary snapshot.
+	param:	queue 	struct Queue ptr
+	param:	out		FILE ptr open for writing
+	pre:	queue and out are not null
+	post:	snapshot is written to out; the queue is unchanged
+	ret:	0 on success, -1 if writing failed
+ */
+int listQueueWriteSnapshot(struct Queue* queue, FILE* out)
+{
+	assert(queue !=0 && out !=0);
+	struct SnapshotStream stream = { out, 0, 0 };
+	snapshotPutHeader(&stream, SNAPSHOT_KIND, sizeof(TYPE), queue->size);
+	TYPE prev = 0;
+	for(struct Link* link = queue->head->next; link != 0; link = link->next)
+	{
+		snapshotPutValue(&stream, link->value, &prev);
+	}
+	return snapshotPutTrailer(&stream);
+}
+
+/**
+	Makes a queue from a snapshot written by listQueueWriteSnapshot.
+	param:	in		FILE ptr open for reading
+	pre:	in is not null
+	post:	the snapshot is consumed from in
+	ret:	queue with the snapshot's values, or null if the snapshot is
+			cut off, corrupt or for another TYPE
+ */
+struct Queue* listQueueReadSnapshot(FILE* in)
+{
+	assert(in !=0);
+	struct SnapshotStream stream = { in, 0, 0 };
+	size_t count = snapshotGetHeader(&stream, SNAPSHOT_KIND, sizeof(TYPE));
+	if(stream.failed)
+	{
+		return 0;
+	}
+	struct Queue* queue = listQueueCreate();
+	TYPE prev = 0;
+	for(size_t i = 0; i < count && !stream.failed; i++)
+	{
+		listQueueAddBack(queue, snapshotGetValue(&stream, &prev));
+	}
+	if(snapshotGetTrailer(&stream) !=0)
+	{
+		listQueueDestroy(queue);
+		return 0;
+	}
+	return queue;
+}
+
+/**
+	Writes the stack's values, top first, as a binary snapshot (that of
+	q1, which holds the stack).
+	param:	stack 	struct Stack ptr
+	param:	out		FILE ptr open for writing
+	pre:	stack and out are not null
+	post:	snapshot is written to out; the stack is unchanged
+	ret:	0 on success, -1 if writing failed
+ */
+int listStackWriteSnapshot(struct Stack* stack, FILE* out)
+{
+	assert(stack !=0);
+	return listQueueWriteSnapshot(stack->q1, out);
+}
+
+/**
+	Makes a stack from a snapshot written by listStackWriteSnapshot (or
+	listQueueWriteSnapshot, whose front becomes the top).
+	param:	in		FILE ptr open for reading
+	pre:	in is not null
+	post:	the snapshot is consumed from in
+	ret:	stack with the snapshot's values, or null if the snapshot is
+			cut off, corrupt or for another TYPE
+ */
+struct Stack* listStackReadSnapshot(FILE* in)
+{
+	struct Queue* queue = listQueueReadSnapshot(in);
+	if(queue == 0)
+	{
+		return 0;
+	}
+	struct Stack* stack = listStackFromQueuesCreate();
+	listQueueDestroy(stack->q1);
+	stack->q1 = queue;
+	return stack;
+}
+
+/**
+	Internal func pushes a value with its aggregate onto an AggStack,
+	doubling the stack's array when it is full.
+	param: 	stack 	struct AggStack ptr
+	param: 	value 	TYPE
+	param: 	agg 	TYPE, aggregate of value and every entry below it
+	pre: 	stack is not null
+	post: 	entry is on top of the stack
+ */
+static void aggStackPush(struct AggStack* stack, TYPE value, TYPE agg)
+{
+	assert(stack != 0);
+	if(stack->size == stack->capacity)
+	{
+		stack->capacity *= 2;
+		stack->entries = realloc(stack->entries, stack->capacity * sizeof(struct AggEntry));
+		assert(stack->entries != 0);
+	}
+	stack->entries[stack->size].value = value;
+	stack->entries[stack->size].agg = agg;
+	stack->size++;
+}
+
+/**
+	Allocates and initializes an aggregate queue made of two empty stacks.
+	param:	monoid	struct Monoid the aggregate is folded with
+	pre: 	monoid combine is not null
+	post: 	memory allocated for new struct AggQueue ptr and both stacks
+	return: queue
+ */
+struct AggQueue* aggQueueCreate(struct Monoid monoid)
+{
+	assert(monoid.combine != 0);
+	struct AggQueue* queue = malloc(sizeof(struct AggQueue));
+	assert(queue != 0);
+	queue->in.capacity = 8;
+	queue->in.size = 0;
+	queue->in.entries = malloc(8 * sizeof(struct AggEntry));
+	queue->out.capacity = 8;
+	queue->out.size = 0;
+	queue->out.entries = malloc(8 * sizeof(struct AggEntry));
+	assert(queue->in.entries != 0 && queue->out.entries != 0);
+	queue->monoid = monoid;
+	return queue;
+}
+
+/**
+	Frees both stacks of the aggregate queue and the queue itself.
+	param:	queue 	struct AggQueue ptr
+	pre: 	queue is not null
+	post: 	memory allocated to the stacks and queue is freed
+ */
+void aggQueueDestroy(struct AggQueue* queue)
+{
+	assert(queue != 0);
+	free(queue->in.entries);
+	free(queue->out.entries);
+	free(queue);
+}
+
+/**
+	Returns 1 if the aggregate queue is empty and 0 otherwise.
+	param:	queue	struct AggQueue ptr
+	pre:	queue is not null
+	post:	none
+	ret:	1 if both stacks are empty; otherwise 0
+ */
+int aggQueueIsEmpty(struct AggQueue* queue)
+{
+	assert(queue != 0);
+	return queue->in.size == 0 && queue->out.size == 0;
+}
+
+/**
+	Adds a value to the back of the aggregate queue by pushing it onto the
+	'in' stack with the aggregate of everything already there. O(1)
+	amortized.
+	param: 	queue 	struct AggQueue ptr
+	param: 	value 	TYPE
+	pre: 	queue is not null
+	post: 	value is the newest entry of the queue
+ */
+void aggQueueAddBack(struct AggQueue* queue, TYPE value)
+{
+	assert(queue != 0);
+	TYPE below = queue->in.size == 0
+		? queue->monoid.identity
+		: queue->in.entries[queue->in.size - 1].agg;
+	aggStackPush(&queue->in, value, queue->monoid.combine(below, value));
+}
+
+/**
+	Internal func moves every entry of the 'in' stack onto the 'out' stack
+	if 'out' is empty, recomputing the aggregates so that each 'out' entry
+	holds the aggregate of itself and every newer entry below it.
+	param: 	queue 	struct AggQueue ptr
+	pre: 	queue is not null
+	post: 	'out' is not empty unless the whole queue is empty
+ */
+static void aggQueueRefill(struct AggQueue* queue)
+{
+	if(queue->out.size > 0)
+	{
+		return;
+	}
+	while(queue->in.size > 0)
+	{
+		TYPE value = queue->in.entries[--queue->in.size].value;
+		TYPE below = queue->out.size == 0
+			? queue->monoid.identity
+			: queue->out.entries[queue->out.size - 1].agg;
+		aggStackPush(&queue->out, value, queue->monoid.combine(value, below));
+	}
+}
+
+/**
+	Returns the value at the front (oldest entry) of the aggregate queue.
+	param: 	queue 	struct AggQueue ptr
+	pre:	queue is not null
+	pre:	queue is not empty
+	post:	'in' may have been moved onto 'out'
+	ret:	front value
+ */
+TYPE aggQueueFront(struct AggQueue* queue)
+{
+	assert(queue != 0);
+	assert(!aggQueueIsEmpty(queue));
+	aggQueueRefill(queue);
+	return queue->out.entries[queue->out.size - 1].value;
+}
+
+/**
+	Removes the front (oldest entry) of the aggregate queue and returns
+	its value. O(1) amortized: each entry is moved from 'in' to 'out' once.
+	param: 	queue 	struct AggQueue ptr
+	pre:	queue is not null
+	pre:	queue is not empty
+	post:	oldest entry is removed
+	ret:	value of the removed entry
+ */
+TYPE aggQueueRemoveFront(struct AggQueue* queue)
+{
+	assert(queue != 0);
+	assert(!aggQueueIsEmpty(queue));
+	aggQueueRefill(queue);
+	return queue->out.entries[--queue->out.size].value;
+}
+
+/**
+	Returns the aggregate of every value in the queue, oldest to newest,
+	from the cached aggregates on top of the two stacks. O(1).
+	param: 	queue 	struct AggQueue ptr
+	pre:	queue is not null
+	post:	none
+	ret:	aggregate of the queue (the monoid identity if empty)
+ */
+TYPE aggQueueAggregate(struct AggQueue* queue)
+{
+	assert(queue != 0);
+	TYPE older = queue->out.size == 0
+		? queue->monoid.identity
+		: queue->out.entries[queue->out.size - 1].agg;
+	TYPE newer = queue->in.size == 0
+		? queue->monoid.identity
+		: queue->in.entries[queue->in.size - 1].agg;
+	return queue->monoid.combine(older, newer);
+}
+
+#ifndef STACK_FROM_QUEUE_NO_MAIN
+
+/**
+	Used for testing the stack from queue implementation. Build with
+	-DSTACK_FROM_QUEUE_NO_MAIN to link the stack into another program.
  */
 
 void assertTrue(int pred, char* msg)
@@ -356,6 +1228,16 @@ void assertTrue(int pred, char* msg)
 		printf("\tFAILED\n");
 }
 
+TYPE sumOf(TYPE a, TYPE b)
+{
+	return a + b;
+}
+
+TYPE maxOf(TYPE a, TYPE b)
+{
+	return a < b ? b : a;
+}
+
 int main()
 {
 	struct Stack* s = listStackFromQueuesCreate();
@@ -386,7 +1268,220 @@ int main()
 	}
 	assertTrue(listStackTop(s) == 9, "top val == 9\t");
 
+	printf("\npushing 10-14 with pushN...\n");
+	TYPE batch[] = {10, 11, 12, 13, 14};
+	listStackPushN(s, batch, 5);
+	assertTrue(listStackPop(s) == 14, "popping; val == 14");
+	assertTrue(listStackPop(s) == 13, "popping; val == 13");
+	listStackPushN(s, batch, 0);
+	assertTrue(listStackTop(s) == 12, "top val == 12\t");
+	for(int i = 0; i < 3; i++) {
+		listStackPop(s);
+	}
+	assertTrue(listStackTop(s) == 9, "top val == 9\t");
+
+	printf("\nchecking memory usage...\n");
+	struct QueueMemory usage;
+	struct QueueMemory total;
+	listQueueMemoryUsage(s->q1, &usage);
+	listQueueMemoryTotal(&total);
+	assertTrue(usage.elements == 10, "q1 elements == 10");
+	assertTrue(usage.payloadBytes == 10 * sizeof(TYPE), "q1 payload == 10 values");
+	assertTrue(total.elements == 10, "total elements == 10");
+	assertTrue(total.totalBytes >= usage.totalBytes, "total >= q1 bytes");
+
+	printf("\nsnapshot round trip...\n");
+	FILE* file = tmpfile();
+	assert(file);
+	assertTrue(listStackWriteSnapshot(s, file) == 0, "snapshot written");
+	rewind(file);
+	struct Stack* copy = listStackReadSnapshot(file);
+	assertTrue(copy != 0 && listStackPop(copy) == 9, "copy popping; val == 9");
+	assertTrue(listStackTop(copy) == 8, "copy top val == 8");
+	listStackDestroy(copy);
+	rewind(file);
+	fputc('X', file);
+	rewind(file);
+	assertTrue(listStackReadSnapshot(file) == 0, "bad snapshot rejected");
+	fclose(file);
+
+	listStackDestroy(s);
+
+	printf("\nqueues in an arena...\n");
+	struct QueueArena* arena = listQueueArenaCreate(4);
+	struct Queue* q = listQueueCreateInArena(arena);
+	for(int i = 0; i < 10; i++) {
+		listQueueAddBack(q, i);
+	}
+	assertTrue(listQueueRemoveFront(q) == 0, "dequeue; val == 0");
+	listQueueAddBack(q, 10);
+	listQueueMemoryUsage(q, &usage);
+	assertTrue(usage.elements == 10, "arena queue elements == 10");
+	listQueueClear(q);
+	assertTrue(listQueueIsEmpty(q) == 1, "cleared queue is empty");
+	listQueueAddBack(q, 7);
+	assertTrue(listQueueFront(q) == 7, "front val == 7\t");
+	listQueueDestroy(q);
+	q = listQueueCreateInArena(arena);
+	listQueueAddBack(q, 8);
+	assertTrue(listQueueFront(q) == 8, "reused arena; front == 8");
+	listQueueDestroy(q);
+	listQueueArenaDestroy(arena);
+	listQueueMemoryTotal(&total);
+	assertTrue(total.totalBytes == 0 && total.elements == 0, "all queue memory returned");
+
+	printf("\ntrimming after a burst...\n");
+	arena = listQueueArenaCreate(8);
+	q = listQueueCreateInArena(arena);
+	for(int i = 0; i < 1000; i++) {
+		listQueueAddBack(q, i);
+	}
+	struct QueueMemory burst;
+	listQueueMemoryUsage(q, &burst);
+	for(int i = 0; i < 990; i++) {
+		listQueueRemoveFront(q);
+	}
+	listQueueTrim(q);
+	listQueueMemoryUsage(q, &usage);
+	assertTrue(usage.elements == 10 && listQueueFront(q) == 990, "trim keeps the values");
+	for(int i = 0; i < 990; i++) {
+		listQueueAddBack(q, 1000 + i);
+	}
+	listQueueMemoryUsage(q, &usage);
+	assertTrue(usage.totalBytes == burst.totalBytes, "next burst reuses the chunks");
+	int inOrder = 1;
+	for(int i = 0; i < 1000; i++) {
+		inOrder = inOrder && listQueueRemoveFront(q) == 990 + i;
+	}
+	assertTrue(inOrder, "values in order after trim");
+	listQueueAutoTrim(q, 100);
+	for(int i = 0; i < 400; i++) {
+		listQueueAddBack(q, i);
+	}
+	for(int i = 0; i < 350; i++) {
+		listQueueRemoveFront(q);
+	}
+	inOrder = 1;
+	for(int i = 350; i < 400; i++) {
+		inOrder = inOrder && listQueueRemoveFront(q) == i;
+	}
+	assertTrue(inOrder && listQueueIsEmpty(q), "auto trim keeps the values in order");
+	listQueueDestroy(q);
+	listQueueArenaDestroy(arena);
+
+	printf("\ntrimming a malloc queue...\n");
+	q = listQueueCreate();
+	struct Queue* other = listQueueCreate();
+	for(int i = 0; i < 200; i++) {
+		listQueueAddBack(q, i);
+		listQueueAddBack(other, i);
+	}
+	for(int i = 0; i < 150; i++) {
+		listQueueRemoveFront(q);
+	}
+	listQueueTrim(q);
+	int packed = q->arena != 0;
+	int expected = 150;
+	inOrder = 1;
+	for(struct Link* link = q->head->next; link != 0; link = link->next) {
+		packed = packed && (link->next == 0 || link->next == link + 1);
+		inOrder = inOrder && link->value == expected++;
+	}
+	assertTrue(packed && expected == 200, "trimmed malloc queue's links are contiguous");
+	assertTrue(inOrder, "trimmed malloc queue keeps the values");
+	listQueueDestroy(other);
+	listQueueDestroy(q);
+	s = listStackFromQueuesCreate();
+	for(int i = 0; i < 5; i++) {
+		listStackPush(s, i);
+	}
+	listQueueTrim(s->q1);
+	const TYPE more[] = {5, 6, 7};
+	listStackPushN(s, more, 3);
+	inOrder = 1;
+	for(int i = 7; i >= 0; i--) {
+		inOrder = inOrder && listStackPop(s) == i;
+	}
+	assertTrue(inOrder && listStackIsEmpty(s), "push n onto a trimmed stack");
 	listStackDestroy(s);
+	listQueueMemoryTotal(&total);
+	assertTrue(total.totalBytes == 0 && total.elements == 0, "trimmed queues' arenas freed");
+
+	printf("\nqueue notification...\n");
+	q = listQueueCreate();
+	if(listQueueEnableNotify(q) >= 0)
+	{
+		assertTrue(listQueueAckNotify(q) == 0, "no signal while empty");
+		listQueueAddBack(q, 1);
+		listQueueAddBack(q, 2);
+		listQueueAddBack(q, 3);
+		assertTrue(listQueueAckNotify(q) == 1, "three adds, one signal");
+		assertTrue(listQueueAckNotify(q) == 0, "signal consumed by ack");
+		while(!listQueueIsEmpty(q))
+		{
+			listQueueRemoveFront(q);
+		}
+		listQueueAddBack(q, 4);
+		assertTrue(listQueueAckNotify(q) == 1, "signal after going empty");
+	}
+	listQueueDestroy(q);
+
+	printf("\nop tracing...\n");
+	listQueueTraceEnable(3);
+	q = listQueueCreate();
+	listQueueAddBack(q, 1);
+	listQueueAddBack(q, 2);
+	listQueueAddBack(q, 3);
+	listQueueRemoveFront(q);
+	listQueueTraceEnable(0);
+	listQueueAddBack(q, 4);
+	FILE* dump = tmpfile();
+	assertTrue(listQueueTraceDump(dump) == 0, "trace dump written");
+	unsigned char header[17 + 12 + 4 * 24];
+	rewind(dump);
+	assertTrue(fread(header, 1, sizeof(header), dump) == sizeof(header)
+		&& memcmp(header, "DQT1Q", 5) == 0 && header[13] == 1, "one thread ring");
+	assertTrue(header[21] == 4 && fgetc(dump) == EOF, "ring keeps the last 4 ops");
+	assertTrue(header[29 + 20] == TRACE_ADD_BACK && header[29 + 3 * 24 + 20] == TRACE_REMOVE_FRONT
+		&& header[29 + 3 * 24 + 8] == 3, "oldest first, size before the op");
+	fclose(dump);
+	listQueueDestroy(q);
+
+	printf("\n-------------------------------------------------\n");
+	printf("---- Testing aggregate queue from two stacks ----\n");
+	printf("-------------------------------------------------\n");
+	struct Monoid sum = { 0, sumOf };
+	struct Monoid max = { -2147483647 - 1, maxOf };
+	struct AggQueue* sums = aggQueueCreate(sum);
+	struct AggQueue* maxes = aggQueueCreate(max);
+	assertTrue(aggQueueIsEmpty(sums) == 1, "aggQueueIsEmpty == 1");
+	assertTrue(aggQueueAggregate(sums) == 0, "empty sum == 0\t");
+
+	printf("\nsliding a window of 3 over 5, 1, 4, 2, 8, 3...\n");
+	TYPE window[] = {5, 1, 4, 2, 8, 3};
+	TYPE windowSums[] = {5, 6, 10, 7, 14, 13};
+	TYPE windowMaxes[] = {5, 5, 5, 4, 8, 8};
+	int sumsOk = 1;
+	int maxesOk = 1;
+	for(int i = 0; i < 6; i++) {
+		aggQueueAddBack(sums, window[i]);
+		aggQueueAddBack(maxes, window[i]);
+		if(i >= 3) {
+			aggQueueRemoveFront(sums);
+			aggQueueRemoveFront(maxes);
+		}
+		sumsOk = sumsOk && aggQueueAggregate(sums) == windowSums[i];
+		maxesOk = maxesOk && aggQueueAggregate(maxes) == windowMaxes[i];
+	}
+	assertTrue(sumsOk, "window sums\t");
+	assertTrue(maxesOk, "window maxes\t");
+	assertTrue(aggQueueFront(sums) == 2, "front val == 2\t");
+	assertTrue(aggQueueRemoveFront(sums) == 2, "dequeue; val == 2");
+	assertTrue(aggQueueAggregate(sums) == 11, "sum == 11\t");
+	aggQueueDestroy(sums);
+	aggQueueDestroy(maxes);
 
 	return 0;
 }
+
+#endif
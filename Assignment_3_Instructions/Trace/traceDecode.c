@@ -0,0 +1,166 @@
+/***********************************************************
+* Filename: traceDecode.c
+*
+* Overview:
+*   This program prints a trace dump written by
+*	linkedListTraceDump, circularListTraceDump or
+*	listQueueTraceDump as text. The events of every thread are
+*	merged into one timeline by time stamp, one line per op:
+*	the time in microseconds since the first event, the thread,
+*	the op, the object it was on (a hash of its address), its
+*	size when the op started and the hash of the op's value.
+*
+* Usage:
+* 	1) make
+*	2) ./traceDecode dump.bin
+************************************************************/
+#define _DEFAULT_SOURCE
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dequeCommon.h"
+
+// Bytes of one event in a dump
+#define EVENT_BYTES 24
+
+// One event of a dump, with the thread it came from
+struct Event
+{
+	uint64_t ticks;
+	uint64_t size;
+	uint32_t hash;
+	uint16_t op;
+	uint16_t object;
+	uint32_t thread;
+};
+
+/**
+	Reads a little-endian field.
+	param:	in		FILE ptr
+	param:	bytes	width of the field
+	param:	value	uint64_t ptr for the field
+	pre:	in and value are not null
+	post:	bytes bytes are consumed from in
+	ret:	1 if the field was read, 0 if the dump ended first
+ */
+static int get(FILE* in, int bytes, uint64_t* value)
+{
+	*value = 0;
+	for (int i = 0; i < bytes; i++)
+	{
+		int c = fgetc(in);
+		if (c == EOF)
+		{
+			return 0;
+		}
+		*value |= (uint64_t)c << (8 * i);
+	}
+	return 1;
+}
+
+static int byTicks(const void* a, const void* b)
+{
+	const struct Event* x = a;
+	const struct Event* y = b;
+	return x->ticks < y->ticks ? -1 : x->ticks > y->ticks;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc != 2)
+	{
+		fprintf(stderr, "usage: %s dump.bin\n", argv[0]);
+		return 2;
+	}
+	FILE* in = fopen(argv[1], "rb");
+	if (in == 0)
+	{
+		perror(argv[1]);
+		return 1;
+	}
+	char magic[4];
+	uint64_t module, ticksPerSecond, rings;
+	if (fread(magic, 1, 4, in) != 4 || memcmp(magic, "DQT1", 4) != 0
+		|| !get(in, 1, &module) || !get(in, 8, &ticksPerSecond) || !get(in, 4, &rings)
+		|| ticksPerSecond == 0)
+	{
+		fprintf(stderr, "%s: not a trace dump\n", argv[1]);
+		return 1;
+	}
+	// a dump from a crashed process may be cut off or garbled, so counts
+	// are checked against what is left of the file before trusting them
+	long start = ftell(in);
+	if (start < 0 || fseek(in, 0, SEEK_END) != 0)
+	{
+		perror(argv[1]);
+		return 1;
+	}
+	long end = ftell(in);
+	if (end < start || fseek(in, start, SEEK_SET) != 0)
+	{
+		perror(argv[1]);
+		return 1;
+	}
+
+	struct Event* events = 0;
+	size_t count = 0;
+	for (uint64_t ring = 0; ring < rings; ring++)
+	{
+		uint64_t thread, ringCount;
+		if (!get(in, 4, &thread) || !get(in, 8, &ringCount))
+		{
+			fprintf(stderr, "%s: cut off\n", argv[1]);
+			return 1;
+		}
+		long at = ftell(in);
+		if (at < 0 || ringCount > (uint64_t)(end - at) / EVENT_BYTES
+			|| ringCount > SIZE_MAX / sizeof(struct Event) - count - 1)
+		{
+			fprintf(stderr, "%s: ring %llu claims more events than the dump holds\n",
+				argv[1], (unsigned long long)ring);
+			return 1;
+		}
+		struct Event* grown = realloc(events, (count + ringCount + 1) * sizeof(struct Event));
+		if (grown == 0)
+		{
+			fprintf(stderr, "%s: out of memory\n", argv[1]);
+			return 1;
+		}
+		events = grown;
+		for (uint64_t i = 0; i < ringCount; i++)
+		{
+			uint64_t ticks, size, hash, op, object;
+			if (!get(in, 8, &ticks) || !get(in, 8, &size) || !get(in, 4, &hash)
+				|| !get(in, 2, &op) || !get(in, 2, &object))
+			{
+				fprintf(stderr, "%s: cut off\n", argv[1]);
+				return 1;
+			}
+			struct Event* event = &events[count++];
+			event->ticks = ticks;
+			event->size = size;
+			event->hash = (uint32_t)hash;
+			event->op = (uint16_t)op;
+			event->object = (uint16_t)object;
+			event->thread = (uint32_t)thread;
+		}
+	}
+	fclose(in);
+
+	qsort(events, count, sizeof(struct Event), byTicks);
+	const char* name = module == 'L' ? "linked list" : module == 'C' ? "circular list"
+		: module == 'Q' ? "queue/stack" : "unknown";
+	printf("%s trace, %llu threads, %zu events\n", name, (unsigned long long)rings, count);
+	printf("%12s %6s %-12s %6s %12s %10s\n", "us", "thread", "op", "object", "size", "hash");
+	for (size_t i = 0; i < count; i++)
+	{
+		struct Event* event = &events[i];
+		double us = (double)(event->ticks - events[0].ticks) * 1e6 / (double)ticksPerSecond;
+		printf("%12.3f %6u %-12s %6x %12llu %10x\n", us, event->thread,
+			traceOpName(event->op), event->object,
+			(unsigned long long)event->size, event->hash);
+	}
+	free(events);
+	return 0;
+}